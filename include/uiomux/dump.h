@@ -21,11 +21,18 @@
 #define __UIOMUX_DUMP_H__
 
 #include <stdio.h>
+#include <stdint.h>
 
 /** \file
  * UIOMux memory-mapped I/O dump functions.
  *
  * This file contains debugging routines for dumping MMIO regions.
+ *
+ * uiomux_dump_mmio() formats each register as text, which is too slow to
+ * run around every job. The snapshot functions instead copy the registers
+ * of an MMIO region in one pass into a binary struct uiomux_snapshot, held
+ * in memory or in a file, which can be compared with
+ * uiomux_snapshot_diff() or turned into text later with "uiomux dump".
  */
 
 /*
@@ -52,4 +59,94 @@ int uiomux_dump_mmio (FILE * stream, UIOMux * uiomux, uiomux_resource_t resource
 int uiomux_dump_mmio_filename (UIOMux * uiomux, uiomux_resource_t resource,
 			       const char *fmt, ...);
 
+/** Value of the magic field of a struct uiomux_snapshot */
+#define UIOMUX_SNAPSHOT_MAGIC 0x50534e55	/* "UNSP" */
+
+/** Version of the struct uiomux_snapshot layout */
+#define UIOMUX_SNAPSHOT_VERSION 1
+
+/**
+ * A binary copy of the MMIO region of a resource. The layout is the same
+ * in memory and in snapshot files, in host byte order.
+ */
+struct uiomux_snapshot {
+  /** UIOMUX_SNAPSHOT_MAGIC */
+  uint32_t magic;
+  /** UIOMUX_SNAPSHOT_VERSION */
+  uint32_t version;
+  /** The resource the registers were read from */
+  uint32_t resource;
+  /** Size of \a regs in bytes */
+  uint32_t size;
+  /** Physical address of the MMIO region */
+  uint64_t address;
+  /** Time of the snapshot, CLOCK_MONOTONIC in ns */
+  uint64_t time_ns;
+  /** Register values, one for each 32-bit word of the region */
+  uint32_t regs[];
+};
+
+/**
+ * A register which differs between two snapshots, see uiomux_snapshot_diff().
+ */
+struct uiomux_reg_change {
+  /** Byte offset of the register in the MMIO region */
+  uint32_t offset;
+  /** Value in the first snapshot */
+  uint32_t old_value;
+  /** Value in the second snapshot */
+  uint32_t new_value;
+};
+
+/**
+ * Get the size of a snapshot of the MMIO region of a UIO managed resource.
+ * \param uiomux A UIOMux handle
+ * \param resource A single named resource
+ * \returns Size in bytes of the struct uiomux_snapshot, including registers
+ * \retval 0 Failure: resource not managed, or more than one resource given.
+ */
+size_t uiomux_snapshot_size (UIOMux * uiomux, uiomux_resource_t resource);
+
+/**
+ * Copy the MMIO region of a UIO managed resource into a snapshot. Each
+ * register is read once, with a single 32-bit access.
+ * \param uiomux A UIOMux handle
+ * \param resource A single named resource
+ * \param snap Buffer for the snapshot
+ * \param size Size of \a snap in bytes, see uiomux_snapshot_size()
+ * \retval 0 Success
+ * \retval -1 Failure: resource not managed, or more than one resource given,
+ *            or \a size too small.
+ */
+int uiomux_snapshot_mmio (UIOMux * uiomux, uiomux_resource_t resource,
+			  struct uiomux_snapshot * snap, size_t size);
+
+/**
+ * Copy the MMIO region of a UIO managed resource into a snapshot file. The
+ * file is created or truncated, and written through a shared mapping.
+ * The name of the file can be given as a format string.
+ * \param uiomux A UIOMux handle
+ * \param resource A single named resource
+ * \param fmt The file name
+ * \retval 0 Success
+ * \retval -1 Failure: resource not managed, or more than one resource given,
+ *            or error creating the file.
+ */
+int uiomux_snapshot_mmio_filename (UIOMux * uiomux, uiomux_resource_t resource,
+				   const char *fmt, ...);
+
+/**
+ * Find the registers which differ between two snapshots of a resource.
+ * \param a The earlier snapshot
+ * \param b The later snapshot
+ * \param changes Array for the changed registers, in order of offset
+ * \param max_changes Size of \a changes
+ * \returns Number of changed registers; if this is more than
+ *          \a max_changes, only the first \a max_changes are stored.
+ * \retval -1 Failure: the snapshots are not of the same region.
+ */
+int uiomux_snapshot_diff (const struct uiomux_snapshot * a,
+			  const struct uiomux_snapshot * b,
+			  struct uiomux_reg_change * changes, int max_changes);
+
 #endif /* __UIOMUX_DUMP_H__ */
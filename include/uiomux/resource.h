@@ -39,6 +39,10 @@ typedef int uiomux_resource_t;
 /** Specifies that all resources are selected */
 #define UIOMUX_ALL (~0)
 
+/** Number of resources a UIOMux handle can manage, one per low bit of
+ * uiomux_resource_t */
+#define UIOMUX_BLOCK_MAX 16
+
 #include <uiomux/arch_sh.h>
 
 #endif /* __UIOMUX_RESOURCE_H__ */
@@ -0,0 +1,296 @@
+/*
+ * UIOMux: a conflict manager for system resources, including UIO devices.
+ * Copyright (C) 2009 Renesas Technology Corp.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston MA  02110-1301 USA
+ */
+
+#ifndef __UIOMUX_STATS_H__
+#define __UIOMUX_STATS_H__
+
+#include <stdint.h>
+#include <sys/types.h>
+
+/** \file
+ * UIOMux statistics and diagnostics.
+ *
+ * libuiomux keeps system-wide statistics for each managed resource in a
+ * shared memory segment. These functions read them, for example to find
+ * which process is holding up a resource. If the shared memory segment
+ * cannot be created, statistics are not available and these functions
+ * fail.
+ *
+ * The status register sampler is per handle instead: it measures how busy
+ * each resource is by reading a status register at a fixed rate.
+ */
+
+/**
+ * Lock statistics of a resource, see uiomux_get_lockstat().
+ */
+struct uiomux_lockstat {
+  /** Process holding the resource lock, or 0 if it is unlocked */
+  pid_t holder_pid;
+  /** Thread holding the resource lock */
+  pid_t holder_tid;
+  /** Time for which the current holder has held the lock, in us */
+  unsigned long held_us;
+  /** Number of threads waiting for the lock */
+  unsigned int waiters;
+  /** Number of times the lock has been acquired */
+  unsigned long lock_count;
+  /** Average and maximum time the lock was held, in us */
+  unsigned long hold_avg_us, hold_max_us;
+  /** Average and maximum time spent waiting for the lock, in us */
+  unsigned long wait_avg_us, wait_max_us;
+  /** Number of holds reported by a watchdog, see uiomux_set_watchdog() */
+  unsigned long watchdog_trips;
+};
+
+/**
+ * Get the lock holder and lock statistics of a UIO managed resource.
+ * \param uiomux A UIOMux handle
+ * \param resource A single named resource
+ * \param stat Return for the statistics
+ * \retval 0 Success
+ * \retval -1 Failure: resource not managed, or more than one resource given,
+ *            or statistics not available.
+ */
+int
+uiomux_get_lockstat (UIOMux * uiomux, uiomux_resource_t resource,
+                     struct uiomux_lockstat * stat);
+
+/**
+ * Print the current lock holder and lock statistics of each UIO device
+ * to stdout.
+ * \param uiomux A UIOMux handle
+ * \retval 0 Success
+ */
+int
+uiomux_holders (UIOMux * uiomux);
+
+/** Number of buckets in the interrupt latency histogram */
+#define UIOMUX_IRQ_HIST_BUCKETS 16
+
+/**
+ * Interrupt statistics of a resource, see uiomux_get_irqstat().
+ * Interrupt latency is measured from enabling the interrupt in a
+ * uiomux_sleep* function to the wakeup of the sleeping thread.
+ */
+struct uiomux_irqstat {
+  /** Latest interrupt count read from the kernel */
+  unsigned long count;
+  /** Interrupts which were counted by the kernel but never seen
+   *  individually, because several fired between two reads */
+  unsigned long coalesced;
+  /** Number of waits completed by an interrupt */
+  unsigned long waits;
+  /** Average and maximum interrupt latency, in us */
+  unsigned long latency_avg_us, latency_max_us;
+  /** Latency histogram: hist[k] counts latencies of 2^k to 2^(k+1) us;
+   *  hist[0] also counts latencies below 1 us, and the last bucket
+   *  counts all longer latencies */
+  unsigned long hist[UIOMUX_IRQ_HIST_BUCKETS];
+};
+
+/**
+ * Get the interrupt statistics of a UIO managed resource. The interrupt
+ * rate can be found by calling this function twice and dividing the
+ * difference in \a count by the time between the calls.
+ * \param uiomux A UIOMux handle
+ * \param resource A single named resource
+ * \param stat Return for the statistics
+ * \retval 0 Success
+ * \retval -1 Failure: resource not managed, or more than one resource given,
+ *            or statistics not available.
+ */
+int
+uiomux_get_irqstat (UIOMux * uiomux, uiomux_resource_t resource,
+                    struct uiomux_irqstat * stat);
+
+/** Extent flag: allocated with uiomux_malloc_shared() */
+#define UIOMUX_EXTENT_SHARED 1
+/** Extent flag: locked with uiomux_mlock() or uiomux_mtrylock() */
+#define UIOMUX_EXTENT_LOCKED 2
+
+/**
+ * Pages of the memory region of a resource owned by one thread, see
+ * uiomux_get_extents().
+ */
+struct uiomux_extent {
+  /** Physical address of the first page */
+  unsigned long address;
+  /** Size in bytes */
+  unsigned long size;
+  /** Process and thread which allocated the pages */
+  pid_t pid;
+  pid_t tid;
+  /** UIOMUX_EXTENT_* flags */
+  unsigned int flags;
+};
+
+/**
+ * Get the allocated extents of the memory region of a UIO managed
+ * resource, in all processes. Extents are kept in the shared state as
+ * memory is allocated and freed, so this takes time proportional to the
+ * number of extents, not the size of the region. Adjacent extents of
+ * the same owner are merged; extents of shared allocations may overlap.
+ * \param uiomux A UIOMux handle
+ * \param resource A single named resource
+ * \param extents Return for the extents, in order of address
+ * \param max Size of \a extents
+ * \param untracked Return for the number of allocations which could not
+ *                  be recorded because the shared table was full, or NULL
+ * \returns Number of extents; only the first \a max are stored
+ * \retval -1 Failure: resource not managed, or more than one resource given,
+ *            or statistics not available.
+ */
+int
+uiomux_get_extents (UIOMux * uiomux, uiomux_resource_t resource,
+                    struct uiomux_extent * extents, int max,
+                    unsigned long * untracked);
+
+/**
+ * Memory use of a resource, in total or by one process, see
+ * uiomux_get_memstat() and uiomux_get_proc_memstat(). Sizes are in
+ * whole pages, as allocated.
+ */
+struct uiomux_memstat {
+  /** Process, or 0 for the total of all processes */
+  pid_t pid;
+  /** Bytes allocated now */
+  unsigned long live_bytes;
+  /** Highest live_bytes since the peak was last reset */
+  unsigned long peak_bytes;
+  /** Number of allocations made */
+  unsigned long allocs;
+  /** Number of frees made */
+  unsigned long frees;
+  /** Number of allocations which failed for lack of free memory */
+  unsigned long failed;
+};
+
+/**
+ * Get the memory use of a UIO managed resource by all processes.
+ * Memory of processes which have died is no longer counted; it is
+ * noticed when the statistics are read.
+ * \param uiomux A UIOMux handle
+ * \param resource A single named resource
+ * \param stat Return for the statistics
+ * \retval 0 Success
+ * \retval -1 Failure: resource not managed, or more than one resource given,
+ *            or statistics not available.
+ */
+int
+uiomux_get_memstat (UIOMux * uiomux, uiomux_resource_t resource,
+                    struct uiomux_memstat * stat);
+
+/**
+ * Get the memory use of a UIO managed resource by each live process which
+ * has allocated from it, largest live_bytes first.
+ * \param uiomux A UIOMux handle
+ * \param resource A single named resource
+ * \param stats Return for the statistics of each process
+ * \param max Size of \a stats
+ * \returns Number of processes; only the first \a max are stored
+ * \retval -1 Failure: resource not managed, or more than one resource given,
+ *            or statistics not available.
+ */
+int
+uiomux_get_proc_memstat (UIOMux * uiomux, uiomux_resource_t resource,
+                         struct uiomux_memstat * stats, int max);
+
+/**
+ * Restart the peak memory use of a UIO managed resource, in total and for
+ * each process, from the current use. Calling this periodically gives
+ * the peak of each period.
+ * \param uiomux A UIOMux handle
+ * \param resource A single named resource
+ * \retval 0 Success
+ * \retval -1 Failure: resource not managed, or more than one resource given,
+ *            or statistics not available.
+ */
+int
+uiomux_reset_mem_peak (UIOMux * uiomux, uiomux_resource_t resource);
+
+/** Number of buckets in the state histogram of a sampled register */
+#define UIOMUX_SAMPLE_STATES 16
+
+/**
+ * A status register to sample, see uiomux_set_sampler().
+ */
+struct uiomux_sample_reg {
+  /** A single named resource */
+  uiomux_resource_t resource;
+  /** Byte offset of the 32-bit status register in the MMIO region */
+  unsigned long offset;
+  /** Bits of the register of which any is set while the resource is busy */
+  uint32_t busy_mask;
+  /** Field of the register counted in the state histogram, or 0 */
+  uint32_t state_mask;
+};
+
+/**
+ * Sampled utilisation of a resource, see uiomux_get_samplestat().
+ */
+struct uiomux_samplestat {
+  /** Number of samples taken */
+  unsigned long samples;
+  /** Number of samples in which the resource was busy */
+  unsigned long busy;
+  /** Number of busy periods, ie. changes from idle to busy */
+  unsigned long busy_runs;
+  /** Number of sample periods missed because the sampler ran late */
+  unsigned long missed;
+  /** Time since sampling started, in us */
+  unsigned long elapsed_us;
+  /** State histogram: states[k] counts samples in which the state field
+   *  was k; the last bucket also counts all larger values */
+  unsigned long states[UIOMUX_SAMPLE_STATES];
+};
+
+/**
+ * Sample status registers of UIO managed resources at a fixed rate.
+ * A thread is started which reads the given registers each period into
+ * a ring buffer, without locking; the samples are accumulated into the
+ * statistics returned by uiomux_get_samplestat(). The resources need not
+ * be locked. Calling this function again replaces the previous sampler
+ * and resets the statistics.
+ * \param uiomux A UIOMux handle
+ * \param regs Status registers to sample, one for each resource
+ * \param count Number of entries in \a regs
+ * \param rate_hz Samples per second, at most 1000000; 0 stops sampling
+ * \retval 0 Success
+ * \retval -1 Failure: resource not managed or given twice, or an offset
+ *            outside the MMIO region or not 32-bit aligned, or a rate
+ *            above 1 MHz (EINVAL); or thread creation failed.
+ */
+int
+uiomux_set_sampler (UIOMux * uiomux, const struct uiomux_sample_reg * regs,
+                    int count, unsigned long rate_hz);
+
+/**
+ * Get the sampled utilisation of a UIO managed resource. The busy ratio
+ * is \a busy / \a samples.
+ * \param uiomux A UIOMux handle
+ * \param resource A single named resource
+ * \param stat Return for the statistics
+ * \retval 0 Success
+ * \retval -1 Failure: resource not being sampled.
+ */
+int
+uiomux_get_samplestat (UIOMux * uiomux, uiomux_resource_t resource,
+                       struct uiomux_samplestat * stat);
+
+#endif /* __UIOMUX_STATS_H__ */
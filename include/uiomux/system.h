@@ -49,8 +49,11 @@ uiomux_system_reset (UIOMux * uiomux);
  * other applications which have previously opened it, so must not be used
  * by normal applications. It is usually called by the commandline tool
  * 'uiomux destroy'.
- * \param uiomux A UIOMux handle
+ * \param uiomux A UIOMux handle; it is closed
  * \retval 0 Success
+ * \retval -1 Failure: called from a watchdog or dispatcher callback of the
+ *            handle (errno is EDEADLK); the handle stays open and the shared
+ *            state is left in place
  */
 int
 uiomux_system_destroy (UIOMux * uiomux);
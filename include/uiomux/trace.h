@@ -0,0 +1,155 @@
+/*
+ * UIOMux: a conflict manager for system resources, including UIO devices.
+ * Copyright (C) 2009 Renesas Technology Corp.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston MA  02110-1301 USA
+ */
+
+#ifndef __UIOMUX_TRACE_H__
+#define __UIOMUX_TRACE_H__
+
+#include <stdint.h>
+
+/** \file
+ * UIOMux register access helpers and tracing.
+ *
+ * uiomux_reg_read() and uiomux_reg_write() access a 32-bit register at an
+ * offset in an MMIO region, given its descriptor from
+ * uiomux_get_mmio_desc(). When the calling code is compiled with
+ * UIOMUX_TRACE defined, each access is also logged, with a timestamp,
+ * while tracing is started with uiomux_trace_start(). Each thread logs
+ * into its own ring buffer without locking; uiomux_trace_save() merges
+ * the rings into a trace file, which "uiomux replay" can replay against
+ * the devices or a simulated register file. Without UIOMUX_TRACE, the
+ * helpers are plain loads and stores.
+ */
+
+/** Trace entry operation: register read */
+#define UIOMUX_TRACE_READ 0
+/** Trace entry operation: register write */
+#define UIOMUX_TRACE_WRITE 1
+
+/** Value of the magic field of a struct uiomux_trace_header */
+#define UIOMUX_TRACE_MAGIC 0x52544e55	/* "UNTR" */
+
+/** Version of the trace file layout */
+#define UIOMUX_TRACE_VERSION 1
+
+/**
+ * A logged register access.
+ */
+struct uiomux_trace_entry {
+  /** Time of the access, CLOCK_MONOTONIC in ns */
+  uint64_t time_ns;
+  /** Physical address of the register */
+  uint64_t address;
+  /** Value read or written */
+  uint32_t value;
+  /** Number of the thread which made the access, from 0 */
+  uint16_t thread;
+  /** UIOMUX_TRACE_READ or UIOMUX_TRACE_WRITE */
+  uint16_t op;
+};
+
+/**
+ * Header of a trace file, followed by \a count entries in order of time.
+ */
+struct uiomux_trace_header {
+  /** UIOMUX_TRACE_MAGIC */
+  uint32_t magic;
+  /** UIOMUX_TRACE_VERSION */
+  uint32_t version;
+  /** Number of entries in the file */
+  uint32_t count;
+  /** Number of older entries overwritten in full ring buffers */
+  uint32_t dropped;
+};
+
+/** Nonzero while tracing is started; read by the inline helpers */
+extern volatile int uiomux_trace_active;
+
+/**
+ * Start tracing register accesses, discarding any earlier trace.
+ * \param entries Size of the ring buffer of each thread, in entries; it
+ *                is rounded up to a power of two. 0 selects 4096.
+ * \retval 0 Success
+ */
+int
+uiomux_trace_start (unsigned int entries);
+
+/**
+ * Stop tracing register accesses. The trace is kept for uiomux_trace_save().
+ */
+void
+uiomux_trace_stop (void);
+
+/**
+ * Save the current trace to a file. The entries of all threads are
+ * merged in order of time. Call this after uiomux_trace_stop(), once the
+ * traced threads have finished their register accesses.
+ * \param filename Name of the trace file to write
+ * \returns Number of entries saved
+ * \retval -1 Failure: error writing the file.
+ */
+int
+uiomux_trace_save (const char * filename);
+
+/**
+ * Log a register access; called by the inline helpers.
+ * \param address Physical address of the register
+ * \param value Value read or written
+ * \param op UIOMUX_TRACE_READ or UIOMUX_TRACE_WRITE
+ */
+void
+uiomux_trace_log (unsigned long address, uint32_t value, int op);
+
+/**
+ * Read a 32-bit register.
+ * \param mmio Descriptor of an MMIO region, see uiomux_get_mmio_desc()
+ * \param offset Byte offset of the register in the region
+ * \returns Value of the register
+ */
+static inline uint32_t
+uiomux_reg_read (const struct uiomux_map_desc * mmio, unsigned long offset)
+{
+  uint32_t value;
+
+  value = *(volatile uint32_t *) ((char *) mmio->virt + offset);
+#ifdef UIOMUX_TRACE
+  if (uiomux_trace_active)
+    uiomux_trace_log (mmio->phys + offset, value, UIOMUX_TRACE_READ);
+#endif
+
+  return value;
+}
+
+/**
+ * Write a 32-bit register.
+ * \param mmio Descriptor of an MMIO region, see uiomux_get_mmio_desc()
+ * \param offset Byte offset of the register in the region
+ * \param value Value to write
+ */
+static inline void
+uiomux_reg_write (const struct uiomux_map_desc * mmio, unsigned long offset,
+                  uint32_t value)
+{
+  *(volatile uint32_t *) ((char *) mmio->virt + offset) = value;
+#ifdef UIOMUX_TRACE
+  if (uiomux_trace_active)
+    uiomux_trace_log (mmio->phys + offset, value, UIOMUX_TRACE_WRITE);
+#endif
+}
+
+#endif /* __UIOMUX_TRACE_H__ */
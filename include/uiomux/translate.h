@@ -0,0 +1,111 @@
+/*
+ * UIOMux: a conflict manager for system resources, including UIO devices.
+ * Copyright (C) 2009 Renesas Technology Corp.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston MA  02110-1301 USA
+ */
+
+#ifndef __UIOMUX_TRANSLATE_H__
+#define __UIOMUX_TRANSLATE_H__
+
+/** \file
+ * Inline address translation for UIO managed resources.
+ *
+ * The MMIO and user memory regions of a resource are each mapped as one
+ * contiguous block, so translating an address within them is a matter
+ * of adding an offset. uiomux_get_mem_desc() and uiomux_get_mmio_desc()
+ * return a descriptor of a region once; the inline functions here then
+ * translate addresses without calling into the library. A descriptor
+ * remains valid until the UIOMux handle it came from is closed.
+ */
+
+/**
+ * A contiguous mapping of a region, see uiomux_get_mem_desc().
+ */
+struct uiomux_map_desc {
+  /** Virtual address of the start of the region */
+  void * virt;
+  /** Physical address of the start of the region */
+  unsigned long phys;
+  /** Size of the region in bytes */
+  unsigned long size;
+};
+
+/**
+ * Get a descriptor of the user memory region of a UIO managed resource.
+ * \param uiomux A UIOMux handle
+ * \param resource A single named resource
+ * \param desc Return for the descriptor
+ * \retval 0 Success
+ * \retval -1 Failure: resource not managed, or more than one resource given.
+ */
+int
+uiomux_get_mem_desc (UIOMux * uiomux, uiomux_resource_t resource,
+                     struct uiomux_map_desc * desc);
+
+/**
+ * Get a descriptor of the MMIO region of a UIO managed resource.
+ * \param uiomux A UIOMux handle
+ * \param resource A single named resource
+ * \param desc Return for the descriptor
+ * \retval 0 Success
+ * \retval -1 Failure: resource not managed, or more than one resource given.
+ */
+int
+uiomux_get_mmio_desc (UIOMux * uiomux, uiomux_resource_t resource,
+                      struct uiomux_map_desc * desc);
+
+/**
+ * Convert a virtual address within a region to a physical address.
+ * \param desc A region descriptor
+ * \param virt_address Virtual address to convert
+ * \returns Physical address corresponding to \a virt_address
+ * \retval 0 Failure: \a virt_address is not within the region.
+ */
+static inline unsigned long
+uiomux_desc_virt_to_phys (const struct uiomux_map_desc * desc,
+                          const void * virt_address)
+{
+  unsigned long offset;
+
+  /* Addresses below the region wrap around to large offsets */
+  offset = (unsigned long) virt_address - (unsigned long) desc->virt;
+  if (offset < desc->size)
+    return desc->phys + offset;
+
+  return 0;
+}
+
+/**
+ * Convert a physical address within a region to a virtual address.
+ * \param desc A region descriptor
+ * \param phys_address Physical address to convert
+ * \returns Virtual address corresponding to \a phys_address
+ * \retval NULL Failure: \a phys_address is not within the region.
+ */
+static inline void *
+uiomux_desc_phys_to_virt (const struct uiomux_map_desc * desc,
+                          unsigned long phys_address)
+{
+  unsigned long offset;
+
+  offset = phys_address - desc->phys;
+  if (offset < desc->size)
+    return (char *) desc->virt + offset;
+
+  return NULL;
+}
+
+#endif /* __UIOMUX_TRANSLATE_H__ */
@@ -21,8 +21,12 @@
 #define __UIOMUX_H__
 
 #include <stdlib.h>
+#include <stdint.h>
+#include <pthread.h>
 #include <uiomux/resource.h>
 #include <sys/time.h>
+#include <sys/types.h>
+#include <time.h>
 
 #ifdef __cplusplus
 extern "C" {
@@ -213,6 +217,44 @@ uiomux_open (void);
 UIOMux *
 uiomux_open_blocks(uiomux_resource_t resources);
 
+/**
+ * Flag for uiomux_open_flags(): claim the opened blocks for this handle only.
+ * Each block is locked once at open time and stays locked until the handle
+ * is closed, so uiomux_lock(), uiomux_unlock() and the memory allocation
+ * functions only synchronize the threads of the calling process and need
+ * no system calls. Any handle in another process will block in
+ * uiomux_lock() until the exclusive handle is closed; other handles in the
+ * same process fail to lock the block with EBUSY instead, as waiting would
+ * deadlock the exclusive handle. A block cannot be claimed while another
+ * handle in the process has it locked.
+ */
+#define UIOMUX_OPEN_EXCLUSIVE (1<<0)
+
+/**
+ * Flag for uiomux_open_flags(): map the user memory region of each block
+ * at the same virtual address in every process which opens it with this
+ * flag, so that pointers into the region can be passed between processes
+ * unchanged. The first process to open a block with this flag chooses the
+ * address, and it stays the same until the shared state is destroyed with
+ * uiomux_system_destroy(). A block is not made available if its region is
+ * missing, or if another mapping already occupies the address in the
+ * calling process.
+ */
+#define UIOMUX_OPEN_FIXED_MAP (1<<1)
+
+/**
+ * Create a new UIOMux object for specified IP blocks, with open flags.
+ * Blocks which cannot be opened with the requested flags, for example
+ * blocks which are already locked or have memory allocated by another
+ * handle when UIOMUX_OPEN_EXCLUSIVE is given, are not made available;
+ * use uiomux_check_resource() to test which blocks were opened.
+ * \param resources A named resource, or multiple OR'd together
+ * \param flags Bitwise OR of UIOMUX_OPEN_* flags
+ * \retval NULL on system error; check errno for details.
+ */
+UIOMux *
+uiomux_open_flags(uiomux_resource_t resources, int flags);
+
 /**
  * Create a new UIOMux object for named IP blocks,
  * When UIOMux object is created with this function, each bit in
@@ -229,6 +271,8 @@ uiomux_open_named(const char *name[]);
  * Close a UIOMux handle, removing exclusive access, removing memory maps, etc.
  * \param uiomux A UIOMux handle
  * \retval 0 Success
+ * \retval -1 Failure: called from a watchdog or dispatcher callback of the
+ *            handle (errno is EDEADLK); the handle stays open
  */
 int
 uiomux_close (UIOMux * uiomux);
@@ -261,6 +305,8 @@ char *uiomux_check_name(struct uiomux *uiomux, uiomux_resource_t resource);
  * \param uiomux A UIOMux handle
  * \param resources A named resource, or multiple OR'd together
  * \retval 0 Success
+ * \retval -1 Failure; errno is EBUSY if a block is claimed by an exclusive
+ *            handle in the same process, which would never release it
  */
 int
 uiomux_lock (UIOMux * uiomux, uiomux_resource_t resources);
@@ -298,9 +344,97 @@ uiomux_sleep_timeout (UIOMux * uiomux, uiomux_resource_t resource,
 		struct timeval *timeout);
 
 /**
- * Wake up any processes waiting for UIO events via a uiomux_sleep*
- * command.
- * The woken processes should be all confirm being woken before
+ * Wait for a UIO managed resource to complete its activity, until an
+ * absolute deadline. Unlike uiomux_sleep_timeout(), a wait that is
+ * interrupted by a signal is resumed without extending the total wait.
+ * \param uiomux A UIOMux handle
+ * \param resource A single named resource
+ * \param deadline Absolute time on CLOCK_MONOTONIC to give up waiting
+ *                 NULL -> no timeout
+ *                 in the past -> return immediately (after checking
+ *                 interrupt status)
+ * \retval 0 Success
+ * \retval -1 No interrupt occured before the deadline or uiomux was closed
+ */
+int
+uiomux_sleep_deadline (UIOMux * uiomux, uiomux_resource_t resource,
+		const struct timespec *deadline);
+
+/**
+ * Wait for any of several UIO managed resources to complete its activity.
+ * Interrupts are enabled on all the given resources, and a single wait is
+ * made for the first of them to fire.
+ * \param uiomux A UIOMux handle
+ * \param resources Multiple named resources OR'd together; resources
+ *                  not managed by \a uiomux are ignored
+ * \param deadline Absolute time on CLOCK_MONOTONIC to give up waiting,
+ *                 as for uiomux_sleep_deadline(); NULL -> no timeout
+ * \param fired Return for the resources which have completed, OR'd
+ *              together (ignored if NULL)
+ * \retval 0 Success
+ * \retval -1 No interrupt occured before the deadline, uiomux_wakeup() was
+ *            called for one of the resources, or none of the resources
+ *            is managed
+ */
+int
+uiomux_sleep_any (UIOMux * uiomux, uiomux_resource_t resources,
+		const struct timespec *deadline, uiomux_resource_t *fired);
+
+/**
+ * A status register polled by uiomux_sleep_adaptive(). The activity is
+ * complete when the 32-bit register at \a offset in the MMIO region reads
+ * \a value in the bits set in \a mask.
+ */
+struct uiomux_poll_reg {
+  unsigned long offset;	/**< Byte offset in the MMIO region */
+  unsigned long mask;	/**< Bits of the register to test */
+  unsigned long value;	/**< Value of the tested bits on completion */
+};
+
+/**
+ * Configure spinning in uiomux_sleep_adaptive() for a UIO managed resource.
+ * Spinning is disabled by default.
+ * \param uiomux A UIOMux handle
+ * \param resource A single named resource
+ * \param max_spin_us Longest time to spin before sleeping, in us;
+ *                    0 disables spinning
+ * \param autotune If non-zero, the spin budget follows the observed
+ *                 completion times, up to \a max_spin_us: activities which
+ *                 take longer than that are waited for without spinning.
+ *                 Otherwise the full \a max_spin_us is always spun.
+ * \retval 0 Success
+ * \retval -1 Failure: resource not managed, or more than one resource given.
+ */
+int
+uiomux_set_spin (UIOMux * uiomux, uiomux_resource_t resource,
+                 unsigned long max_spin_us, int autotune);
+
+/**
+ * Wait for a UIO managed resource to complete its activity, spinning for
+ * up to the budget configured with uiomux_set_spin() before sleeping as
+ * uiomux_sleep() does. This avoids the cost of a sleep and wakeup for
+ * activities which complete in a few tens of microseconds.
+ * If \a reg is NULL, the interrupt is enabled and its count is polled.
+ * Otherwise the status register is polled, and the interrupt is only
+ * enabled if the activity does not complete within the spin budget; the
+ * caller clears the status as it would after uiomux_sleep(). With \a reg,
+ * the interrupt must be level-triggered, or completion may be missed.
+ * \param uiomux A UIOMux handle
+ * \param resource A single named resource
+ * \param reg Status register to poll, or NULL
+ * \retval 0 Success
+ * \retval -1 Failure, or woken up by uiomux_wakeup()
+ */
+int
+uiomux_sleep_adaptive (UIOMux * uiomux, uiomux_resource_t resource,
+                       const struct uiomux_poll_reg * reg);
+
+/**
+ * Wake up all threads sleeping on a resource through this handle in one of
+ * the uiomux_sleep* functions; each of their sleeps returns -1. If no thread
+ * is sleeping, the next sleep on the resource returns -1 at once; several
+ * such wakeups count as one.
+ * The woken threads should all confirm being woken before
  * uiomux_close is called.
  * \param uiomux A UIOMux handle
  * \param resource A single named resource
@@ -309,6 +443,313 @@ uiomux_sleep_timeout (UIOMux * uiomux, uiomux_resource_t resource,
 int
 uiomux_wakeup(struct uiomux *uiomux, uiomux_resource_t resource);
 
+/**
+ * Wake up the thread which has been sleeping longest on a resource through
+ * this handle. As for uiomux_wakeup(), if no thread is sleeping, the next
+ * sleep on the resource returns -1 at once.
+ * \param uiomux A UIOMux handle
+ * \param resource A single named resource
+ * \retval 0 Success
+ * \retval -1 Failure: resource not managed, or more than one resource given.
+ */
+int
+uiomux_wakeup_one (UIOMux * uiomux, uiomux_resource_t resource);
+
+/**
+ * Wake up a particular thread if it is sleeping on any resource of this
+ * handle. Nothing is kept for a later sleep if it is not.
+ * \param uiomux A UIOMux handle
+ * \param thread The thread to wake
+ * \retval 0 Success
+ * \retval -1 The thread is not sleeping on this handle (errno is ESRCH)
+ */
+int
+uiomux_wakeup_thread (UIOMux * uiomux, pthread_t thread);
+
+/**
+ * Function called when a resource has been held for longer than the
+ * threshold given to uiomux_set_watchdog().
+ * \param uiomux The UIOMux handle the watchdog was set on
+ * \param resource The resource that is held
+ * \param pid Process holding the resource
+ * \param tid Thread holding the resource
+ * \param held_ms Time for which the resource has been held, in ms
+ * \param user_data The user_data given to uiomux_set_watchdog()
+ */
+typedef void (*uiomux_watchdog_cb) (UIOMux * uiomux,
+                                    uiomux_resource_t resource,
+                                    pid_t pid, pid_t tid,
+                                    unsigned long held_ms,
+                                    void * user_data);
+
+/**
+ * Watch how long UIO managed resources are held by any process.
+ * A thread is started which checks the lock holders of the given resources.
+ * Each time a resource is held for longer than \a threshold_ms, the shared
+ * watchdog trip counter of the resource is incremented (see
+ * uiomux_get_lockstat()) and \a callback is called from the watchdog thread.
+ * If \a callback is NULL, a message is printed to stderr instead.
+ * Each hold is reported only once. Calling this function again replaces the
+ * previous watchdog settings.
+ * \param uiomux A UIOMux handle
+ * \param resources A named resource, or multiple OR'd together
+ * \param threshold_ms Hold time to report, in ms; 0 disables the watchdog
+ * \param callback Function to call for each overlong hold, or NULL
+ * \param user_data Passed to \a callback
+ * \retval 0 Success
+ * \retval -1 Failure: shared state not available, thread creation failed,
+ *            or called from a watchdog callback (errno is EDEADLK)
+ */
+int
+uiomux_set_watchdog (UIOMux * uiomux, uiomux_resource_t resources,
+                     unsigned long threshold_ms,
+                     uiomux_watchdog_cb callback, void * user_data);
+
+/**
+ * Get the file descriptor which signals interrupts of a UIO managed resource,
+ * for use in an external event loop. The descriptor becomes readable
+ * (POLLIN) when an interrupt enabled with uiomux_irq_enable() has occurred;
+ * call uiomux_irq_ack() to acknowledge it. The descriptor belongs to the
+ * UIOMux handle and must not be read or closed by the caller.
+ * \param uiomux A UIOMux handle
+ * \param resource A single named resource
+ * \returns A file descriptor
+ * \retval -1 Failure: resource not managed, or more than one resource given.
+ */
+int
+uiomux_get_irq_fd (UIOMux * uiomux, uiomux_resource_t resource);
+
+/**
+ * Enable the next interrupt of a UIO managed resource. The UIO driver
+ * disables the interrupt each time it fires, so this must be called before
+ * each activity whose completion is to be waited for on the descriptor
+ * returned by uiomux_get_irq_fd().
+ * \param uiomux A UIOMux handle
+ * \param resource A single named resource
+ * \retval 0 Success
+ * \retval -1 Failure
+ */
+int
+uiomux_irq_enable (UIOMux * uiomux, uiomux_resource_t resource);
+
+/**
+ * Acknowledge interrupts of a UIO managed resource without blocking.
+ * \param uiomux A UIOMux handle
+ * \param resource A single named resource
+ * \param count Return for the total number of interrupts the kernel has
+ *              counted for the device (ignored if NULL). An increase of more
+ *              than one since the previous acknowledgement means that
+ *              interrupts were coalesced or missed.
+ * \retval 0 Success: an interrupt had occurred
+ * \retval -1 No interrupt has occurred since the last acknowledgement
+ *            (errno is EAGAIN), or failure
+ */
+int
+uiomux_irq_ack (UIOMux * uiomux, uiomux_resource_t resource,
+                unsigned long * count);
+
+/**
+ * Flag for uiomux_dispatch_start(): also put completions in a queue to be
+ * read with uiomux_dispatch_poll().
+ */
+#define UIOMUX_DISPATCH_QUEUE (1<<0)
+
+/**
+ * A completion seen by the dispatcher, see uiomux_dispatch_poll().
+ */
+struct uiomux_completion {
+  /** The resource whose interrupt fired */
+  uiomux_resource_t resource;
+  /** Total number of interrupts the kernel has counted for the device */
+  unsigned long irq_count;
+  /** Time of the wakeup, on CLOCK_MONOTONIC */
+  struct timespec time;
+  /** Number of completions dropped before this one because the queue
+   *  was full */
+  unsigned long lost;
+};
+
+/**
+ * Function called by the dispatcher for each completion of a registered
+ * resource, see uiomux_dispatch_register().
+ * \param uiomux The UIOMux handle the dispatcher was started on
+ * \param resource The resource whose interrupt fired
+ * \param irq_count Total number of interrupts the kernel has counted for
+ *                  the device
+ * \param user_data The user_data given to uiomux_dispatch_register()
+ */
+typedef void (*uiomux_completion_cb) (UIOMux * uiomux,
+                                      uiomux_resource_t resource,
+                                      unsigned long irq_count,
+                                      void * user_data);
+
+/**
+ * Start the completion dispatcher of a UIOMux handle. A single thread waits
+ * for the interrupts of all registered resources and calls their callbacks,
+ * so that no sleeper thread is needed per resource. Callbacks are called
+ * one at a time from the dispatcher thread; completions seen in the same
+ * wakeup are delivered in order of resource. The interrupt of each
+ * registered resource is enabled again by the dispatcher before it waits,
+ * so uiomux_sleep() and its variants must not be used on registered
+ * resources. If waiting fails other than by being woken up, the thread
+ * stops and the error is reported by uiomux_dispatch_register(),
+ * uiomux_dispatch_poll() and uiomux_dispatch_stop(). The dispatcher is
+ * stopped by uiomux_close().
+ * \param uiomux A UIOMux handle
+ * \param flags 0, or UIOMUX_DISPATCH_QUEUE to also queue each completion
+ * \retval 0 Success
+ * \retval -1 Failure: dispatcher already started, or thread creation failed
+ */
+int
+uiomux_dispatch_start (UIOMux * uiomux, int flags);
+
+/**
+ * Stop the completion dispatcher of a UIOMux handle and wait for its thread
+ * to finish. This must not be called from a completion callback.
+ * \param uiomux A UIOMux handle
+ * \retval 0 Success, or no dispatcher started
+ * \retval -1 Failure: called from a completion callback (errno is EDEADLK),
+ *            or the dispatcher had stopped on an error, which is left in
+ *            errno; the dispatcher is stopped in that case too
+ */
+int
+uiomux_dispatch_stop (UIOMux * uiomux);
+
+/**
+ * Register resources with the completion dispatcher. Registering a
+ * resource again replaces its callback.
+ * \param uiomux A UIOMux handle
+ * \param resources A named resource, or multiple OR'd together
+ * \param callback Function to call for each completion, or NULL to only
+ *                 queue completions
+ * \param user_data Passed to \a callback
+ * \retval 0 Success
+ * \retval -1 Failure: dispatcher not started, resource not managed, or
+ *            dispatcher stopped on an error, which is left in errno
+ */
+int
+uiomux_dispatch_register (UIOMux * uiomux, uiomux_resource_t resources,
+                          uiomux_completion_cb callback, void * user_data);
+
+/**
+ * Stop dispatching completions of resources. A callback of the resources
+ * may still be running when this returns.
+ * \param uiomux A UIOMux handle
+ * \param resources A named resource, or multiple OR'd together
+ * \retval 0 Success
+ * \retval -1 Failure: dispatcher not started
+ */
+int
+uiomux_dispatch_unregister (UIOMux * uiomux, uiomux_resource_t resources);
+
+/**
+ * Take the oldest completion from the dispatcher queue without blocking.
+ * The queue holds up to 256 completions; further completions are dropped
+ * until there is room again, and counted in the \a lost field of the next
+ * queued completion. Reading is lock-free, so only one thread may call this
+ * function at a time.
+ * \param uiomux A UIOMux handle
+ * \param completion Return for the completion
+ * \retval 1 A completion was returned
+ * \retval 0 The queue is empty
+ * \retval -1 Failure: dispatcher not started with UIOMUX_DISPATCH_QUEUE, or
+ *            the queue is empty and the dispatcher stopped on an error,
+ *            which is left in errno
+ */
+int
+uiomux_dispatch_poll (UIOMux * uiomux, struct uiomux_completion * completion);
+
+/** Wait for interrupts with ppoll(); the default engine */
+#define UIOMUX_ENGINE_POLL 0
+
+/** Wait for interrupts and buffer I/O through an io_uring */
+#define UIOMUX_ENGINE_URING 1
+
+/**
+ * Choose how a UIOMux handle waits for interrupts. With UIOMUX_ENGINE_URING,
+ * each handle owns an io_uring on which polls for the interrupts of its
+ * resources stay armed between waits, and which also carries the buffer
+ * reads and writes of uiomux_io_read() and uiomux_io_write(), so that a
+ * single uiomux_io_wait() can drive a pipeline. uiomux_sleep() and its
+ * variants and the dispatcher use the chosen engine. This must not be called
+ * while another thread is sleeping on the handle.
+ * \param uiomux A UIOMux handle
+ * \param engine UIOMUX_ENGINE_POLL or UIOMUX_ENGINE_URING
+ * \returns The engine in use: UIOMUX_ENGINE_POLL if io_uring was asked for
+ *          but is not supported by the kernel or the build
+ * \retval -1 Failure: unknown engine
+ */
+int
+uiomux_set_engine (UIOMux * uiomux, int engine);
+
+/**
+ * A buffer read or write completed by uiomux_io_wait().
+ */
+struct uiomux_io {
+  /** The user_data given to uiomux_io_read() or uiomux_io_write() */
+  void * user_data;
+  /** Number of bytes transferred, or a negative errno value */
+  long result;
+};
+
+/**
+ * Start reading a file into a buffer, such as one from uiomux_malloc(),
+ * using the io_uring engine. The read completes in uiomux_io_wait().
+ * At most 32 reads and writes may be in flight on a handle, counting
+ * those completed but not yet returned by uiomux_io_wait().
+ * \param uiomux A UIOMux handle using UIOMUX_ENGINE_URING
+ * \param fd File to read
+ * \param buf Buffer to read into; it must stay valid until completion
+ * \param count Number of bytes to read
+ * \param offset File offset to read from, or -1 for the current offset
+ * \param user_data Returned with the completion
+ * \retval 0 Success
+ * \retval -1 Failure: engine not in use (errno is ENOSYS), or too many
+ *            transfers in flight (errno is EAGAIN)
+ */
+int
+uiomux_io_read (UIOMux * uiomux, int fd, void * buf, size_t count,
+                off_t offset, void * user_data);
+
+/**
+ * Start writing a buffer to a file using the io_uring engine.
+ * The write completes in uiomux_io_wait().
+ * \param uiomux A UIOMux handle using UIOMUX_ENGINE_URING
+ * \param fd File to write
+ * \param buf Buffer to write; it must stay valid until completion
+ * \param count Number of bytes to write
+ * \param offset File offset to write at, or -1 for the current offset
+ * \param user_data Returned with the completion
+ * \retval 0 Success
+ * \retval -1 Failure: engine not in use (errno is ENOSYS), or too many
+ *            transfers in flight (errno is EAGAIN)
+ */
+int
+uiomux_io_write (UIOMux * uiomux, int fd, const void * buf, size_t count,
+                 off_t offset, void * user_data);
+
+/**
+ * Wait until any of the given resources has an interrupt or buffer I/O
+ * completes, using the io_uring engine. Several threads may wait on the same
+ * handle; one of them blocks in the kernel and passes on what it reaps.
+ * \param uiomux A UIOMux handle using UIOMUX_ENGINE_URING
+ * \param resources Resources to wait for, OR'd together; may be
+ *                  UIOMUX_NONE to wait for buffer I/O only
+ * \param deadline Absolute time on CLOCK_MONOTONIC at which to give up,
+ *                 or NULL to wait without a time limit
+ * \param fired Return for the resources that had an interrupt (ignored if
+ *              NULL)
+ * \param io Return for completed buffer I/O (ignored if NULL)
+ * \param max_io Number of entries available in \a io
+ * \returns The number of completions returned in \a io; if 0, an
+ *          interrupt has occurred
+ * \retval -1 Timed out, woken up by uiomux_wakeup(), or failure
+ */
+int
+uiomux_io_wait (UIOMux * uiomux, uiomux_resource_t resources,
+                const struct timespec * deadline, uiomux_resource_t * fired,
+                struct uiomux_io * io, int max_io);
+
 /**
  * Get the address and size of the MMIO region for a UIO managed resource.
  * \param uiomux A UIOMux handle
@@ -359,6 +800,61 @@ uiomux_virt_to_phys (UIOMux * uiomux, uiomux_resource_t resource,
 unsigned long
 uiomux_all_virt_to_phys (void * virt_address);
 
+/**
+ * Convert a physical address to a virtual address, searching the memory
+ * and MMIO regions of every resource opened by this process and every
+ * region registered with uiomux_register(). If several mappings of the
+ * address exist, for example because a resource is open through more
+ * than one UIOMux handle, any one of them is returned.
+ * \param phys_address Physical address to convert
+ * \returns Virtual address corresponding to mapped physical address
+ * \retval NULL Failure: physical address is not managed by UIOMux.
+ */
+void *
+uiomux_all_phys_to_virt (unsigned long phys_address);
+
+/**
+ * A range of virtual memory to translate, see uiomux_all_virt_to_phys_sg().
+ */
+struct uiomux_iovec {
+  /** Virtual address of the start of the range */
+  void * virt;
+  /** Length of the range in bytes */
+  size_t len;
+};
+
+/**
+ * A physically contiguous part of a range translated by
+ * uiomux_all_virt_to_phys_sg().
+ */
+struct uiomux_segment {
+  /** Physical address of the segment, or 0 for a gap */
+  unsigned long phys;
+  /** Length of the segment in bytes */
+  size_t len;
+  /** Index of the range in the input array this segment belongs to */
+  int index;
+  /** Nonzero if the segment is not in any region managed by UIOMux */
+  int gap;
+};
+
+/**
+ * Convert a list of virtual memory ranges to physical segments, in one
+ * lookup. Each range is split into one segment per region it covers, in
+ * order of address, so segments never cross a region boundary even if
+ * neighbouring regions happen to be physically contiguous. Any part of a
+ * range outside all regions becomes a segment with \a gap set.
+ * \param iov Array of ranges to translate
+ * \param iovcnt Number of ranges in \a iov
+ * \param segs Array for the segments
+ * \param max_segs Size of \a segs
+ * \returns Number of segments stored in \a segs
+ * \retval -1 Failure: \a segs is too small, errno is set to ENOSPC.
+ */
+int
+uiomux_all_virt_to_phys_sg (const struct uiomux_iovec * iov, int iovcnt,
+                            struct uiomux_segment * segs, int max_segs);
+
 /**
  * Convert a physical address to a virtual address
  * \param uiomux A UIOMux handle
@@ -450,7 +946,7 @@ uiomux_free (UIOMux * uiomux, uiomux_resource_t resource,
 /**
  * Register a region of memory as accessible by the resources.
  * This region is included in the list of regions covered by
- * uiomux_all_virt_to_phys.
+ * uiomux_all_virt_to_phys and uiomux_all_phys_to_virt.
  * \param virt Virtual address of memory region
  * \param phys_address Physical address of memory region
  * \param size Size of memory region
@@ -462,16 +958,103 @@ uiomux_register (void *virt, unsigned long phys_address, size_t size);
 /**
  * Unregister a region of memory as accessible by the resources.
  * This region is removed from the list of regions covered by
- * uiomux_all_virt_to_phys.
+ * uiomux_all_virt_to_phys and uiomux_all_phys_to_virt.
  * \param virt Virtual address of memory region
  * \retval 0 Success
  */
 int
 uiomux_unregister (void *virt);
 
+/**
+ * Pin a buffer of ordinary user memory for use by the resources. The pages
+ * of the buffer are locked in memory with mlock(), their physical frames
+ * are read from /proc/self/pagemap, and the buffer is returned as a list
+ * of physically contiguous runs, in order. Each run is also registered as
+ * with uiomux_register(). Pinning the same buffer again, with the same
+ * address and length, returns the runs found by the first pin without any
+ * system calls; each call must be matched by a call to uiomux_unpin().
+ * Reading physical frames requires CAP_SYS_ADMIN on Linux 4.0 and later.
+ *
+ * mlock() keeps the pages in memory but does not fix their physical
+ * frames: the kernel may still move them, for memory compaction, NUMA
+ * balancing or transparent huge pages, and a page written after fork() is
+ * copied to a new frame in the writing process. The runs returned, and
+ * the regions registered for uiomux_all_virt_to_phys(), may then name
+ * frames which no longer hold the buffer. The runs are only a snapshot,
+ * for hardware which tolerates that or systems where the kernel does not
+ * move such pages; memory from uiomux_malloc() is the safe choice for DMA.
+ * A pinned buffer must not be written by either process across a fork().
+ * \param virt Start of the buffer
+ * \param len Length of the buffer in bytes
+ * \param segs Array for the runs; \a index and \a gap are always 0
+ * \param max_segs Size of \a segs
+ * \returns Number of runs stored in \a segs
+ * \retval -1 Failure: the buffer could not be locked, or its physical
+ *            frames could not be read (EPERM without CAP_SYS_ADMIN), or
+ *            \a segs is too small (ENOSPC); errno is set.
+ */
+int
+uiomux_pin (void * virt, size_t len, struct uiomux_segment * segs,
+            int max_segs);
+
+/**
+ * Release a buffer pinned with uiomux_pin(). When it has been unpinned as
+ * many times as it was pinned, its runs are unregistered and its pages are
+ * unlocked, except for pages shared with other pinned buffers.
+ * \param virt Start of the buffer, as given to uiomux_pin()
+ * \param len Length of the buffer, as given to uiomux_pin()
+ * \retval 0 Success
+ * \retval -1 Failure: the buffer is not pinned.
+ */
+int
+uiomux_unpin (void * virt, size_t len);
+
+/**
+ * Mask of a register command which writes the whole register.
+ */
+#define UIOMUX_REG_ALL 0xffffffff
+
+/**
+ * A register write in a command list, see uiomux_apply_cmds().
+ */
+struct uiomux_reg_cmd {
+  /** Byte offset of the 32-bit register in the MMIO region */
+  unsigned long offset;
+  /** Value to write */
+  uint32_t value;
+  /** Bits of the register to set from \a value; the others are kept.
+   * UIOMUX_REG_ALL writes the register without reading it first. */
+  uint32_t mask;
+};
+
+/**
+ * Apply a command list to the registers of a UIO managed resource. The
+ * list is built ahead of time, without holding the lock; this call then
+ * makes the writes in order, back to back. A memory barrier before the
+ * first write makes earlier stores, eg. to buffers the job uses, visible
+ * to the device first, and one after the last write completes the list
+ * before eg. a following start register write or uiomux_unlock().
+ * All offsets are checked before any register is written. If register
+ * tracing is started, the writes are logged as by uiomux_reg_write().
+ * \param uiomux A UIOMux handle
+ * \param resource A single named resource, locked with uiomux_lock()
+ * \param cmds Array of register writes
+ * \param count Number of entries in \a cmds
+ * \retval 0 Success
+ * \retval -1 Failure: resource not managed, or more than one resource
+ *            given, or an offset outside the MMIO region or not 32-bit
+ *            aligned (EINVAL); resource not locked by \a uiomux (EPERM).
+ */
+int
+uiomux_apply_cmds (UIOMux * uiomux, uiomux_resource_t resource,
+                   const struct uiomux_reg_cmd * cmds, int count);
+
 
 #include <uiomux/system.h>
 #include <uiomux/dump.h>
+#include <uiomux/stats.h>
+#include <uiomux/translate.h>
+#include <uiomux/trace.h>
 
 #ifdef __cplusplus
 }
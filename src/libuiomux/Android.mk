@@ -8,8 +8,17 @@ LOCAL_C_INCLUDES := \
 LOCAL_CFLAGS := -DVERSION=\"1.0.0\"
 
 LOCAL_SRC_FILES := \
+	dispatch.c \
+	dump.c \
+	pin.c \
+	region.c \
+	sampler.c \
+	shm.c \
+	trace.c \
 	uio.c \
-	uiomux.c
+	uiomux.c \
+	uring.c \
+	watchdog.c
 
 LOCAL_SHARED_LIBRARIES += libbinder libcutils libutils
 
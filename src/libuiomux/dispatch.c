@@ -0,0 +1,338 @@
+/*
+ * UIOMux: a conflict manager for system resources, including UIO devices.
+ * Copyright (C) 2009 Renesas Technology Corp.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston MA  02110-1301 USA
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <time.h>
+
+#include "uiomux/uiomux.h"
+#include "uiomux_private.h"
+#include "uio.h"
+
+/* #define DEBUG */
+
+/* Number of entries in the completion queue; must be a power of 2 */
+#define DISPATCH_QUEUE_SIZE 256
+
+struct uiomux_dispatch {
+	pthread_t thread;
+	pthread_mutex_t lock;
+	pthread_cond_t cond;
+	int stop;
+	int flags;
+	int error;		/* errno of a failure that stopped the thread */
+
+	/* Registered resources and their callbacks, protected by lock */
+	uiomux_resource_t resources;
+	uiomux_completion_cb callbacks[UIOMUX_BLOCK_MAX];
+	void *user_data[UIOMUX_BLOCK_MAX];
+
+	/* Resources the thread is currently sleeping on, protected by lock */
+	uiomux_resource_t waiting;
+	struct uio_thread *self;
+
+	/* Single producer (the dispatch thread), single consumer queue.
+	   Each index is only written by its owner. */
+	struct uiomux_completion queue[DISPATCH_QUEUE_SIZE];
+	volatile unsigned int head;	/* next entry to write */
+	volatile unsigned int tail;	/* next entry to read */
+	unsigned long lost;		/* dropped since the last queued entry */
+};
+
+/* Interrupt the sleep of the dispatch thread. Called with dp->lock held.
+   A wakeup sent just before the thread sleeps ends that sleep at once. */
+static void dispatch_kick(struct uiomux_dispatch *dp)
+{
+	if (dp->waiting == UIOMUX_NONE)
+		pthread_cond_signal(&dp->cond);
+	else
+		uio_thread_wake(dp->self);
+}
+
+static void dispatch_queue(struct uiomux_dispatch *dp,
+			   uiomux_resource_t resource, unsigned long count,
+			   const struct timespec *now)
+{
+	unsigned int head = dp->head;
+	struct uiomux_completion *c;
+
+	if (head - dp->tail == DISPATCH_QUEUE_SIZE) {
+		dp->lost++;
+		return;
+	}
+
+	c = &dp->queue[head & (DISPATCH_QUEUE_SIZE - 1)];
+	c->resource = resource;
+	c->irq_count = count;
+	c->time = *now;
+	c->lost = dp->lost;
+	dp->lost = 0;
+
+	/* Publish the entry before the new head */
+	__sync_synchronize();
+	dp->head = head + 1;
+}
+
+static void *dispatch_main(void *arg)
+{
+	struct uiomux *uiomux = (struct uiomux *)arg;
+	struct uiomux_dispatch *dp = uiomux->dispatch;
+	struct uio *uios[UIOMUX_BLOCK_MAX];
+	uiomux_completion_cb callbacks[UIOMUX_BLOCK_MAX];
+	void *user_data[UIOMUX_BLOCK_MAX];
+	int index[UIOMUX_BLOCK_MAX];
+	struct timespec now;
+	int i, k, n, ret, fired;
+
+	pthread_mutex_lock(&dp->lock);
+	dp->self = uio_thread_self();
+	if (dp->self == NULL)
+		dp->stop = 1;
+	while (!dp->stop) {
+		if (dp->resources == UIOMUX_NONE) {
+			pthread_cond_wait(&dp->cond, &dp->lock);
+			continue;
+		}
+
+		/* Take a snapshot of the registrations for this round */
+		n = 0;
+		for (i = 0; i < UIOMUX_BLOCK_MAX; i++) {
+			if (dp->resources & (1 << i)) {
+				uios[n] = uiomux->uios[i];
+				callbacks[n] = dp->callbacks[i];
+				user_data[n] = dp->user_data[i];
+				index[n++] = i;
+			}
+		}
+		dp->waiting = dp->resources;
+		pthread_mutex_unlock(&dp->lock);
+
+		ret = uio_sleep_any(uios, n, NULL, &fired);
+
+		pthread_mutex_lock(&dp->lock);
+		dp->waiting = UIOMUX_NONE;
+		/* Anything but a wakeup would only fail again at once */
+		if (ret < 0 && errno != EINTR) {
+			dp->error = errno;
+			break;
+		}
+		pthread_mutex_unlock(&dp->lock);
+
+		/* Woken up to stop or to pick up new registrations */
+		if (ret == 0) {
+			clock_gettime(CLOCK_MONOTONIC, &now);
+
+			/* Completions of one wakeup go out in resource order */
+			for (k = 0; k < n; k++) {
+				if (!(fired & (1 << k)))
+					continue;
+#ifdef DEBUG
+				fprintf(stderr, "%s: Completion of block %d\n",
+					__func__, index[k]);
+#endif
+				if (dp->flags & UIOMUX_DISPATCH_QUEUE)
+					dispatch_queue(dp, 1 << index[k],
+						       uios[k]->irq_count, &now);
+				if (callbacks[k])
+					callbacks[k](uiomux, 1 << index[k],
+						     uios[k]->irq_count,
+						     user_data[k]);
+			}
+		}
+
+		pthread_mutex_lock(&dp->lock);
+	}
+	pthread_mutex_unlock(&dp->lock);
+
+	return NULL;
+}
+
+int uiomux_dispatch_start(struct uiomux *uiomux, int flags)
+{
+	struct uiomux_dispatch *dp;
+	int ret;
+
+	if (uiomux == NULL)
+		return -1;
+
+	if (uiomux->dispatch != NULL) {
+		errno = EBUSY;
+		return -1;
+	}
+
+	dp = (struct uiomux_dispatch *)calloc(1, sizeof(*dp));
+	if (dp == NULL)
+		return -1;
+
+	dp->flags = flags;
+	pthread_mutex_init(&dp->lock, NULL);
+	pthread_cond_init(&dp->cond, NULL);
+
+	uiomux->dispatch = dp;
+
+	ret = pthread_create(&dp->thread, NULL, dispatch_main, uiomux);
+	if (ret != 0) {
+		pthread_cond_destroy(&dp->cond);
+		pthread_mutex_destroy(&dp->lock);
+		free(dp);
+		uiomux->dispatch = NULL;
+		errno = ret;
+		return -1;
+	}
+
+	return 0;
+}
+
+/* Nonzero if called from the dispatcher thread of the handle */
+int uiomux_dispatch_self(struct uiomux *uiomux)
+{
+	struct uiomux_dispatch *dp = uiomux->dispatch;
+
+	return dp != NULL && pthread_equal(pthread_self(), dp->thread);
+}
+
+int uiomux_dispatch_stop(struct uiomux *uiomux)
+{
+	struct uiomux_dispatch *dp;
+	int error;
+
+	if (uiomux == NULL)
+		return -1;
+
+	dp = uiomux->dispatch;
+	if (dp == NULL)
+		return 0;
+
+	/* A callback cannot wait for its own thread to finish */
+	if (uiomux_dispatch_self(uiomux)) {
+		errno = EDEADLK;
+		return -1;
+	}
+
+	pthread_mutex_lock(&dp->lock);
+	dp->stop = 1;
+	dispatch_kick(dp);
+	pthread_mutex_unlock(&dp->lock);
+
+	pthread_join(dp->thread, NULL);
+
+	error = dp->error;
+	pthread_cond_destroy(&dp->cond);
+	pthread_mutex_destroy(&dp->lock);
+	free(dp);
+	uiomux->dispatch = NULL;
+
+	if (error) {
+		errno = error;
+		return -1;
+	}
+
+	return 0;
+}
+
+int uiomux_dispatch_register(struct uiomux *uiomux,
+			     uiomux_resource_t blockmask,
+			     uiomux_completion_cb callback, void *user_data)
+{
+	struct uiomux_dispatch *dp;
+	int i;
+
+	if (uiomux == NULL || (dp = uiomux->dispatch) == NULL)
+		return -1;
+
+	/* Invalid if any of the blocks is not managed */
+	for (i = 0; i < UIOMUX_BLOCK_MAX; i++) {
+		if ((blockmask & (1 << i)) && uiomux->uios[i] == NULL)
+			return -1;
+	}
+
+	pthread_mutex_lock(&dp->lock);
+	if (dp->error) {
+		errno = dp->error;
+		pthread_mutex_unlock(&dp->lock);
+		return -1;
+	}
+	for (i = 0; i < UIOMUX_BLOCK_MAX; i++) {
+		if (blockmask & (1 << i)) {
+			dp->callbacks[i] = callback;
+			dp->user_data[i] = user_data;
+		}
+	}
+	dp->resources |= blockmask;
+	dispatch_kick(dp);
+	pthread_mutex_unlock(&dp->lock);
+
+	return 0;
+}
+
+int uiomux_dispatch_unregister(struct uiomux *uiomux,
+			       uiomux_resource_t blockmask)
+{
+	struct uiomux_dispatch *dp;
+
+	if (uiomux == NULL || (dp = uiomux->dispatch) == NULL)
+		return -1;
+
+	pthread_mutex_lock(&dp->lock);
+	dp->resources &= ~blockmask;
+	if (dp->waiting & blockmask)
+		dispatch_kick(dp);
+	pthread_mutex_unlock(&dp->lock);
+
+	return 0;
+}
+
+int uiomux_dispatch_poll(struct uiomux *uiomux,
+			 struct uiomux_completion *completion)
+{
+	struct uiomux_dispatch *dp;
+	unsigned int tail;
+
+	if (uiomux == NULL || (dp = uiomux->dispatch) == NULL ||
+	    !(dp->flags & UIOMUX_DISPATCH_QUEUE))
+		return -1;
+
+	tail = dp->tail;
+	if (tail == dp->head) {
+		/* Once the queue is drained, report why the thread stopped */
+		if (dp->error) {
+			errno = dp->error;
+			return -1;
+		}
+		return 0;
+	}
+
+	/* Read the entry only after seeing the head that published it */
+	__sync_synchronize();
+	*completion = dp->queue[tail & (DISPATCH_QUEUE_SIZE - 1)];
+
+	/* Finish reading before handing the slot back to the producer */
+	__sync_synchronize();
+	dp->tail = tail + 1;
+
+	return 1;
+}
@@ -23,14 +23,15 @@
 
 #include <stdio.h>
 #include <stdarg.h>
+#include <stdint.h>
+#include <fcntl.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/mman.h>
 
-#define FNAME_MAXLINE 4096
+#include "uiomux/uiomux.h"
 
-struct uiomux;
-typedef int uiomux_resource_t;
-unsigned long
-uiomux_get_mmio(struct uiomux *uiomux, uiomux_resource_t blockmask,
-		unsigned long *address, unsigned long *size, void **iomem);
+#define FNAME_MAXLINE 4096
 
 int uiomux_dump_mmio (FILE * stream, struct uiomux *uiomux, uiomux_resource_t blockmask)
 {
@@ -75,3 +76,112 @@ int uiomux_dump_mmio_filename (struct uiomux *uiomux, uiomux_resource_t blockmas
 
 	return ret;
 }
+
+size_t uiomux_snapshot_size (struct uiomux *uiomux, uiomux_resource_t blockmask)
+{
+	unsigned long size;
+
+	if (uiomux_get_mmio (uiomux, blockmask, NULL, &size, NULL) == 0)
+		return 0;
+
+	return sizeof (struct uiomux_snapshot) + (size & ~3UL);
+}
+
+int uiomux_snapshot_mmio (struct uiomux *uiomux, uiomux_resource_t blockmask,
+			  struct uiomux_snapshot *snap, size_t size)
+{
+	unsigned long address, mmio_size;
+	volatile uint32_t *cur;
+	uint32_t *regs;
+	struct timespec now;
+	unsigned long i, n;
+
+	address = uiomux_get_mmio (uiomux, blockmask, NULL,
+				   &mmio_size, (void **)&cur);
+
+	if (address == 0) return -1;
+
+	n = mmio_size / sizeof(uint32_t);
+	if (size < sizeof (*snap) + n * sizeof(uint32_t)) return -1;
+
+	clock_gettime (CLOCK_MONOTONIC, &now);
+	snap->magic = UIOMUX_SNAPSHOT_MAGIC;
+	snap->version = UIOMUX_SNAPSHOT_VERSION;
+	snap->resource = blockmask;
+	snap->size = n * sizeof(uint32_t);
+	snap->address = address;
+	snap->time_ns = (uint64_t)now.tv_sec * 1000000000 + now.tv_nsec;
+
+	/* Registers must be read with 32-bit accesses, so no memcpy() */
+	regs = snap->regs;
+	for (i=0; i<n; i++)
+		regs[i] = cur[i];
+
+	return 0;
+}
+
+int uiomux_snapshot_mmio_filename (struct uiomux *uiomux, uiomux_resource_t blockmask,
+				   const char *fmt, ...)
+{
+	va_list ap;
+	char buf[FNAME_MAXLINE];
+	struct uiomux_snapshot *snap;
+	size_t size;
+	int fd, ret;
+
+	if ((size = uiomux_snapshot_size (uiomux, blockmask)) == 0)
+		return -1;
+
+	va_start (ap, fmt);
+	vsnprintf (buf, FNAME_MAXLINE, fmt, ap);
+	va_end (ap);
+
+	if ((fd = open (buf, O_RDWR | O_CREAT | O_TRUNC, 0644)) < 0)
+		return -1;
+
+	if (ftruncate (fd, size) < 0) {
+		close (fd);
+		return -1;
+	}
+
+	snap = mmap (NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+	close (fd);
+	if (snap == MAP_FAILED)
+		return -1;
+
+	ret = uiomux_snapshot_mmio (uiomux, blockmask, snap, size);
+
+	munmap (snap, size);
+
+	return ret;
+}
+
+int uiomux_snapshot_diff (const struct uiomux_snapshot *a,
+			  const struct uiomux_snapshot *b,
+			  struct uiomux_reg_change *changes, int max_changes)
+{
+	unsigned long i, n;
+	int count = 0;
+
+	if (a->magic != UIOMUX_SNAPSHOT_MAGIC ||
+	    b->magic != UIOMUX_SNAPSHOT_MAGIC ||
+	    a->version != UIOMUX_SNAPSHOT_VERSION ||
+	    b->version != UIOMUX_SNAPSHOT_VERSION ||
+	    a->address != b->address || a->size != b->size)
+		return -1;
+
+	n = a->size / sizeof(uint32_t);
+
+	for (i=0; i<n; i++) {
+		if (a->regs[i] == b->regs[i])
+			continue;
+		if (count < max_changes) {
+			changes[count].offset = i * sizeof(uint32_t);
+			changes[count].old_value = a->regs[i];
+			changes[count].new_value = b->regs[i];
+		}
+		count++;
+	}
+
+	return count;
+}
@@ -0,0 +1,312 @@
+/*
+ * UIOMux: a conflict manager for system resources, including UIO devices.
+ * Copyright (C) 2009 Renesas Technology Corp.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston MA  02110-1301 USA
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+#include <unistd.h>
+#include <sys/mman.h>
+
+#include "uiomux/uiomux.h"
+#include "uiomux_private.h"
+
+/* #define DEBUG */
+
+#define PAGEMAP_PATH "/proc/self/pagemap"
+
+/* Page frame number and present bit of a pagemap entry */
+#define PAGEMAP_PFN_MASK	((1ULL << 55) - 1)
+#define PAGEMAP_PRESENT		(1ULL << 63)
+
+/* Pagemap entries read at once */
+#define PAGEMAP_BATCH 512
+
+/* A pinned buffer and its physically contiguous runs */
+struct uio_pin {
+	void *virt;
+	size_t len;
+	int refcount;
+	int nr_runs;
+	struct uio_pin *next;
+	struct uiomux_segment runs[];
+};
+
+static pthread_mutex_t pin_lock = PTHREAD_MUTEX_INITIALIZER;
+static struct uio_pin *pins = NULL;
+
+static struct uio_pin *pin_find(void *virt, size_t len, struct uio_pin ***prevp)
+{
+	struct uio_pin **prev, *pin;
+
+	for (prev = &pins; (pin = *prev) != NULL; prev = &pin->next) {
+		if (pin->virt == virt && pin->len == len) {
+			if (prevp)
+				*prevp = prev;
+			return pin;
+		}
+	}
+
+	return NULL;
+}
+
+/* Whether a page is within a pinned buffer other than except */
+static int pin_covers(unsigned long page, long pagesize, struct uio_pin *except)
+{
+	struct uio_pin *pin;
+	unsigned long start, end;
+
+	for (pin = pins; pin != NULL; pin = pin->next) {
+		if (pin == except)
+			continue;
+		start = (unsigned long)pin->virt & ~(pagesize - 1);
+		end = (unsigned long)pin->virt + pin->len;
+		if (page >= start && page < end)
+			return 1;
+	}
+
+	return 0;
+}
+
+/* Add or remove the runs of a pin to the registered regions. Returns -1
+   if adding fails, with any runs already added removed again. */
+static int pin_register(struct uio_pin *pin, int add)
+{
+	char *addr = (char *)pin->virt;
+	int i;
+
+	for (i = 0; i < pin->nr_runs; i++) {
+		if (!add) {
+			uiomux_unregister_region(addr, pin->runs[i].phys,
+						 pin->runs[i].len);
+		} else if (uiomux_register(addr, pin->runs[i].phys,
+					   pin->runs[i].len) != 0) {
+			pin->nr_runs = i;
+			pin_register(pin, 0);
+			return -1;
+		}
+		addr += pin->runs[i].len;
+	}
+
+	return 0;
+}
+
+/* munlock() the pages of a pin which no other pin covers, as page locks
+   do not nest */
+static void pin_munlock(struct uio_pin *pin, long pagesize)
+{
+	unsigned long page, start, end, run = 0;
+
+	start = (unsigned long)pin->virt & ~(pagesize - 1);
+	end = (unsigned long)pin->virt + pin->len;
+
+	for (page = start; page < end; page += pagesize) {
+		if (pin_covers(page, pagesize, pin)) {
+			if (run)
+				munlock((void *)run, page - run);
+			run = 0;
+		} else if (!run) {
+			run = page;
+		}
+	}
+	if (run)
+		munlock((void *)run, page - run);
+}
+
+/* Split locked memory into physically contiguous runs, which follow each
+   other in the buffer. Returns the number of runs, or -1 if the page
+   frames cannot be read. */
+static int pin_resolve(void *virt, size_t len, long pagesize,
+		       struct uiomux_segment *runs)
+{
+	uint64_t entries[PAGEMAP_BATCH];
+	unsigned long start, addr, addr_end, end, phys, page;
+	int fd, n = 0, i, count;
+	ssize_t ret;
+
+	start = (unsigned long)virt & ~(pagesize - 1);
+	end = (unsigned long)virt + len;
+
+	if ((fd = open(PAGEMAP_PATH, O_RDONLY)) < 0)
+		return -1;
+
+	for (page = start; page < end; page += count * pagesize) {
+		count = (end - page + pagesize - 1) / pagesize;
+		if (count > PAGEMAP_BATCH)
+			count = PAGEMAP_BATCH;
+
+		ret = pread(fd, entries, count * sizeof(entries[0]),
+			    (page / pagesize) * sizeof(entries[0]));
+		if (ret != (ssize_t)(count * sizeof(entries[0]))) {
+			if (ret >= 0)
+				errno = EIO;
+			close(fd);
+			return -1;
+		}
+
+		for (i = 0; i < count; i++) {
+			/* Frame numbers read as 0 without CAP_SYS_ADMIN */
+			if (!(entries[i] & PAGEMAP_PRESENT) ||
+			    (entries[i] & PAGEMAP_PFN_MASK) == 0) {
+				close(fd);
+				errno = (entries[i] & PAGEMAP_PRESENT) ?
+					EPERM : EFAULT;
+				return -1;
+			}
+
+			/* The part of the page within the buffer */
+			addr = page + i * pagesize;
+			addr_end = addr + pagesize;
+			phys = (entries[i] & PAGEMAP_PFN_MASK) * pagesize;
+			if (addr < (unsigned long)virt) {
+				phys += (unsigned long)virt - addr;
+				addr = (unsigned long)virt;
+			}
+			if (addr_end > end)
+				addr_end = end;
+
+			if (n > 0 && runs[n - 1].phys + runs[n - 1].len == phys) {
+				runs[n - 1].len += addr_end - addr;
+			} else {
+				runs[n].phys = phys;
+				runs[n].len = addr_end - addr;
+				runs[n].index = 0;
+				runs[n].gap = 0;
+				n++;
+			}
+		}
+	}
+
+	close(fd);
+
+	return n;
+}
+
+int
+uiomux_pin(void *virt, size_t len, struct uiomux_segment *segs, int max_segs)
+{
+	const long pagesize = sysconf(_SC_PAGESIZE);
+	struct uio_pin *pin;
+	unsigned long start, nr_pages;
+	int n, save_errno;
+
+	if (len == 0) {
+		errno = EINVAL;
+		return -1;
+	}
+
+	pthread_mutex_lock(&pin_lock);
+
+	/* The same buffer pinned again costs no system calls, and returns
+	   the frames of the first pin even if the kernel moved pages since */
+	if ((pin = pin_find(virt, len, NULL)) != NULL) {
+		if (pin->nr_runs > max_segs) {
+			pthread_mutex_unlock(&pin_lock);
+			errno = ENOSPC;
+			return -1;
+		}
+		pin->refcount++;
+		memcpy(segs, pin->runs, pin->nr_runs * sizeof(segs[0]));
+		n = pin->nr_runs;
+		pthread_mutex_unlock(&pin_lock);
+		return n;
+	}
+
+	start = (unsigned long)virt & ~(pagesize - 1);
+	nr_pages = ((unsigned long)virt + len - start + pagesize - 1) / pagesize;
+
+	pin = malloc(sizeof(*pin) + nr_pages * sizeof(pin->runs[0]));
+	if (pin == NULL)
+		goto err_unlock;
+	pin->virt = virt;
+	pin->len = len;
+	pin->refcount = 1;
+
+	if (mlock((void *)start, nr_pages * pagesize) < 0)
+		goto err_free;
+
+	if ((n = pin_resolve(virt, len, pagesize, pin->runs)) < 0)
+		goto err_munlock;
+
+	if (n > max_segs) {
+		errno = ENOSPC;
+		goto err_munlock;
+	}
+	pin->nr_runs = n;
+
+	if (pin_register(pin, 1) < 0) {
+		errno = ENOMEM;
+		goto err_munlock;
+	}
+
+	pin->next = pins;
+	pins = pin;
+	memcpy(segs, pin->runs, n * sizeof(segs[0]));
+
+	pthread_mutex_unlock(&pin_lock);
+
+#ifdef DEBUG
+	fprintf(stderr, "%s: %p + %zu pinned in %d runs\n", __func__,
+		virt, len, n);
+#endif
+
+	return n;
+
+err_munlock:
+	save_errno = errno;
+	pin_munlock(pin, pagesize);
+	errno = save_errno;
+err_free:
+	free(pin);
+err_unlock:
+	pthread_mutex_unlock(&pin_lock);
+	return -1;
+}
+
+int
+uiomux_unpin(void *virt, size_t len)
+{
+	const long pagesize = sysconf(_SC_PAGESIZE);
+	struct uio_pin **prev, *pin;
+
+	pthread_mutex_lock(&pin_lock);
+
+	if ((pin = pin_find(virt, len, &prev)) == NULL) {
+		pthread_mutex_unlock(&pin_lock);
+		return -1;
+	}
+
+	if (--pin->refcount == 0) {
+		*prev = pin->next;
+		pin_register(pin, 0);
+		pin_munlock(pin, pagesize);
+		free(pin);
+	}
+
+	pthread_mutex_unlock(&pin_lock);
+
+	return 0;
+}
@@ -0,0 +1,379 @@
+/*
+ * UIOMux: a conflict manager for system resources, including UIO devices.
+ * Copyright (C) 2009 Renesas Technology Corp.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston MA  02110-1301 USA
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <errno.h>
+#include <sched.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "region.h"
+
+/* #define DEBUG */
+
+/* Initial number of entries of a table */
+#define REGION_ALLOC_MIN 16
+
+/* Last region found by this thread in each kind of index, valid while
+   that index is unchanged */
+static __thread struct {
+	struct uio_region_index *index;
+	unsigned int seq;
+	struct uio_region region;
+} last_hit[2];
+
+static unsigned int region_read_begin(struct uio_region_index *index)
+{
+	unsigned int seq;
+
+	/* The writer may have been preempted; let it finish */
+	while ((seq = index->seq) & 1)
+		sched_yield();
+	__sync_synchronize();
+
+	return seq;
+}
+
+static int region_read_retry(struct uio_region_index *index, unsigned int seq)
+{
+	__sync_synchronize();
+	return index->seq != seq;
+}
+
+static void region_write_begin(struct uio_region_index *index)
+{
+	index->seq++;
+	__sync_synchronize();
+}
+
+static void region_write_end(struct uio_region_index *index)
+{
+	__sync_synchronize();
+	index->seq++;
+}
+
+/* The address a region is sorted by */
+static inline unsigned long region_start(struct uio_region_index *index,
+					 const struct uio_region *r)
+{
+	return index->by_phys ? r->phys : (unsigned long)r->virt;
+}
+
+/* Index of the first of count regions starting above addr */
+static size_t region_upper_bound(struct uio_region_index *index,
+				 struct uio_region *regions, size_t count,
+				 unsigned long addr)
+{
+	size_t lo = 0, hi = count, mid;
+
+	while (lo < hi) {
+		mid = lo + (hi - lo) / 2;
+		if (region_start(index, &regions[mid]) <= addr)
+			lo = mid + 1;
+		else
+			hi = mid;
+	}
+
+	return lo;
+}
+
+/* Index + 1 of the last of the first i regions containing addr, or 0 */
+static size_t region_containing(struct uio_region_index *index,
+				struct uio_region *regions, size_t i,
+				unsigned long addr)
+{
+	struct uio_region *r;
+
+	for (; i > 0; i--) {
+		r = &regions[i - 1];
+		if (r->reach <= addr)
+			break;
+		if (addr - region_start(index, r) < r->size)
+			return i;
+	}
+
+	return 0;
+}
+
+/* Recompute the reach of regions from i on, after a region was inserted
+   or removed at i. Past i, once a reach is unchanged so are the rest. */
+static void region_update_reach(struct uio_region_index *index,
+				struct uio_region_table *t, size_t i)
+{
+	unsigned long reach, end;
+	size_t first = i;
+
+	reach = i > 0 ? t->regions[i - 1].reach : 0;
+	for (; i < t->count; i++) {
+		end = region_start(index, &t->regions[i]) + t->regions[i].size;
+		if (end > reach)
+			reach = end;
+		if (i > first && t->regions[i].reach == reach)
+			break;
+		t->regions[i].reach = reach;
+	}
+}
+
+/* Replace a full table with one twice the size */
+static int region_grow(struct uio_region_index *index)
+{
+	struct uio_region_table *t = index->table, *new;
+	size_t alloc, count;
+
+	alloc = t ? t->alloc * 2 : REGION_ALLOC_MIN;
+	count = t ? t->count : 0;
+
+	new = (struct uio_region_table *)
+		malloc(sizeof(*new) + alloc * sizeof(new->regions[0]));
+	if (new == NULL)
+		return -1;
+
+	new->alloc = alloc;
+	new->count = count;
+	new->retired = t;
+	if (count)
+		memcpy(new->regions, t->regions, count * sizeof(t->regions[0]));
+
+	region_write_begin(index);
+	index->table = new;
+	region_write_end(index);
+
+	return 0;
+}
+
+int uio_region_add(struct uio_region_index *index, void *virt,
+		   unsigned long phys, size_t size)
+{
+	struct uio_region_table *t;
+	struct uio_region *r;
+	size_t i;
+
+	if ((t = index->table) == NULL || t->count == t->alloc) {
+		if (region_grow(index) < 0)
+			return -1;
+		t = index->table;
+	}
+
+	i = region_upper_bound(index, t->regions, t->count,
+			       index->by_phys ? phys : (unsigned long)virt);
+
+	region_write_begin(index);
+	memmove(&t->regions[i + 1], &t->regions[i],
+		(t->count - i) * sizeof(t->regions[0]));
+	r = &t->regions[i];
+	r->virt = virt;
+	r->phys = phys;
+	r->size = size;
+	t->count++;
+	region_update_reach(index, t, i);
+	region_write_end(index);
+
+	return 0;
+}
+
+/* Find a region containing addr. The region is copied to a per-thread
+   cache, and the pointer returned refers to that copy. */
+const struct uio_region *uio_region_find(struct uio_region_index *index,
+					 unsigned long addr)
+{
+	struct uio_region_table *t;
+	struct uio_region *r, found;
+	unsigned int seq;
+	size_t i, count;
+	int hit;
+
+	r = &last_hit[index->by_phys].region;
+	do {
+		seq = region_read_begin(index);
+
+		if (last_hit[index->by_phys].index == index &&
+		    last_hit[index->by_phys].seq == seq &&
+		    addr - region_start(index, r) < r->size)
+			return r;
+
+		hit = 0;
+		if ((t = index->table) != NULL) {
+			/* A count read during a change may be stale, but
+			   never exceeds the size of this table */
+			count = t->count;
+			i = region_upper_bound(index, t->regions, count, addr);
+			i = region_containing(index, t->regions, i, addr);
+			if (i > 0) {
+				found = t->regions[i - 1];
+				hit = 1;
+			}
+		}
+	} while (region_read_retry(index, seq));
+
+	if (!hit)
+		return NULL;
+
+	last_hit[index->by_phys].index = index;
+	last_hit[index->by_phys].seq = seq;
+	*r = found;
+
+	return r;
+}
+
+/* Translate ranges into segments, split at region boundaries. Returns the
+   number of segments, or -1 if there are more than max_segs. The index
+   must be sorted by virtual address. Where regions overlap, the one that
+   starts last is used, as in lookups. */
+int uio_region_translate(struct uio_region_index *index,
+			 const struct uiomux_iovec *iov, int iovcnt,
+			 struct uiomux_segment *segs, int max_segs)
+{
+	struct uio_region_table *t;
+	struct uio_region *regions, *r;
+	char *addr, *end, *seg_end;
+	unsigned int seq;
+	size_t i, c, count;
+	int k, n;
+
+	do {
+		seq = region_read_begin(index);
+
+		n = 0;
+		t = index->table;
+		regions = t ? t->regions : NULL;
+		count = t ? t->count : 0;
+
+		for (k = 0; k < iovcnt && n <= max_segs; k++) {
+			addr = (char *)iov[k].virt;
+			end = addr + iov[k].len;
+			i = region_upper_bound(index, regions, count,
+					       (unsigned long)addr);
+
+			while (addr < end) {
+				if (n == max_segs) {
+					/* Counted as too many after the retry */
+					n++;
+					break;
+				}
+
+				/* regions[i] is the first starting above addr;
+				   the region containing addr may start well
+				   below it if regions overlap */
+				while (i < count &&
+				       (char *)regions[i].virt <= addr)
+					i++;
+				c = region_containing(index, regions, i,
+						      (unsigned long)addr);
+				r = c > 0 ? &regions[c - 1] : NULL;
+
+				if (r) {
+					seg_end = (char *)r->virt + r->size;
+					if (seg_end > end)
+						seg_end = end;
+					/* A region starting inside this one
+					   takes over from its start */
+					if (i < count &&
+					    (char *)regions[i].virt < seg_end)
+						seg_end = (char *)regions[i].virt;
+					segs[n].phys = r->phys +
+						(addr - (char *)r->virt);
+					segs[n].gap = 0;
+				} else {
+					seg_end = end;
+					if (i < count &&
+					    (char *)regions[i].virt < end)
+						seg_end = (char *)regions[i].virt;
+					segs[n].phys = 0;
+					segs[n].gap = 1;
+				}
+				segs[n].len = seg_end - addr;
+				segs[n].index = k;
+				n++;
+				addr = seg_end;
+			}
+		}
+	} while (region_read_retry(index, seq));
+
+	if (n > max_segs) {
+		errno = ENOSPC;
+		return -1;
+	}
+
+	return n;
+}
+
+static void region_remove_at(struct uio_region_index *index, size_t i)
+{
+	struct uio_region_table *t = index->table;
+
+	region_write_begin(index);
+	memmove(&t->regions[i], &t->regions[i + 1],
+		(t->count - i - 1) * sizeof(t->regions[0]));
+	t->count--;
+	region_update_reach(index, t, i);
+	region_write_end(index);
+}
+
+/* Remove a region containing addr, and return it in removed (ignored if
+   NULL). Returns -1 if there is none. */
+int uio_region_remove(struct uio_region_index *index, unsigned long addr,
+		      struct uio_region *removed)
+{
+	struct uio_region_table *t = index->table;
+	size_t i;
+
+	if (t == NULL)
+		return -1;
+
+	i = region_upper_bound(index, t->regions, t->count, addr);
+	if ((i = region_containing(index, t->regions, i, addr)) == 0)
+		return -1;
+
+	if (removed)
+		*removed = t->regions[i - 1];
+	region_remove_at(index, i - 1);
+
+	return 0;
+}
+
+/* Remove the region with the same addresses and size as region. Returns
+   -1 if there is none. */
+int uio_region_remove_entry(struct uio_region_index *index,
+			    const struct uio_region *region)
+{
+	struct uio_region_table *t = index->table;
+	struct uio_region *r;
+	unsigned long start = region_start(index, region);
+	size_t i;
+
+	if (t == NULL)
+		return -1;
+
+	i = region_upper_bound(index, t->regions, t->count, start);
+	for (; i > 0; i--) {
+		r = &t->regions[i - 1];
+		if (region_start(index, r) != start)
+			break;
+		if (r->virt == region->virt && r->phys == region->phys &&
+		    r->size == region->size) {
+			region_remove_at(index, i - 1);
+			return 0;
+		}
+	}
+
+	return -1;
+}
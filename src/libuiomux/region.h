@@ -0,0 +1,81 @@
+/*
+ * UIOMux: a conflict manager for system resources, including UIO devices.
+ * Copyright (C) 2009 Renesas Technology Corp.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston MA  02110-1301 USA
+ */
+
+#ifndef __UIOMUX_REGION_H__
+#define __UIOMUX_REGION_H__
+
+#include <stddef.h>
+
+#include "uiomux/uiomux.h"
+
+/* A virtually and physically contiguous region of memory */
+struct uio_region {
+  void *virt;
+  unsigned long phys;
+  size_t size;
+  unsigned long reach;	/* highest end address of this and earlier regions */
+};
+
+/* A table of sorted regions. A table never shrinks; when it is full it
+   is replaced by one twice the size. */
+struct uio_region_table {
+  size_t alloc;
+  volatile size_t count;
+  struct uio_region_table *retired;	/* tables this one replaced */
+  struct uio_region regions[];
+};
+
+/* Regions sorted by virtual or by physical address.
+ *
+ * Regions may overlap: a lookup searches back from the last region
+ * starting at or below an address while the reach of earlier regions
+ * covers it, so it costs O(log n) plus the number of regions overlapping
+ * the address.
+ *
+ * Lookups take no lock: they read the table under a sequence count, and
+ * retry if it changed. Callers must serialise add and remove. Replaced
+ * tables are kept, as a lookup may still be reading them; in total they
+ * are smaller than the current table. */
+struct uio_region_index {
+  struct uio_region_table * volatile table;
+  volatile unsigned int seq;	/* odd while a table is being changed */
+  int by_phys;			/* sorted by physical address */
+};
+
+int
+uio_region_add (struct uio_region_index * index, void * virt,
+                unsigned long phys, size_t size);
+
+int
+uio_region_remove (struct uio_region_index * index, unsigned long addr,
+                   struct uio_region * removed);
+
+int
+uio_region_remove_entry (struct uio_region_index * index,
+                         const struct uio_region * region);
+
+const struct uio_region *
+uio_region_find (struct uio_region_index * index, unsigned long addr);
+
+int
+uio_region_translate (struct uio_region_index * index,
+                      const struct uiomux_iovec * iov, int iovcnt,
+                      struct uiomux_segment * segs, int max_segs);
+
+#endif /* __UIOMUX_REGION_H__ */
@@ -0,0 +1,290 @@
+/*
+ * UIOMux: a conflict manager for system resources, including UIO devices.
+ * Copyright (C) 2009 Renesas Technology Corp.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston MA  02110-1301 USA
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+#include <errno.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <pthread.h>
+#include <time.h>
+#include <sys/prctl.h>
+
+#include "uiomux/uiomux.h"
+#include "uiomux_private.h"
+#include "uio.h"
+
+/* #define DEBUG */
+
+#define SAMPLER_MAX_RATE 1000000
+
+/* Frames in the ring buffer; a power of two */
+#define SAMPLER_RING_FRAMES 4096
+
+/* A sampled status register and its accumulated statistics */
+struct sampler_chan {
+	int index;
+	volatile uint32_t *reg;
+	uint32_t busy_mask;
+	uint32_t state_mask;
+	int state_shift;
+	int was_busy;
+	struct uiomux_samplestat stat;
+};
+
+/*
+ * The sampler thread writes one frame of register values per period at
+ * head. Frames are accumulated into the statistics from tail, under
+ * lock, by uiomux_get_samplestat() or by the thread itself when the ring
+ * fills up, so the sampling loop itself never waits for a reader.
+ */
+struct uiomux_sampler {
+	pthread_t thread;
+	volatile int stop;
+
+	uint64_t period_ns;
+	uint64_t start_ns;
+	volatile unsigned long missed;
+
+	pthread_mutex_t lock;
+	int nr_chans;
+	struct sampler_chan chans[UIOMUX_BLOCK_MAX];
+
+	volatile unsigned long head;
+	volatile unsigned long tail;
+	uint32_t ring[];
+};
+
+/* Accumulate the frames in the ring; call with sampler->lock held */
+static void sampler_drain(struct uiomux_sampler *sampler)
+{
+	struct sampler_chan *chan;
+	unsigned long head, tail;
+	uint32_t *frame, value;
+	unsigned int state;
+	int c, busy;
+
+	head = sampler->head;
+	__sync_synchronize();
+
+	for (tail = sampler->tail; tail != head; tail++) {
+		frame = &sampler->ring[(tail & (SAMPLER_RING_FRAMES - 1)) *
+				       sampler->nr_chans];
+		for (c = 0; c < sampler->nr_chans; c++) {
+			chan = &sampler->chans[c];
+			value = frame[c];
+
+			busy = (value & chan->busy_mask) != 0;
+			chan->stat.samples++;
+			if (busy) {
+				chan->stat.busy++;
+				if (!chan->was_busy)
+					chan->stat.busy_runs++;
+			}
+			chan->was_busy = busy;
+
+			if (chan->state_mask) {
+				state = (value & chan->state_mask) >>
+					chan->state_shift;
+				if (state >= UIOMUX_SAMPLE_STATES)
+					state = UIOMUX_SAMPLE_STATES - 1;
+				chan->stat.states[state]++;
+			}
+		}
+	}
+
+	/* Release the frames to the sampler thread */
+	__sync_synchronize();
+	sampler->tail = head;
+}
+
+static void *sampler_main(void *arg)
+{
+	struct uiomux_sampler *sampler = (struct uiomux_sampler *)arg;
+	uint64_t next, now, late;
+	struct timespec ts;
+	uint32_t *frame;
+	unsigned long head;
+	int c;
+
+	/* Wake up as close to each period as the kernel allows */
+	prctl(PR_SET_TIMERSLACK, 1, 0, 0, 0);
+
+	next = sampler->start_ns;
+	head = sampler->head;
+
+	while (!sampler->stop) {
+		next += sampler->period_ns;
+		now = uio_time_ns();
+		if (now < next) {
+			ts.tv_sec = next / 1000000000;
+			ts.tv_nsec = next % 1000000000;
+			clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &ts,
+					NULL);
+		} else if (now - next >= sampler->period_ns) {
+			/* Skip the periods overslept rather than catch up */
+			late = (now - next) / sampler->period_ns;
+			next += late * sampler->period_ns;
+			sampler->missed += late;
+		}
+
+		if (head - sampler->tail >= SAMPLER_RING_FRAMES / 2) {
+			if (head - sampler->tail >= SAMPLER_RING_FRAMES)
+				pthread_mutex_lock(&sampler->lock);
+			else if (pthread_mutex_trylock(&sampler->lock) != 0)
+				goto sample;
+			sampler_drain(sampler);
+			pthread_mutex_unlock(&sampler->lock);
+		}
+
+sample:
+		frame = &sampler->ring[(head & (SAMPLER_RING_FRAMES - 1)) *
+				       sampler->nr_chans];
+		for (c = 0; c < sampler->nr_chans; c++)
+			frame[c] = *sampler->chans[c].reg;
+
+		/* Publish the frame after its values */
+		__sync_synchronize();
+		sampler->head = ++head;
+	}
+
+	return NULL;
+}
+
+void uiomux_sampler_stop(struct uiomux *uiomux)
+{
+	struct uiomux_sampler *sampler = uiomux->sampler;
+
+	if (sampler == NULL)
+		return;
+
+	sampler->stop = 1;
+	pthread_join(sampler->thread, NULL);
+
+	pthread_mutex_destroy(&sampler->lock);
+	free(sampler);
+	uiomux->sampler = NULL;
+}
+
+int uiomux_set_sampler(struct uiomux *uiomux,
+		       const struct uiomux_sample_reg *regs, int count,
+		       unsigned long rate_hz)
+{
+	struct uiomux_sampler *sampler;
+	struct sampler_chan *chan;
+	struct uio_map *mmio;
+	uiomux_resource_t seen = 0;
+	int c, i, ret;
+
+	if (uiomux == NULL)
+		return -1;
+
+	uiomux_sampler_stop(uiomux);
+
+	if (rate_hz == 0 || count <= 0)
+		return 0;
+
+	if (rate_hz > SAMPLER_MAX_RATE || count > UIOMUX_BLOCK_MAX) {
+		errno = EINVAL;
+		return -1;
+	}
+
+	sampler = calloc(1, sizeof(*sampler) + SAMPLER_RING_FRAMES * count *
+			 sizeof(uint32_t));
+	if (sampler == NULL)
+		return -1;
+
+	for (c = 0; c < count; c++) {
+		/* Exactly one resource bit, managed and not given before */
+		if (regs[c].resource == 0 ||
+		    (regs[c].resource & (regs[c].resource - 1)) ||
+		    (regs[c].resource & seen))
+			goto invalid;
+		seen |= regs[c].resource;
+
+		for (i = 0; !(regs[c].resource & (1U << i)); i++);
+		if (i >= UIOMUX_BLOCK_MAX || uiomux->uios[i] == NULL)
+			goto invalid;
+
+		mmio = &uiomux->uios[i]->mmio;
+		if ((regs[c].offset & 3) || regs[c].offset >= mmio->size ||
+		    mmio->size - regs[c].offset < 4)
+			goto invalid;
+
+		chan = &sampler->chans[c];
+		chan->index = i;
+		chan->reg = (volatile uint32_t *)((char *)mmio->iomem +
+						  regs[c].offset);
+		chan->busy_mask = regs[c].busy_mask;
+		chan->state_mask = regs[c].state_mask;
+		if (chan->state_mask)
+			chan->state_shift = __builtin_ctz(chan->state_mask);
+	}
+
+	sampler->nr_chans = count;
+	sampler->period_ns = 1000000000ULL / rate_hz;
+	sampler->start_ns = uio_time_ns();
+	pthread_mutex_init(&sampler->lock, NULL);
+
+	uiomux->sampler = sampler;
+
+	ret = pthread_create(&sampler->thread, NULL, sampler_main, sampler);
+	if (ret != 0) {
+		pthread_mutex_destroy(&sampler->lock);
+		free(sampler);
+		uiomux->sampler = NULL;
+		errno = ret;
+		return -1;
+	}
+
+	return 0;
+
+invalid:
+	free(sampler);
+	errno = EINVAL;
+	return -1;
+}
+
+int uiomux_get_samplestat(struct uiomux *uiomux, uiomux_resource_t blockmask,
+			  struct uiomux_samplestat *stat)
+{
+	struct uiomux_sampler *sampler;
+	int c;
+
+	if (uiomux == NULL || (sampler = uiomux->sampler) == NULL)
+		return -1;
+
+	for (c = 0; c < sampler->nr_chans; c++) {
+		if (blockmask == (1 << sampler->chans[c].index))
+			break;
+	}
+	if (c == sampler->nr_chans)
+		return -1;
+
+	pthread_mutex_lock(&sampler->lock);
+	sampler_drain(sampler);
+	*stat = sampler->chans[c].stat;
+	pthread_mutex_unlock(&sampler->lock);
+
+	stat->missed = sampler->missed;
+	stat->elapsed_us = (uio_time_ns() - sampler->start_ns) / 1000;
+
+	return 0;
+}
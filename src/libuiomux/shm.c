@@ -0,0 +1,688 @@
+/*
+ * UIOMux: a conflict manager for system resources, including UIO devices.
+ * Copyright (C) 2009 Renesas Technology Corp.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston MA  02110-1301 USA
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <errno.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+#include <unistd.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <sys/mman.h>
+
+#include "shm.h"
+
+/* #define DEBUG */
+
+/* How long to wait for another process to finish initializing the segment */
+#define SHM_INIT_RETRIES 100
+#define SHM_INIT_DELAY_US 1000
+
+static pthread_mutex_t shm_lock = PTHREAD_MUTEX_INITIALIZER;
+static struct uio_shm *shm_map = NULL;
+static int shm_tried = 0;
+
+#ifdef HAVE_SHM_OPEN
+static struct uio_shm *shm_attach(void)
+{
+	struct uio_shm *shm;
+	struct stat st;
+	int fd, creator = 0, i;
+
+	/* Whoever can write the state can stall or mislead every user of
+	   UIOMux, so it is not shared beyond the creator's group, and the
+	   creator's umask applies */
+	fd = shm_open(UIO_SHM_NAME, O_RDWR | O_CREAT | O_EXCL, 0660);
+	if (fd >= 0) {
+		creator = 1;
+		if (ftruncate(fd, sizeof(struct uio_shm)) < 0) {
+			close(fd);
+			shm_unlink(UIO_SHM_NAME);
+			return NULL;
+		}
+	} else if (errno == EEXIST) {
+		fd = shm_open(UIO_SHM_NAME, O_RDWR, 0);
+	}
+
+	if (fd < 0) {
+#ifdef DEBUG
+		perror("shm_open");
+#endif
+		return NULL;
+	}
+
+	/* Wait for the creator to size the segment */
+	for (i = 0; i < SHM_INIT_RETRIES; i++) {
+		if (fstat(fd, &st) < 0) {
+			close(fd);
+			return NULL;
+		}
+		if (st.st_size != 0)
+			break;
+		usleep(SHM_INIT_DELAY_US);
+	}
+
+	if (st.st_size != sizeof(struct uio_shm)) {
+#ifdef DEBUG
+		fprintf(stderr, "%s: incompatible shared state\n", __func__);
+#endif
+		close(fd);
+		return NULL;
+	}
+
+	shm = mmap(NULL, sizeof(struct uio_shm), PROT_READ | PROT_WRITE,
+		   MAP_SHARED, fd, 0);
+	close(fd);
+	if (shm == MAP_FAILED)
+		return NULL;
+
+	if (creator) {
+		/* The segment is zero-filled by ftruncate() */
+		shm->version = UIO_SHM_VERSION;
+		__sync_synchronize();
+		shm->magic = UIO_SHM_MAGIC;
+		return shm;
+	}
+
+	/* Wait for the creator to initialize the segment */
+	for (i = 0; i < SHM_INIT_RETRIES; i++) {
+		if (*(volatile unsigned int *)&shm->magic == UIO_SHM_MAGIC)
+			break;
+		usleep(SHM_INIT_DELAY_US);
+	}
+	__sync_synchronize();
+
+	if (shm->magic != UIO_SHM_MAGIC || shm->version != UIO_SHM_VERSION) {
+		munmap(shm, sizeof(struct uio_shm));
+		return NULL;
+	}
+
+	return shm;
+}
+#else
+static struct uio_shm *shm_attach(void)
+{
+	return NULL;
+}
+#endif
+
+/* Map the shared state once in each process. Returns NULL if the shared
+   state is not available, in which case all statistics and diagnostics
+   are disabled. */
+struct uio_shm *uio_shm_get(void)
+{
+	struct uio_shm *shm;
+
+	pthread_mutex_lock(&shm_lock);
+	if (!shm_tried) {
+		shm_map = shm_attach();
+		shm_tried = 1;
+	}
+	shm = shm_map;
+	pthread_mutex_unlock(&shm_lock);
+
+	return shm;
+}
+
+int uio_shm_unlink(void)
+{
+	int ret = 0;
+
+#ifdef HAVE_SHM_OPEN
+	ret = shm_unlink(UIO_SHM_NAME);
+	if (ret < 0 && errno == ENOENT)
+		ret = 0;
+#endif
+
+	return ret;
+}
+
+/* Called before waiting for a device lock. Returns the wait start time. */
+uint64_t uio_shm_lock_begin(struct uio_shm_device *dev)
+{
+	if (dev == NULL)
+		return 0;
+
+	__sync_fetch_and_add(&dev->waiters, 1);
+
+	return uio_time_ns();
+}
+
+/* Called once the wait for a device lock is over */
+void uio_shm_lock_end(struct uio_shm_device *dev, uint64_t start, int acquired)
+{
+	uint64_t now, wait;
+
+	if (dev == NULL)
+		return;
+
+	__sync_fetch_and_sub(&dev->waiters, 1);
+
+	if (!acquired)
+		return;
+
+	now = uio_time_ns();
+	wait = now - start;
+
+	dev->holder_pid = uio_getpid();
+	dev->holder_tid = uio_gettid();
+	dev->acquired = now;
+	dev->lock_seq++;
+
+	dev->lock_count++;
+	dev->wait_total += wait;
+	if (wait > dev->wait_max)
+		dev->wait_max = wait;
+}
+
+/* Called by the lock holder before releasing a device lock */
+void uio_shm_unlock(struct uio_shm_device *dev)
+{
+	uint64_t hold;
+
+	if (dev == NULL || dev->holder_pid == 0)
+		return;
+
+	hold = uio_time_ns() - dev->acquired;
+	dev->hold_total += hold;
+	if (hold > dev->hold_max)
+		dev->hold_max = hold;
+
+	dev->holder_tid = 0;
+	__sync_synchronize();
+	dev->holder_pid = 0;
+}
+
+/* Called for each interrupt count read from a device. If the interrupt
+   completed a wait, enabled and woken are the times at which the interrupt
+   was enabled and the waiter was woken; otherwise they are 0. */
+void uio_shm_irq(struct uio_shm_device *dev, unsigned long count,
+		 uint64_t enabled, uint64_t woken)
+{
+	unsigned long last;
+	uint64_t latency, max, us;
+	int k;
+
+	if (dev == NULL)
+		return;
+
+	/* Each handle reads every count, so only count the advance */
+	do {
+		last = dev->irq_count;
+		if ((long)(count - last) <= 0)
+			break;
+	} while (!__sync_bool_compare_and_swap(&dev->irq_count, last, count));
+
+	if (last != 0 && (long)(count - last) > 1)
+		__sync_fetch_and_add(&dev->irq_coalesced, count - last - 1);
+
+	if (enabled == 0 || woken < enabled)
+		return;
+
+	latency = woken - enabled;
+	__sync_fetch_and_add(&dev->irq_waits, 1);
+	__sync_fetch_and_add(&dev->irq_latency_total, latency);
+	do {
+		max = dev->irq_latency_max;
+		if (latency <= max)
+			break;
+	} while (!__sync_bool_compare_and_swap(&dev->irq_latency_max, max,
+					      latency));
+
+	for (k = 0, us = latency / 1000; us > 1 && k < UIO_SHM_IRQ_BUCKETS - 1;
+	     us >>= 1)
+		k++;
+	__sync_fetch_and_add(&dev->irq_hist[k], 1);
+}
+
+/* States of an extent slot */
+#define EXTENT_FREE	0
+#define EXTENT_BUSY	1
+#define EXTENT_VALID	2
+
+#define EXTENT_STATE(e) (*(volatile unsigned int *)&(e)->state)
+#define EXTENT_GEN(e) (*(volatile unsigned int *)&(e)->gen)
+
+static int extent_claim(struct uio_shm_extent *e, unsigned int state)
+{
+	if (EXTENT_STATE(e) != state ||
+	    !__sync_bool_compare_and_swap(&e->state, state, EXTENT_BUSY))
+		return 0;
+
+	/* Readers copying the slot now see it has changed */
+	__sync_fetch_and_add(&e->gen, 1);
+
+	return 1;
+}
+
+static void extent_release(struct uio_shm_extent *e, unsigned int state)
+{
+	__sync_synchronize();
+	EXTENT_STATE(e) = state;
+}
+
+static int proc_dead(pid_t pid)
+{
+	return kill(pid, 0) < 0 && errno == ESRCH;
+}
+
+static int extent_dead(struct uio_shm_extent *e)
+{
+	return proc_dead(e->pid);
+}
+
+/* Free the extent of a process which has died; returns 1 if it is now
+   claimed by the caller, for reuse */
+static int extent_reap_claim(struct uio_shm_extent *e)
+{
+	if (!extent_claim(e, EXTENT_VALID))
+		return 0;
+
+	/* The slot may have been reused since it was seen */
+	if (!extent_dead(e)) {
+		extent_release(e, EXTENT_VALID);
+		return 0;
+	}
+
+	return 1;
+}
+
+static void extent_reap(struct uio_shm_extent *e)
+{
+	if (extent_reap_claim(e))
+		extent_release(e, EXTENT_FREE);
+}
+
+static void extent_insert(struct uio_shm_device *dev, unsigned int start,
+			  unsigned int count, pid_t pid, pid_t tid,
+			  unsigned int flags)
+{
+	struct uio_shm_extent *e = NULL;
+	unsigned int i, used;
+
+	for (i = 0; i < UIO_SHM_EXTENTS; i++) {
+		if (extent_claim(&dev->extents[i], EXTENT_FREE)) {
+			e = &dev->extents[i];
+			break;
+		}
+	}
+
+	/* Table full: take over an extent of a process which has died */
+	for (i = 0; e == NULL && i < dev->extents_used; i++) {
+		if (EXTENT_STATE(&dev->extents[i]) == EXTENT_VALID &&
+		    extent_dead(&dev->extents[i]) &&
+		    extent_reap_claim(&dev->extents[i]))
+			e = &dev->extents[i];
+	}
+
+	if (e == NULL) {
+		__sync_fetch_and_add(&dev->extents_untracked, 1);
+		return;
+	}
+
+	e->start = start;
+	e->count = count;
+	e->pid = pid;
+	e->tid = tid;
+	e->flags = flags;
+	extent_release(e, EXTENT_VALID);
+
+	i = e - dev->extents;
+	do {
+		used = dev->extents_used;
+		if (i < used)
+			break;
+	} while (!__sync_bool_compare_and_swap(&dev->extents_used, used, i + 1));
+}
+
+/* Record pages allocated by the calling thread */
+void uio_shm_extent_add(struct uio_shm_device *dev, unsigned int start,
+			unsigned int count, unsigned int flags)
+{
+	if (dev == NULL || count == 0)
+		return;
+
+	extent_insert(dev, start, count, uio_getpid(), uio_gettid(), flags);
+}
+
+/* Forget pages freed by the calling process, trimming or splitting its
+   extents which cover them */
+void uio_shm_extent_remove(struct uio_shm_device *dev, unsigned int start,
+			   unsigned int count)
+{
+	struct uio_shm_extent *e;
+	unsigned int i, end = start + count, e_end;
+	pid_t pid = uio_getpid();
+
+	if (dev == NULL)
+		return;
+
+	for (i = 0; i < dev->extents_used; i++) {
+		e = &dev->extents[i];
+		if (EXTENT_STATE(e) != EXTENT_VALID || e->pid != pid ||
+		    e->start >= end || e->start + e->count <= start)
+			continue;
+		if (!extent_claim(e, EXTENT_VALID))
+			continue;
+
+		/* The slot may have been reused since it was seen */
+		e_end = e->start + e->count;
+		if (e->pid != pid || e->start >= end || e_end <= start) {
+			extent_release(e, EXTENT_VALID);
+			continue;
+		}
+
+		if (e->start >= start && e_end <= end) {
+			extent_release(e, EXTENT_FREE);
+			continue;
+		}
+
+		if (e->start < start) {
+			/* Keep the head, and the tail as a new extent */
+			e->count = start - e->start;
+			if (e_end > end)
+				extent_insert(dev, end, e_end - end, e->pid,
+					      e->tid, e->flags);
+		} else {
+			e->count = e_end - end;
+			e->start = end;
+		}
+		extent_release(e, EXTENT_VALID);
+	}
+}
+
+static int extent_cmp(const void *a, const void *b)
+{
+	const struct uio_shm_extent *ea = a, *eb = b;
+
+	if (ea->start != eb->start)
+		return ea->start < eb->start ? -1 : 1;
+	return ea->pid - eb->pid;
+}
+
+/* Copy the extents of live processes, in order of start page and with
+   adjacent extents of the same owner merged, into an array of
+   UIO_SHM_EXTENTS. Returns the number copied. */
+int uio_shm_extents(struct uio_shm_device *dev, struct uio_shm_extent *extents)
+{
+	struct uio_shm_extent *e, copy;
+	unsigned int i, gen, used;
+	int n = 0, k, valid;
+
+	if (dev == NULL)
+		return 0;
+
+	used = dev->extents_used;
+	for (i = 0; i < used && i < UIO_SHM_EXTENTS; i++) {
+		e = &dev->extents[i];
+		for (;;) {
+			gen = EXTENT_GEN(e);
+			__sync_synchronize();
+			valid = EXTENT_STATE(e) == EXTENT_VALID;
+			if (!valid)
+				break;
+			copy = *e;
+			__sync_synchronize();
+			if (EXTENT_GEN(e) == gen &&
+			    EXTENT_STATE(e) == EXTENT_VALID)
+				break;
+		}
+		if (!valid)
+			continue;
+
+		if (extent_dead(&copy)) {
+			extent_reap(e);
+			continue;
+		}
+
+		extents[n++] = copy;
+	}
+
+	qsort(extents, n, sizeof(*extents), extent_cmp);
+
+	for (i = 0, k = -1; i < (unsigned int)n; i++) {
+		if (k >= 0 && extents[k].start + extents[k].count ==
+		    extents[i].start && extents[k].pid == extents[i].pid &&
+		    extents[k].tid == extents[i].tid &&
+		    extents[k].flags == extents[i].flags) {
+			extents[k].count += extents[i].count;
+			continue;
+		}
+		extents[++k] = extents[i];
+	}
+
+	return k + 1;
+}
+
+/* Processes accounted; the slot of this process is found once */
+static pthread_mutex_t proc_lock = PTHREAD_MUTEX_INITIALIZER;
+static struct uio_shm_proc *proc_self = NULL;
+
+static void memstat_add(struct uio_shm_memstat *m, unsigned long bytes)
+{
+	unsigned long live, peak;
+
+	live = __sync_add_and_fetch(&m->live, bytes);
+	__sync_fetch_and_add(&m->allocs, 1);
+
+	do {
+		peak = m->peak;
+		if (live <= peak)
+			break;
+	} while (!__sync_bool_compare_and_swap(&m->peak, peak, live));
+}
+
+/* Subtract from live bytes, never below 0; returns the amount subtracted */
+static unsigned long memstat_sub(struct uio_shm_memstat *m,
+				 unsigned long bytes)
+{
+	unsigned long live;
+
+	do {
+		live = m->live;
+		if (bytes > live)
+			bytes = live;
+	} while (!__sync_bool_compare_and_swap(&m->live, live, live - bytes));
+
+	return bytes;
+}
+
+/* Return the live bytes of a process which has died to its devices, and
+   free its slot */
+static void proc_reap(struct uio_shm *shm, struct uio_shm_proc *proc,
+		      pid_t pid)
+{
+	int i;
+
+	if (!__sync_bool_compare_and_swap(&proc->pid, pid, -1))
+		return;
+
+	for (i = 0; i < UIO_DEVICE_MAX; i++)
+		memstat_sub(&shm->dev[i].mem, proc->mem[i].live);
+	memset(proc->mem, 0, sizeof(proc->mem));
+
+	__sync_synchronize();
+	proc->pid = 0;
+}
+
+static struct uio_shm_proc *proc_get(struct uio_shm *shm)
+{
+	struct uio_shm_proc *proc = proc_self;
+	pid_t pid = uio_getpid();
+	int i, pass;
+
+	if (proc && proc->pid == pid)
+		return proc;
+
+	pthread_mutex_lock(&proc_lock);
+
+	/* A slot left by an earlier process with the same pid is stale */
+	for (i = 0; i < UIO_SHM_PROCS; i++) {
+		if (shm->procs[i].pid == pid)
+			proc_reap(shm, &shm->procs[i], pid);
+	}
+
+	proc = NULL;
+	for (pass = 0; proc == NULL && pass < 2; pass++) {
+		for (i = 0; i < UIO_SHM_PROCS; i++) {
+			if (shm->procs[i].pid == 0 &&
+			    __sync_bool_compare_and_swap(&shm->procs[i].pid,
+							 0, pid)) {
+				proc = &shm->procs[i];
+				break;
+			}
+		}
+
+		/* Table full: make room from processes which have died */
+		for (i = 0; proc == NULL && pass == 0 && i < UIO_SHM_PROCS; i++) {
+			if (shm->procs[i].pid > 0 &&
+			    proc_dead(shm->procs[i].pid))
+				proc_reap(shm, &shm->procs[i],
+					  shm->procs[i].pid);
+		}
+	}
+
+	if (proc == NULL)
+		__sync_fetch_and_add(&shm->procs_untracked, 1);
+	proc_self = proc;
+
+	pthread_mutex_unlock(&proc_lock);
+
+	return proc;
+}
+
+/* Account memory allocated by this process */
+void uio_shm_mem_alloc(struct uio_shm_device *dev, unsigned long bytes)
+{
+	struct uio_shm *shm = uio_shm_get();
+	struct uio_shm_proc *proc;
+
+	if (dev == NULL || shm == NULL)
+		return;
+
+	memstat_add(&dev->mem, bytes);
+	if ((proc = proc_get(shm)) != NULL)
+		memstat_add(&proc->mem[dev - shm->dev], bytes);
+}
+
+void uio_shm_mem_failed(struct uio_shm_device *dev)
+{
+	struct uio_shm *shm = uio_shm_get();
+	struct uio_shm_proc *proc;
+
+	if (dev == NULL || shm == NULL)
+		return;
+
+	__sync_fetch_and_add(&dev->mem.failed, 1);
+	if ((proc = proc_get(shm)) != NULL)
+		__sync_fetch_and_add(&proc->mem[dev - shm->dev].failed, 1);
+}
+
+void uio_shm_mem_free(struct uio_shm_device *dev, unsigned long bytes)
+{
+	struct uio_shm *shm = uio_shm_get();
+	struct uio_shm_proc *proc;
+
+	if (dev == NULL || shm == NULL)
+		return;
+
+	/* Only what this process has accounted comes off the total */
+	if ((proc = proc_get(shm)) != NULL) {
+		bytes = memstat_sub(&proc->mem[dev - shm->dev], bytes);
+		__sync_fetch_and_add(&proc->mem[dev - shm->dev].frees, 1);
+	}
+	memstat_sub(&dev->mem, bytes);
+	__sync_fetch_and_add(&dev->mem.frees, 1);
+}
+
+/* All memory of this process in the device has been released, as its
+   last handle on the device is closed */
+void uio_shm_mem_release(struct uio_shm_device *dev)
+{
+	struct uio_shm *shm = uio_shm_get();
+	struct uio_shm_proc *proc;
+	unsigned long live;
+
+	if (dev == NULL || shm == NULL || (proc = proc_get(shm)) == NULL)
+		return;
+
+	live = memstat_sub(&proc->mem[dev - shm->dev], ~0UL);
+	memstat_sub(&dev->mem, live);
+}
+
+/* Copy the memory use of each live process which has used the device,
+   up to max. Returns the number of such processes. */
+int uio_shm_mem_procs(struct uio_shm_device *dev, pid_t *pids,
+		      struct uio_shm_memstat *stats, int max)
+{
+	struct uio_shm *shm = uio_shm_get();
+	struct uio_shm_memstat *m;
+	pid_t pid;
+	int i, n = 0;
+
+	if (dev == NULL || shm == NULL)
+		return 0;
+
+	for (i = 0; i < UIO_SHM_PROCS; i++) {
+		pid = *(volatile pid_t *)&shm->procs[i].pid;
+		if (pid <= 0)
+			continue;
+		if (proc_dead(pid)) {
+			proc_reap(shm, &shm->procs[i], pid);
+			continue;
+		}
+
+		m = &shm->procs[i].mem[dev - shm->dev];
+		if (m->allocs == 0 && m->failed == 0)
+			continue;
+		if (n < max) {
+			pids[n] = pid;
+			stats[n] = *m;
+		}
+		n++;
+	}
+
+	return n;
+}
+
+/* Start a new peak from the current live bytes */
+void uio_shm_mem_reset_peak(struct uio_shm_device *dev)
+{
+	struct uio_shm *shm = uio_shm_get();
+	struct uio_shm_memstat *m;
+	int i;
+
+	if (dev == NULL || shm == NULL)
+		return;
+
+	dev->mem.peak = dev->mem.live;
+	for (i = 0; i < UIO_SHM_PROCS; i++) {
+		if (shm->procs[i].pid > 0) {
+			m = &shm->procs[i].mem[dev - shm->dev];
+			m->peak = m->live;
+		}
+	}
+}
@@ -0,0 +1,185 @@
+/*
+ * UIOMux: a conflict manager for system resources, including UIO devices.
+ * Copyright (C) 2009 Renesas Technology Corp.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston MA  02110-1301 USA
+ */
+
+#ifndef __UIOMUX_SHM_H__
+#define __UIOMUX_SHM_H__
+
+#include <stdint.h>
+#include <sys/types.h>
+
+#include "uio.h"
+
+/* Interrupt latency histogram: bucket k counts latencies of [2^k, 2^(k+1))
+   us, with bucket 0 also counting latencies below 1 us */
+#define UIO_SHM_IRQ_BUCKETS	16
+
+/* POSIX shared memory object holding the system-wide UIOMux state */
+#define UIO_SHM_NAME		"/uiomux"
+#define UIO_SHM_MAGIC		0x55494f58	/* "UIOX" */
+#define UIO_SHM_VERSION		5
+
+/* Processes whose memory use is accounted */
+#define UIO_SHM_PROCS		64
+
+/* Memory use of a device, in total or by one process, in bytes */
+struct uio_shm_memstat {
+  unsigned long live;
+  unsigned long peak;		/* highest live since the last peak reset */
+  unsigned long allocs;
+  unsigned long frees;
+  unsigned long failed;
+};
+
+/* Memory use of a process, in a slot claimed by setting pid. A pid of -1
+   marks a slot being reaped after its process died. */
+struct uio_shm_proc {
+  pid_t pid;
+  struct uio_shm_memstat mem[UIO_DEVICE_MAX];
+};
+
+/* Allocated extents tracked for each device */
+#define UIO_SHM_EXTENTS		256
+
+/* Extent flags, as UIOMUX_EXTENT_* */
+#define UIO_EXTENT_SHARED	1
+#define UIO_EXTENT_LOCKED	2
+
+/*
+ * An extent of pages of the memory region owned by a thread. A slot is
+ * claimed and changed with state set to busy, and gen incremented while
+ * busy, so that readers can copy it without locking.
+ */
+struct uio_shm_extent {
+  unsigned int state;
+  unsigned int gen;
+  unsigned int start;		/* first page */
+  unsigned int count;		/* pages */
+  pid_t pid;
+  pid_t tid;
+  unsigned int flags;
+};
+
+/*
+ * Per-device shared state, indexed by UIO device index. Fields describing
+ * the lock holder and lock statistics are only written by the process
+ * currently holding the device lock, so other readers may see slightly
+ * stale values.
+ */
+struct uio_shm_device {
+  char name[UIO_DEVICE_NAME_MAX];
+
+  /* Current lock holder; holder_pid is 0 while unlocked */
+  pid_t holder_pid;
+  pid_t holder_tid;
+  uint64_t acquired;		/* CLOCK_MONOTONIC ns */
+  unsigned int lock_seq;	/* incremented on each acquisition */
+  unsigned int waiters;
+
+  /* Lock statistics */
+  unsigned long lock_count;
+  uint64_t hold_total;		/* ns */
+  uint64_t hold_max;
+  uint64_t wait_total;
+  uint64_t wait_max;
+
+  /* Hold-time watchdog */
+  unsigned int watchdog_seq;	/* lock_seq of the last reported hold */
+  unsigned long watchdog_trips;
+
+  /* Interrupt statistics, updated atomically by any process */
+  unsigned long irq_count;	/* latest kernel interrupt count seen */
+  unsigned long irq_coalesced;	/* interrupts never seen individually */
+  unsigned long irq_waits;	/* waits completed by an interrupt */
+  uint64_t irq_latency_total;	/* ns, from enable to wakeup */
+  uint64_t irq_latency_max;
+  unsigned long irq_hist[UIO_SHM_IRQ_BUCKETS];
+
+  /* Virtual address at which all processes map the memory region with
+     UIOMUX_OPEN_FIXED_MAP; set once by the first such process */
+  unsigned long mem_fixed;
+
+  /* Allocated extents of the memory region, for meminfo. Allocation
+     itself is arbitrated by file locks, so extents of processes which
+     died are only noticed, and reaped, when the table is read. */
+  unsigned int extents_used;	/* slots below this may be in use */
+  unsigned long extents_untracked;	/* allocations not recorded, table full */
+  struct uio_shm_extent extents[UIO_SHM_EXTENTS];
+
+  /* Memory use by all processes */
+  struct uio_shm_memstat mem;
+};
+
+struct uio_shm {
+  unsigned int magic;
+  unsigned int version;
+  struct uio_shm_device dev[UIO_DEVICE_MAX];
+  struct uio_shm_proc procs[UIO_SHM_PROCS];
+  unsigned long procs_untracked;	/* processes not accounted, table full */
+};
+
+struct uio_shm *
+uio_shm_get (void);
+
+int
+uio_shm_unlink (void);
+
+uint64_t
+uio_shm_lock_begin (struct uio_shm_device * dev);
+
+void
+uio_shm_lock_end (struct uio_shm_device * dev, uint64_t start, int acquired);
+
+void
+uio_shm_unlock (struct uio_shm_device * dev);
+
+void
+uio_shm_irq (struct uio_shm_device * dev, unsigned long count,
+	     uint64_t enabled, uint64_t woken);
+
+void
+uio_shm_extent_add (struct uio_shm_device * dev, unsigned int start,
+		     unsigned int count, unsigned int flags);
+
+void
+uio_shm_extent_remove (struct uio_shm_device * dev, unsigned int start,
+			unsigned int count);
+
+int
+uio_shm_extents (struct uio_shm_device * dev, struct uio_shm_extent * extents);
+
+void
+uio_shm_mem_alloc (struct uio_shm_device * dev, unsigned long bytes);
+
+void
+uio_shm_mem_failed (struct uio_shm_device * dev);
+
+void
+uio_shm_mem_free (struct uio_shm_device * dev, unsigned long bytes);
+
+void
+uio_shm_mem_release (struct uio_shm_device * dev);
+
+int
+uio_shm_mem_procs (struct uio_shm_device * dev, pid_t * pids,
+		   struct uio_shm_memstat * stats, int max);
+
+void
+uio_shm_mem_reset_peak (struct uio_shm_device * dev);
+
+#endif /* __UIOMUX_SHM_H__ */
@@ -0,0 +1,250 @@
+/*
+ * UIOMux: a conflict manager for system resources, including UIO devices.
+ * Copyright (C) 2009 Renesas Technology Corp.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston MA  02110-1301 USA
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+#include <time.h>
+
+#include "uiomux/uiomux.h"
+
+/* Default size of the ring buffer of each thread, in entries */
+#define TRACE_DEFAULT_ENTRIES 4096
+
+/*
+ * The ring buffer of one thread. Only the owning thread writes to it,
+ * so logging takes no lock; trace_lock only guards the list of rings.
+ */
+struct trace_ring {
+	struct trace_ring *next;
+	struct uiomux_trace_entry *entries;
+	unsigned int size;	/* power of two */
+	unsigned long head;	/* entries logged in this trace */
+	unsigned int gen;	/* trace the ring belongs to */
+	unsigned int thread;
+	int orphaned;		/* owning thread has exited */
+};
+
+volatile int uiomux_trace_active = 0;
+
+static pthread_mutex_t trace_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_once_t trace_once = PTHREAD_ONCE_INIT;
+static pthread_key_t trace_key;
+
+static struct trace_ring *rings = NULL;
+static unsigned int ring_entries = TRACE_DEFAULT_ENTRIES;
+static unsigned int nr_threads = 0;
+
+/* Incremented by each uiomux_trace_start() */
+static volatile unsigned int trace_gen = 0;
+
+static __thread struct trace_ring *this_ring = NULL;
+
+static void trace_ring_orphan(void *arg)
+{
+	struct trace_ring *ring = arg;
+
+	pthread_mutex_lock(&trace_lock);
+	ring->orphaned = 1;
+	pthread_mutex_unlock(&trace_lock);
+}
+
+static void trace_key_create(void)
+{
+	pthread_key_create(&trace_key, trace_ring_orphan);
+}
+
+/*
+ * Get the ring of the calling thread for the current trace, creating it
+ * or resetting it from an earlier trace as needed.
+ */
+static struct trace_ring *trace_ring_get(void)
+{
+	struct trace_ring *ring = this_ring;
+	unsigned int gen = trace_gen;
+	unsigned int size;
+
+	pthread_mutex_lock(&trace_lock);
+	size = ring_entries;
+
+	if (ring == NULL) {
+		ring = calloc(1, sizeof(*ring));
+		if (ring == NULL)
+			goto out;
+		ring->thread = nr_threads++;
+		ring->next = rings;
+		rings = ring;
+		pthread_once(&trace_once, trace_key_create);
+		pthread_setspecific(trace_key, ring);
+		this_ring = ring;
+	}
+
+	if (ring->size != size) {
+		free(ring->entries);
+		ring->entries = malloc(size * sizeof(*ring->entries));
+		ring->size = ring->entries ? size : 0;
+	}
+	ring->head = 0;
+	ring->gen = gen;
+
+out:
+	pthread_mutex_unlock(&trace_lock);
+
+	return (ring && ring->size) ? ring : NULL;
+}
+
+void
+uiomux_trace_log(unsigned long address, uint32_t value, int op)
+{
+	struct trace_ring *ring = this_ring;
+	struct uiomux_trace_entry *entry;
+	struct timespec now;
+
+	if (ring == NULL || ring->gen != trace_gen || ring->size == 0) {
+		ring = trace_ring_get();
+		if (ring == NULL)
+			return;
+	}
+
+	clock_gettime(CLOCK_MONOTONIC, &now);
+
+	entry = &ring->entries[ring->head & (ring->size - 1)];
+	entry->time_ns = (uint64_t) now.tv_sec * 1000000000ULL + now.tv_nsec;
+	entry->address = address;
+	entry->value = value;
+	entry->thread = ring->thread;
+	entry->op = op;
+	ring->head++;
+}
+
+int
+uiomux_trace_start(unsigned int entries)
+{
+	struct trace_ring **prev, *ring;
+	unsigned int size = 1;
+
+	if (entries == 0)
+		entries = TRACE_DEFAULT_ENTRIES;
+	while (size < entries && size < 0x80000000U)
+		size <<= 1;
+
+	uiomux_trace_active = 0;
+
+	pthread_mutex_lock(&trace_lock);
+
+	/* Rings of exited threads are only kept for saving the last trace */
+	prev = &rings;
+	while ((ring = *prev) != NULL) {
+		if (ring->orphaned) {
+			*prev = ring->next;
+			free(ring->entries);
+			free(ring);
+		} else {
+			prev = &ring->next;
+		}
+	}
+
+	ring_entries = size;
+	trace_gen++;
+
+	pthread_mutex_unlock(&trace_lock);
+
+	uiomux_trace_active = 1;
+
+	return 0;
+}
+
+void
+uiomux_trace_stop(void)
+{
+	uiomux_trace_active = 0;
+}
+
+static int trace_entry_cmp(const void *a, const void *b)
+{
+	const struct uiomux_trace_entry *ea = a, *eb = b;
+
+	if (ea->time_ns != eb->time_ns)
+		return ea->time_ns < eb->time_ns ? -1 : 1;
+	return (int)ea->thread - (int)eb->thread;
+}
+
+int
+uiomux_trace_save(const char *filename)
+{
+	struct uiomux_trace_header header;
+	struct uiomux_trace_entry *entries = NULL;
+	struct trace_ring *ring;
+	unsigned long count = 0, dropped = 0, n, i;
+	FILE *f;
+	int ret = -1;
+
+	pthread_mutex_lock(&trace_lock);
+
+	for (ring = rings; ring; ring = ring->next) {
+		if (ring->gen == trace_gen)
+			count += ring->head < ring->size ? ring->head : ring->size;
+	}
+
+	if (count) {
+		entries = malloc(count * sizeof(*entries));
+		if (entries == NULL) {
+			pthread_mutex_unlock(&trace_lock);
+			return -1;
+		}
+	}
+
+	/* Copy each ring oldest first; a full ring has overwritten the rest */
+	count = 0;
+	for (ring = rings; ring; ring = ring->next) {
+		if (ring->gen != trace_gen)
+			continue;
+		n = ring->head < ring->size ? ring->head : ring->size;
+		for (i = ring->head - n; i < ring->head; i++)
+			entries[count++] = ring->entries[i & (ring->size - 1)];
+		dropped += ring->head - n;
+	}
+
+	pthread_mutex_unlock(&trace_lock);
+
+	qsort(entries, count, sizeof(*entries), trace_entry_cmp);
+
+	header.magic = UIOMUX_TRACE_MAGIC;
+	header.version = UIOMUX_TRACE_VERSION;
+	header.count = count;
+	header.dropped = dropped;
+
+	if ((f = fopen(filename, "wb")) == NULL)
+		goto out;
+
+	if (fwrite(&header, sizeof(header), 1, f) == 1 &&
+	    fwrite(entries, sizeof(*entries), count, f) == count)
+		ret = count;
+
+	if (fclose(f) != 0)
+		ret = -1;
+
+out:
+	free(entries);
+	return ret;
+}
@@ -21,24 +21,40 @@
 #include "config.h"
 #endif
 
+#ifndef _GNU_SOURCE
+#define _GNU_SOURCE	/* for ppoll() */
+#endif
+
 #include <errno.h>
 #include <fcntl.h>
 #include <math.h>
+#include <poll.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 #include <pthread.h>
 #include <unistd.h>
+#include <sys/file.h>
 #include <sys/ioctl.h>
 #include <sys/types.h>
 #include <sys/stat.h>
 #include <sys/mman.h>
 #include <sys/param.h>
+#include <sys/syscall.h>
+#include <sys/eventfd.h>
+#include <time.h>
 
 #include "uio.h"
+#include "shm.h"
+#include "uring.h"
 
 /* #define DEBUG */
 
+/* Linux 4.17; older kernels treat the address as a hint, which is checked */
+#ifndef MAP_FIXED_NOREPLACE
+#define MAP_FIXED_NOREPLACE 0x100000
+#endif
+
 static int fgets_with_openclose(char *fname, char *buf, size_t maxlen)
 {
 	FILE *fp;
@@ -125,7 +141,9 @@ static int locate_uio_device(const char *name, struct uio_device *udp, int *devi
 
 	sscanf(udp->path, "/sys/class/uio/uio%i", &uio_id);
 	sprintf(buf, "/dev/uio%d", uio_id);
-	udp->fd = open(buf, O_RDWR | O_SYNC /*| O_NONBLOCK */ );
+	/* Reads are only made once poll() says there is something to read,
+	   or to resync the interrupt count, so they never need to block */
+	udp->fd = open(buf, O_RDWR | O_SYNC | O_NONBLOCK);
 
 	if (udp->fd < 0) {
 		perror("open");
@@ -178,6 +196,197 @@ int uio_device_index (struct uio * uio)
 	return uio->device_index;
 }
 
+/* Monotonic time in nanoseconds, comparable between processes */
+uint64_t uio_time_ns(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+
+	return (uint64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+/* Process and thread IDs are cached to keep them off the locking path.
+   The cache is cleared in the child after fork(). */
+static pid_t cached_pid;
+static __thread pid_t cached_tid;
+static pthread_once_t ids_once = PTHREAD_ONCE_INIT;
+
+/* Each sleeping thread is woken through its own eventfd, created on its
+   first sleep and closed when it exits */
+static __thread struct uio_thread *this_thread;
+static pthread_key_t thread_key;
+
+static void thread_destroy(void *arg)
+{
+	struct uio_thread *t = (struct uio_thread *)arg;
+
+	close(t->efd);
+	free(t);
+}
+
+static void ids_reset(void)
+{
+	cached_pid = 0;
+	cached_tid = 0;
+
+	/* Don't share the eventfd with the parent */
+	if (this_thread) {
+		pthread_setspecific(thread_key, NULL);
+		thread_destroy(this_thread);
+		this_thread = NULL;
+	}
+}
+
+static void ids_init(void)
+{
+	pthread_key_create(&thread_key, thread_destroy);
+	pthread_atfork(NULL, NULL, ids_reset);
+}
+
+pid_t uio_getpid(void)
+{
+	if (cached_pid == 0) {
+		pthread_once(&ids_once, ids_init);
+		cached_pid = getpid();
+	}
+
+	return cached_pid;
+}
+
+pid_t uio_gettid(void)
+{
+	if (cached_tid == 0) {
+		pthread_once(&ids_once, ids_init);
+		cached_tid = syscall(SYS_gettid);
+	}
+
+	return cached_tid;
+}
+
+struct uio_thread *uio_thread_self(void)
+{
+	struct uio_thread *t;
+
+	if (this_thread)
+		return this_thread;
+
+	pthread_once(&ids_once, ids_init);
+
+	t = (struct uio_thread *)calloc(1, sizeof(*t));
+	if (t == NULL)
+		return NULL;
+
+	t->thread = pthread_self();
+	t->efd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+	if (t->efd < 0) {
+		free(t);
+		return NULL;
+	}
+
+	pthread_setspecific(thread_key, t);
+	this_thread = t;
+
+	return t;
+}
+
+/* Wake a thread from its current or next sleep */
+int uio_thread_wake(struct uio_thread *t)
+{
+	struct uio_uring *ring;
+	int ret;
+
+	ret = eventfd_write(t->efd, 1);
+
+	/* A thread waiting through a ring may not be the one polling it */
+	__sync_synchronize();
+	if ((ring = t->ring) != NULL)
+		uio_uring_kick(ring);
+
+	return ret;
+}
+
+/* Consume any wakeups of a thread, returning whether there were any */
+int uio_thread_woken(struct uio_thread *t)
+{
+	eventfd_t value;
+
+	return eventfd_read(t->efd, &value) == 0 && value > 0;
+}
+
+/* Put a thread on the waiter list of a device. Returns 1 if a wakeup was
+   pending, which the sleep then takes as its own. */
+int uio_wait_begin(struct uio *uio, struct uio_waiter *w,
+		   struct uio_thread *t)
+{
+	struct uio_waiter **p;
+	int pending;
+
+	w->thread = t;
+	w->woken = 0;
+	w->next = NULL;
+
+	pthread_mutex_lock(&uio->wait_lock);
+	for (p = &uio->waiters; *p != NULL; p = &(*p)->next)
+		;
+	*p = w;
+	pending = uio->wake_pending;
+	uio->wake_pending = 0;
+	pthread_mutex_unlock(&uio->wait_lock);
+
+	return pending;
+}
+
+void uio_wait_end(struct uio *uio, struct uio_waiter *w)
+{
+	struct uio_waiter **p;
+
+	pthread_mutex_lock(&uio->wait_lock);
+	for (p = &uio->waiters; *p != NULL; p = &(*p)->next) {
+		if (*p == w) {
+			*p = w->next;
+			break;
+		}
+	}
+	pthread_mutex_unlock(&uio->wait_lock);
+}
+
+/* Wake all sleepers, the one which has slept longest, or those of one
+   thread. A wakeup of all or one that finds no sleeper is kept for the next
+   sleep; a wakeup of a thread which is not sleeping fails. Returns the
+   number of sleepers woken. */
+int uio_wakeup(struct uio *uio, int how, pthread_t thread)
+{
+	struct uio_waiter *w;
+	int n = 0;
+
+	pthread_mutex_lock(&uio->wait_lock);
+	for (w = uio->waiters; w != NULL; w = w->next) {
+		if (w->woken)
+			continue;
+		if (how == UIO_WAKE_THREAD &&
+		    !pthread_equal(w->thread->thread, thread))
+			continue;
+
+		w->woken = 1;
+		uio_thread_wake(w->thread);
+		n++;
+
+		if (how == UIO_WAKE_ONE)
+			break;
+	}
+	if (n == 0 && how != UIO_WAKE_THREAD)
+		uio->wake_pending = 1;
+	pthread_mutex_unlock(&uio->wait_lock);
+
+	if (n == 0 && how == UIO_WAKE_THREAD) {
+		errno = ESRCH;
+		return -1;
+	}
+
+	return n;
+}
+
 static int setup_uio_map(struct uio_device *udp, int nr,
 			 struct uio_map *ump)
 {
@@ -221,6 +430,29 @@ static int mc_refcount[UIO_DEVICE_MAX];
 #define PAGE_ALLOCATED 1
 #define PAGE_SHARED    2
 
+/* Memory regions mapped at their agreed address, shared by all handles of
+   the process which use UIOMUX_OPEN_FIXED_MAP */
+static pthread_mutex_t fixed_lock = PTHREAD_MUTEX_INITIALIZER;
+static void *fixed_iomem[UIO_DEVICE_MAX];
+static int fixed_refcount[UIO_DEVICE_MAX];
+
+static void uio_unmap_mem(struct uio *uio)
+{
+	int res = uio->device_index;
+
+	if (!uio->mem_fixed) {
+		munmap(uio->mem.iomem, uio->mem.size);
+		return;
+	}
+
+	pthread_mutex_lock(&fixed_lock);
+	if (--fixed_refcount[res] == 0) {
+		munmap(fixed_iomem[res], uio->mem.size);
+		fixed_iomem[res] = NULL;
+	}
+	pthread_mutex_unlock(&fixed_lock);
+}
+
 int uio_close(struct uio *uio)
 {
 	int res;
@@ -229,7 +461,7 @@ int uio_close(struct uio *uio)
 		return -1;
 
 	if (uio->mem.iomem)
-		munmap(uio->mem.iomem, uio->mem.size);
+		uio_unmap_mem(uio);
 
 	if (uio->mmio.iomem)
 		munmap(uio->mmio.iomem, uio->mmio.size);
@@ -237,10 +469,7 @@ int uio_close(struct uio *uio)
 	if (uio->dev.fd > 0)
 		close(uio->dev.fd);
 
-	if (uio->exit_sleep_pipe[0] > 0) {
-		close(uio->exit_sleep_pipe[0]);
-		close(uio->exit_sleep_pipe[1]);
-	}
+	pthread_mutex_destroy(&uio->wait_lock);
 
 	res = uio->device_index;
 	pthread_mutex_lock(&mc_lock);
@@ -248,6 +477,10 @@ int uio_close(struct uio *uio)
 	if ((mc_refcount[res] == 0) && mc_map[res]) {
 		free(mc_map[res]);
 		mc_map[res] = NULL;
+
+		/* Closing the device released whatever was left allocated */
+		uio_shm_extent_remove(uio->shm, 0, ~0U);
+		uio_shm_mem_release(uio->shm);
 	}
 	pthread_mutex_unlock(&mc_lock);
 
@@ -259,6 +492,7 @@ int uio_close(struct uio *uio)
 struct uio *uio_open(const char *name)
 {
 	struct uio *uio;
+	struct uio_shm *shm;
 	int ret;
 	int res;
 
@@ -266,6 +500,8 @@ struct uio *uio_open(const char *name)
 	if (uio == NULL)
 		return NULL;
 
+	pthread_mutex_init(&uio->wait_lock, NULL);
+
 	ret = locate_uio_device(name, &uio->dev, &uio->device_index);
 	if (ret < 0) {
 		uio_close(uio);
@@ -285,7 +521,14 @@ struct uio *uio_open(const char *name)
 	/* contiguous memory may not be available */
 	ret = setup_uio_map(&uio->dev, 1, &uio->mem);
 
-	pipe(uio->exit_sleep_pipe);
+
+	/* shared statistics and diagnostics may not be available */
+	shm = uio_shm_get();
+	if (shm) {
+		uio->shm = &shm->dev[uio->device_index];
+		strncpy(uio->shm->name, uio->dev.name, UIO_DEVICE_NAME_MAX - 1);
+		uio->shm->name[strcspn(uio->shm->name, "\n")] = '\0';
+	}
 
 	/* initialize uio memory usage map once in each process */
 	res = uio->device_index;
@@ -310,71 +553,364 @@ struct uio *uio_open(const char *name)
 	return uio;
 }
 
-int uio_sleep(struct uio *uio, struct timeval *timeout)
+/* Claim the device for this handle only. The flock() is held until the
+   device is closed, so that any other handle blocks in uiomux_lock(), and
+   the whole memory region is fcntl()-locked so that other processes cannot
+   allocate from it. Locking and allocation then need no further syscalls. */
+int uio_claim(struct uio *uio)
+{
+	const long pagesize = sysconf(_SC_PAGESIZE);
+	struct flock lck;
+	int ret;
+
+	ret = flock(uio->dev.fd, LOCK_EX | LOCK_NB);
+	if (ret < 0)
+		return ret;
+
+	if (uio->mem.iomem) {
+		lck.l_type = F_WRLCK;
+		lck.l_whence = SEEK_SET;
+		lck.l_start = 0;
+		lck.l_len = (uio->mem.size + pagesize - 1) / pagesize;
+
+		ret = fcntl(uio->dev.fd, F_SETLK, &lck);
+		if (ret < 0) {
+			int save_errno = errno;
+			flock(uio->dev.fd, LOCK_UN);
+			errno = save_errno;
+			return ret;
+		}
+	}
+
+	uio->exclusive = 1;
+
+	return 0;
+}
+
+/* Map the memory region at the same virtual address in every process.
+   The first process to do so offers the address its own mapping is at,
+   through the shared state; the others map the region there too, and
+   fail with EEXIST if something else occupies the address. All handles
+   in a process share one mapping. */
+int uio_map_fixed(struct uio *uio)
 {
-	int fd, ret;
-	fd_set readset;
-	int nfds;
-	int exit_fd;
+	const long pagesize = sysconf(_SC_PAGESIZE);
+	int res = uio->device_index;
+	unsigned long agreed;
+	void *iomem;
+
+	if (uio->mem.iomem == NULL || uio->shm == NULL) {
+		errno = ENODEV;
+		return -1;
+	}
 
-	fd = uio->dev.fd;
+	pthread_mutex_lock(&fixed_lock);
 
-	exit_fd = uio->exit_sleep_pipe[0];
+	if (fixed_refcount[res] == 0) {
+		agreed = __sync_val_compare_and_swap(&uio->shm->mem_fixed, 0,
+					(unsigned long)uio->mem.iomem);
+		if (agreed == 0)
+			agreed = (unsigned long)uio->mem.iomem;
 
-	/* Enable interrupt in UIO driver */
-	{
-		unsigned long enable = 1;
+		if (agreed == (unsigned long)uio->mem.iomem) {
+			iomem = uio->mem.iomem;
+		} else {
+			iomem = mmap((void *)agreed, uio->mem.size,
+				     PROT_READ | PROT_WRITE,
+				     MAP_SHARED | MAP_FIXED_NOREPLACE,
+				     uio->dev.fd, pagesize);
+			if (iomem == MAP_FAILED) {
+				pthread_mutex_unlock(&fixed_lock);
+				return -1;
+			}
+			if (iomem != (void *)agreed) {
+				munmap(iomem, uio->mem.size);
+				pthread_mutex_unlock(&fixed_lock);
+				errno = EEXIST;
+				return -1;
+			}
+			munmap(uio->mem.iomem, uio->mem.size);
+		}
+		fixed_iomem[res] = iomem;
+	} else {
+		munmap(uio->mem.iomem, uio->mem.size);
+	}
 
-		ret = write(fd, &enable, sizeof(u_long));
+	fixed_refcount[res]++;
+	uio->mem.iomem = fixed_iomem[res];
+	uio->mem_fixed = 1;
+
+	pthread_mutex_unlock(&fixed_lock);
+
+#ifdef DEBUG
+	fprintf(stderr, "%s: %s memory mapped at %p\n", __func__,
+		uio->dev.name, uio->mem.iomem);
+#endif
+
+	return 0;
+}
+
+/* Time left until a CLOCK_MONOTONIC deadline, or NULL for no deadline */
+struct timespec *
+uio_deadline_remaining(const struct timespec *deadline,
+		       struct timespec *remaining)
+{
+	struct timespec now;
+
+	if (deadline == NULL)
+		return NULL;
+
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	remaining->tv_sec = deadline->tv_sec - now.tv_sec;
+	remaining->tv_nsec = deadline->tv_nsec - now.tv_nsec;
+	if (remaining->tv_nsec < 0) {
+		remaining->tv_sec--;
+		remaining->tv_nsec += 1000000000;
+	}
+
+	/* An expired deadline still checks interrupt status */
+	if (remaining->tv_sec < 0)
+		remaining->tv_sec = remaining->tv_nsec = 0;
+
+	return remaining;
+}
+
+/* Wait for an interrupt on any of n devices until the CLOCK_MONOTONIC
+   deadline, or forever if deadline is NULL. On interrupt, returns 0 and
+   sets bit k of *fired for each uios[k] that has fired. Returns -1 on
+   timeout (errno is ETIMEDOUT), wakeup (errno is EINTR) or error. */
+int uio_sleep_any(struct uio **uios, int n, const struct timespec *deadline,
+		  int *fired)
+{
+	struct pollfd fds[UIO_DEVICE_MAX + 1];
+	struct uio_waiter waiters[UIO_DEVICE_MAX];
+	struct uio_thread *t;
+	struct timespec remaining;
+	uint64_t enabled, woken;
+	uint32_t count;
+	int ret, k, pending = 0;
+
+	if (n <= 0 || n > UIO_DEVICE_MAX)
+		return -1;
+
+	/* All devices of a handle share its engine */
+	if (uios[0]->uring)
+		return uio_uring_wait(uios[0]->uring, uios, n, deadline, fired,
+				      NULL, 0, NULL);
+
+	if ((t = uio_thread_self()) == NULL)
+		return -1;
+
+	for (k = 0; k < n; k++) {
+		fds[k].fd = uios[k]->dev.fd;
+		fds[k].events = POLLIN;
+	}
+	fds[n].fd = t->efd;
+	fds[n].events = POLLIN;
+
+again:
+	for (k = 0; k < n; k++) {
+		ret = uio_irq_enable(uios[k]);
 		if (ret < 0)
 			return ret;
 	}
 
+	enabled = uio_time_ns();
+
+	for (k = 0; k < n; k++)
+		pending |= uio_wait_begin(uios[k], &waiters[k], t);
+
 	/* Wait for an interrupt */
-	{
-		unsigned long n_pending;
-		FD_ZERO(&readset);
-		FD_SET(fd, &readset);
-		FD_SET(exit_fd, &readset);
+	ret = 0;
+	while (!pending) {
+		ret = ppoll(fds, n + 1,
+			    uio_deadline_remaining(deadline, &remaining),
+			    NULL);
+		if (ret >= 0 || errno != EINTR)
+			break;
+	}
 
-		nfds = fd > exit_fd ? fd + 1 : exit_fd + 1;
+	if (ret > 0 && (fds[n].revents & POLLIN))
+		pending = 1;
 
-		ret = select(nfds, &readset, NULL, NULL, timeout);
-		if (!ret)
-			return -1;
-		if (FD_ISSET(exit_fd, &readset)) {
-			read(exit_fd, &n_pending, sizeof(u_long));
+	for (k = 0; k < n; k++) {
+		uio_wait_end(uios[k], &waiters[k]);
+		pending |= waiters[k].woken;
+	}
+
+	/* A wakeup takes precedence; any interrupt is left for the next
+	   sleep. Wakeups through the waiter lists only arrive while this
+	   sleep is on them, so they cannot leak into the next one. */
+	if (pending) {
+		uio_thread_woken(t);
+		errno = EINTR;
+		return -1;
+	}
+
+	if (ret == 0)
+		errno = ETIMEDOUT;
+	if (ret <= 0)
+		return -1;
+
+	woken = uio_time_ns();
+
+	*fired = 0;
+	for (k = 0; k < n; k++) {
+		/* Waiting again would return at once, forever */
+		if (fds[k].revents & (POLLERR | POLLHUP | POLLNVAL)) {
+			errno = (fds[k].revents & POLLNVAL) ? EBADF : EIO;
 			return -1;
 		}
-		ret = read(fd, &n_pending, sizeof(u_long));
+		if (fds[k].revents & POLLIN) {
+			ret = read(fds[k].fd, &count, sizeof(count));
+			if (ret < 0) {
+				/* Another thread read the count first */
+				if (errno == EAGAIN)
+					continue;
+				return ret;
+			}
+			uios[k]->irq_count = count;
+			uio_shm_irq(uios[k]->shm, count, enabled, woken);
+			*fired |= 1 << k;
+		}
+	}
+
+	/* Other threads read every count first; enable the interrupts
+	   again before waiting */
+	if (*fired == 0)
+		goto again;
+
+	return 0;
+}
+
+int uio_sleep_deadline(struct uio *uio, const struct timespec *deadline)
+{
+	int fired;
+
+	return uio_sleep_any(&uio, 1, deadline, &fired);
+}
+
+void uio_set_spin(struct uio *uio, uint64_t max_ns, int autotune)
+{
+	uio->spin_max = max_ns;
+	uio->spin_budget = max_ns;
+	uio->spin_autotune = autotune;
+	uio->job_avg = 0;
+}
+
+/* Adapt the spin budget to the observed wait times: spin for a little
+   longer than the average wait if that fits in the maximum, and don't spin
+   at all for jobs which are longer than that. */
+static void uio_spin_tune(struct uio *uio, uint64_t elapsed)
+{
+	uint64_t budget;
+
+	if (uio->job_avg == 0)
+		uio->job_avg = elapsed;
+	else
+		uio->job_avg = (uio->job_avg * 7 + elapsed) / 8;
+
+	budget = uio->job_avg + uio->job_avg / 2;
+	uio->spin_budget = (budget <= uio->spin_max) ? budget : 0;
+}
+
+/* Wait for completion by spinning for up to the spin budget before
+   falling back to a blocking wait. If reg is given, completion is
+   (*reg & mask) == value, and the interrupt is only enabled once spinning
+   has failed so that a completion seen while spinning leaves no interrupt
+   pending. Otherwise the interrupt is enabled and its count is polled. */
+int uio_sleep_adaptive(struct uio *uio, volatile uint32_t *reg,
+		       uint32_t mask, uint32_t value)
+{
+	uint64_t start, budget;
+	int ret;
+
+	budget = uio->spin_budget;
+	start = uio_time_ns();
+
+	if (reg) {
+		while (budget) {
+			if ((*reg & mask) == value)
+				goto done;
+			if (uio_time_ns() - start >= budget)
+				break;
+		}
+	} else if (budget) {
+		ret = uio_irq_enable(uio);
 		if (ret < 0)
 			return ret;
+
+		do {
+			if (uio_read_nonblocking(uio, NULL) == 0)
+				goto done;
+		} while (uio_time_ns() - start < budget);
 	}
 
+	ret = uio_sleep_deadline(uio, NULL);
+	if (ret < 0)
+		return ret;
+
+done:
+	if (uio->spin_autotune)
+		uio_spin_tune(uio, uio_time_ns() - start);
+
 	return 0;
 }
 
-int uio_read_nonblocking(struct uio *uio)
+int uio_sleep(struct uio *uio, struct timeval *timeout)
 {
-	int fd, ret;
-	unsigned long n_pending;
+	struct timespec deadline;
 
-	fd = uio->dev.fd;
+	if (timeout == NULL)
+		return uio_sleep_deadline(uio, NULL);
 
-	/* Perform a non-blocking read. This is needed to allow multiple file
-	   handles to work since UIO read returns when the number of interrupts
-	   recieved is different to that stored in the file handle. The latter
-	   is only updated in open and read. */
-	ret = fcntl(fd, F_SETFL, O_SYNC | O_NONBLOCK);
+	clock_gettime(CLOCK_MONOTONIC, &deadline);
+	deadline.tv_sec += timeout->tv_sec;
+	deadline.tv_nsec += timeout->tv_usec * 1000;
+	if (deadline.tv_nsec >= 1000000000) {
+		deadline.tv_sec++;
+		deadline.tv_nsec -= 1000000000;
+	}
+
+	return uio_sleep_deadline(uio, &deadline);
+}
+
+/* Enable interrupt in UIO driver. The UIO driver only accepts 32-bit
+   values, whatever the size of long. */
+int uio_irq_enable(struct uio *uio)
+{
+	uint32_t enable = 1;
+	int ret;
+
+	ret = write(uio->dev.fd, &enable, sizeof(enable));
 	if (ret < 0)
 		return ret;
 
-	ret = read(fd, &n_pending, sizeof(u_long));
-	fcntl(fd, F_SETFL, O_SYNC);
+	return 0;
+}
 
+/* Read the interrupt count without blocking. Returns 0 and the count if an
+   interrupt occurred since the last read on this handle, or -1 with errno
+   set to EAGAIN if none did. */
+int uio_read_nonblocking(struct uio *uio, unsigned long *count)
+{
+	int ret;
+	uint32_t n_pending;
+
+	/* Perform a non-blocking read. This is needed to allow multiple file
+	   handles to work since UIO read returns when the number of interrupts
+	   recieved is different to that stored in the file handle. The latter
+	   is only updated in open and read. The device is opened O_NONBLOCK,
+	   so this is a single syscall. */
+	ret = read(uio->dev.fd, &n_pending, sizeof(n_pending));
 	if (ret < 0)
 		return ret;
 
+	uio->irq_count = n_pending;
+	uio_shm_irq(uio->shm, n_pending, 0, 0);
+	if (count)
+		*count = n_pending;
+
 	return 0;
 }
 
@@ -434,7 +970,8 @@ static int uio_mem_unlock(int fd, int offset, int count)
  * offsets. Obviously this will be quite slow if another process has already
  * allocated memory.
  */
-static int uio_mem_find(int fd, int res, int max, int count, int align, int shared)
+static int uio_mem_find(int fd, int res, int max, int count, int align,
+			int shared, int exclusive)
 {
 	int s, l, c;
 
@@ -455,6 +992,10 @@ static int uio_mem_find(int fd, int res, int max, int count, int align, int shar
 		if (c <= 0) {
 			int ret;
 
+			/* An exclusive handle already holds the whole region */
+			if (exclusive)
+				goto found;
+
 			/* Attempt to lock the region */
 			ret = uio_mem_lock(fd, s, count, shared);
 			if (!ret)
@@ -487,12 +1028,13 @@ static int uio_mem_alloc(int fd, int res, int offset, int count, int shared)
 
 static pthread_cond_t mc_cond = PTHREAD_COND_INITIALIZER;
 
-static int uio_mem_free(int fd, int res, int offset, int count)
+static int uio_mem_free(int fd, int res, int offset, int count, int exclusive)
 {
 	struct flock lck;
-	int ret;
+	int ret = 0;
 
-	ret = uio_mem_unlock(fd, offset, count);
+	if (!exclusive)
+		ret = uio_mem_unlock(fd, offset, count);
 
 	if (ret == 0) {
 		pthread_mutex_lock(&mc_lock);
@@ -515,6 +1057,7 @@ void *uio_malloc(struct uio *uio, size_t size, int align, int shared)
 		fprintf(stderr,
 			"%s: Allocation failed: uio->mem.iomem NULL\n",
 			__func__);
+		uio_shm_mem_failed(uio->shm);
 		return NULL;
 	}
 
@@ -527,13 +1070,18 @@ void *uio_malloc(struct uio *uio, size_t size, int align, int shared)
 	pthread_mutex_lock(&mc_lock);
 	if ((base = uio_mem_find(uio->dev.fd, uio->device_index,
 				 pages_max, pages_req,
-				 pages_align, shared)) == -1) {
+				 pages_align, shared, uio->exclusive)) == -1) {
 		pthread_mutex_unlock(&mc_lock);
+		uio_shm_mem_failed(uio->shm);
 		return NULL;
 	}
 	uio_mem_alloc(uio->dev.fd, uio->device_index, base, pages_req, shared);
 	pthread_mutex_unlock(&mc_lock);
 
+	uio_shm_extent_add(uio->shm, base, pages_req,
+			   shared ? UIO_EXTENT_SHARED : 0);
+	uio_shm_mem_alloc(uio->shm, pages_req * pagesize);
+
 	mem_base = (void *)
 		((unsigned long)uio->mem.iomem + (base * pagesize));
 
@@ -570,11 +1118,13 @@ int uio_mlock(struct uio *uio, void *address, size_t size, int wait)
 		return -ENODEV;
 	}
 
-	/* wait for available */
-	if (wait)
-		uio_mem_lock_wait(uio->dev.fd, base, count, 0);
-	else
-		uio_mem_lock(uio->dev.fd, base, count, 0);
+	/* wait for available; an exclusive handle holds the whole region */
+	if (!uio->exclusive) {
+		if (wait)
+			uio_mem_lock_wait(uio->dev.fd, base, count, 0);
+		else
+			uio_mem_lock(uio->dev.fd, base, count, 0);
+	}
 retry:
 	for (i=count, n=base; i>0; i--,n++) {
 		if (mc_map[res][n] == PAGE_ALLOCATED) {
@@ -593,10 +1143,15 @@ retry:
 
 	pthread_mutex_unlock(&mc_lock);
 
+	if (ret == 0)
+		uio_shm_extent_add(uio->shm, base, count, UIO_EXTENT_LOCKED);
+
 	return ret;
 }
 
-void uio_free(struct uio *uio, void *address, size_t size)
+/* Release pages taken by uio_malloc() or uio_mlock(). Returns the
+   number of pages. */
+static int uio_release(struct uio *uio, void *address, size_t size)
 {
 	int pagesize, base, pages_req;
 
@@ -605,7 +1160,25 @@ void uio_free(struct uio *uio, void *address, size_t size)
 	base = (int)(((unsigned long)address -
 		      (unsigned long)uio->mem.iomem) / pagesize);
 	pages_req = (size + pagesize - 1) / pagesize;
-	uio_mem_free(uio->dev.fd, uio->device_index, base, pages_req);
+	uio_mem_free(uio->dev.fd, uio->device_index, base, pages_req,
+		     uio->exclusive);
+	uio_shm_extent_remove(uio->shm, base, pages_req);
+
+	return pages_req;
+}
+
+void uio_free(struct uio *uio, void *address, size_t size)
+{
+	int pages;
+
+	pages = uio_release(uio, address, size);
+	uio_shm_mem_free(uio->shm, pages * sysconf(_SC_PAGESIZE));
+}
+
+/* Memory locked by uio_mlock() was never counted as allocated */
+void uio_munlock(struct uio *uio, void *address, size_t size)
+{
+	uio_release(uio, address, size);
 }
 
 static void print_usage(int pid, long base, long top)
@@ -626,7 +1199,8 @@ static void print_usage(int pid, long base, long top)
 	}
 }
 
-void uio_meminfo(struct uio *uio)
+/* Without the shared extent table, ask for the lock owner of each page */
+static void uio_meminfo_scan(struct uio *uio)
 {
 	struct flock lck;
 	const long pagesize = sysconf(_SC_PAGESIZE);
@@ -646,3 +1220,41 @@ void uio_meminfo(struct uio *uio)
 			print_usage(lck.l_pid, base, base + pagesize - 1);
 	}
 }
+
+void uio_meminfo(struct uio *uio)
+{
+	struct uio_shm_extent *extents;
+	const long pagesize = sysconf(_SC_PAGESIZE);
+	const unsigned int pages_max = uio->mem.size / pagesize;
+	const long address = uio->mem.address;
+	unsigned int page = 0, end;
+	int i, n;
+
+	if (uio->shm == NULL ||
+	    (extents = malloc(UIO_SHM_EXTENTS * sizeof(*extents))) == NULL) {
+		uio_meminfo_scan(uio);
+		return;
+	}
+
+	/* One line for each run of pages with the same owner, or none */
+	n = uio_shm_extents(uio->shm, extents);
+	for (i = 0; i < n; i++) {
+		end = extents[i].start + extents[i].count;
+		if (extents[i].start > page)
+			print_usage(0, address + page * pagesize,
+				    address + extents[i].start * pagesize - 1);
+		print_usage(extents[i].pid, address + extents[i].start * pagesize,
+			    address + end * pagesize - 1);
+		if (end > page)
+			page = end;
+	}
+	if (page < pages_max)
+		print_usage(0, address + page * pagesize,
+			    address + pages_max * pagesize - 1);
+
+	if (uio->shm->extents_untracked)
+		printf("%lu allocations not tracked\n",
+		       uio->shm->extents_untracked);
+
+	free(extents);
+}
@@ -20,6 +20,13 @@
 #ifndef __UIOMUX_UIO_H__
 #define __UIOMUX_UIO_H__
 
+#include <poll.h>
+#include <pthread.h>
+#include <stdint.h>
+#include <time.h>
+#include <sys/time.h>
+#include <sys/types.h>
+
 #define UIO_DEVICE_MAX		16
 
 /* max length of UIO names found in /sys/class/uio/uioNN/name */
@@ -40,12 +47,45 @@ struct uio_map {
   void *iomem;
 };
 
+/* A thread which may sleep on devices, woken through its eventfd */
+struct uio_thread {
+  pthread_t thread;
+  int efd;
+  struct uio_uring * volatile ring;	/* ring it is waiting on, if any */
+};
+
+/* An entry on the waiter list of a device for the duration of a sleep */
+struct uio_waiter {
+  struct uio_thread *thread;
+  int woken;
+  struct uio_waiter *next;
+};
+
 struct uio {
   struct uio_device dev;
   struct uio_map mmio;
   struct uio_map mem;
-  int exit_sleep_pipe[2];
+
+  /* Threads sleeping on the device, oldest first */
+  pthread_mutex_t wait_lock;
+  struct uio_waiter *waiters;
+  int wake_pending;		/* wakeup that found no sleeper */
+
+  unsigned long irq_count;	/* last interrupt count read */
   int device_index;
+
+  /* Spin-then-sleep completion wait */
+  uint64_t spin_max;		/* ns; 0 disables spinning */
+  uint64_t spin_budget;		/* ns; current spin budget */
+  uint64_t job_avg;		/* ns; average observed wait */
+  int spin_autotune;
+  int exclusive;
+  int mem_fixed;		/* mem is mapped at the agreed address */
+  struct uio_shm_device *shm;
+
+  /* io_uring engine the device waits through, if any */
+  struct uio_uring *uring;
+  int uring_slot;
 };
 
 struct uio *
@@ -54,11 +94,58 @@ uio_open (const char * name);
 int
 uio_close (struct uio * uio);
 
+int
+uio_claim (struct uio * uio);
+
+int
+uio_map_fixed (struct uio * uio);
+
+/* Ways of waking up sleepers in uio_wakeup() */
+#define UIO_WAKE_ALL	0
+#define UIO_WAKE_ONE	1
+#define UIO_WAKE_THREAD	2
+
+struct uio_thread *
+uio_thread_self (void);
+
+int
+uio_thread_wake (struct uio_thread * t);
+
+int
+uio_thread_woken (struct uio_thread * t);
+
+int
+uio_wait_begin (struct uio * uio, struct uio_waiter * w,
+                struct uio_thread * t);
+
+void
+uio_wait_end (struct uio * uio, struct uio_waiter * w);
+
+int
+uio_wakeup (struct uio * uio, int how, pthread_t thread);
+
 int
 uio_sleep(struct uio *uio, struct timeval *timeout);
 
 int
-uio_read_nonblocking(struct uio *uio);
+uio_sleep_deadline(struct uio *uio, const struct timespec *deadline);
+
+int
+uio_sleep_any(struct uio **uios, int n, const struct timespec *deadline,
+	      int *fired);
+
+void
+uio_set_spin(struct uio *uio, uint64_t max_ns, int autotune);
+
+int
+uio_sleep_adaptive(struct uio *uio, volatile uint32_t *reg,
+		   uint32_t mask, uint32_t value);
+
+int
+uio_irq_enable(struct uio *uio);
+
+int
+uio_read_nonblocking(struct uio *uio, unsigned long *count);
 
 void *
 uio_malloc (struct uio * uio, size_t size, int align, int shared);
@@ -69,6 +156,9 @@ uio_mlock(struct uio *uio, void *address, size_t size, int wait);
 void
 uio_free (struct uio * uio, void * address, size_t size);
 
+void
+uio_munlock (struct uio * uio, void * address, size_t size);
+
 void
 uio_meminfo (struct uio * uio);
 
@@ -78,4 +168,17 @@ uio_list_device (char *** names, int * count);
 int
 uio_device_index (struct uio * uio);
 
+uint64_t
+uio_time_ns (void);
+
+struct timespec *
+uio_deadline_remaining (const struct timespec * deadline,
+                        struct timespec * remaining);
+
+pid_t
+uio_getpid (void);
+
+pid_t
+uio_gettid (void);
+
 #endif /* __UIOMUX_UIO_H__ */
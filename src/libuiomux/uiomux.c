@@ -36,6 +36,9 @@
 #include "uiomux/uiomux.h"
 #include "uiomux_private.h"
 #include "uio.h"
+#include "shm.h"
+#include "region.h"
+#include "uring.h"
 
 /* #define DEBUG */
 
@@ -43,74 +46,77 @@ static int init_done = 0;
 static pthread_mutex_t mutex = PTHREAD_MUTEX_INITIALIZER;
 static pthread_mutex_t uio_mutex[UIOMUX_BLOCK_MAX];
 
-static struct uiomux_addr_block *g_mem_regions = NULL;
+/* Devices claimed by an exclusive handle in this process, set and cleared
+   under uio_mutex. Another handle locking one would take the uio_mutex and
+   then block in flock() for good, so uiomux_lock() refuses instead. */
+static int uio_claimed[UIOMUX_BLOCK_MAX];
 
-/* Simple single list */
-static void add_mem_block(struct uiomux_addr_block **start, struct uiomux_addr_block *new)
+/* Claim a device for an exclusive handle. Fails if a handle in this
+   process holds its lock, or if it is locked or claimed elsewhere. */
+static int uiomux_claim(struct uio *uio)
 {
-	struct uiomux_addr_block *curr = *start;
+	int d = uio_device_index(uio);
+	int ret;
 
-	new->next = NULL;
-
-	if (curr == NULL) {
-		*start = new;
-		return;
-	}
-	while (curr->next != NULL)
-		curr = curr->next;
-	curr->next = new;
-}
-
-/* Remove old from the list, doesn't free old */
-static int rm_mem_block(struct uiomux_addr_block **start, struct uiomux_addr_block *old)
-{
-	struct uiomux_addr_block *curr = *start;
-
-	if (curr == NULL)
+	if (pthread_mutex_trylock(&uio_mutex[d]) != 0) {
+		errno = EBUSY;
 		return -1;
-
-	if (curr == old) {
-		*start = curr->next;
-		return 0;
 	}
-	while (curr->next != old)
-		curr = curr->next;
-	curr->next = old->next;
+	ret = uio_claim(uio);
+	if (ret == 0)
+		uio_claimed[d] = 1;
+	pthread_mutex_unlock(&uio_mutex[d]);
 
-	return 0;
+	return ret;
 }
 
-/* Find a mem block */
-static struct uiomux_addr_block *
-find_mem_block(struct uiomux_addr_block **start, void *virt)
+/* Give up the claim of a device before closing it. The handle may still
+   hold its lock, in which case the uio_mutex is already taken. */
+static void uiomux_unclaim(struct uio *uio, int locked)
 {
-	struct uiomux_addr_block *curr = *start;
+	int d = uio_device_index(uio);
 
-	while (curr != NULL) {
-		if ((virt >= curr->virt) &&
-		    (virt <= curr->virt + curr->size - 1))
-			return curr;
-		curr = curr->next;
-	}
-
-	return NULL;
+	if (!locked)
+		pthread_mutex_lock(&uio_mutex[d]);
+	uio_claimed[d] = 0;
+	pthread_mutex_unlock(&uio_mutex[d]);
 }
 
-/* Dump all mem blocks */
-static void dump_mem_blocks(struct uiomux_addr_block **start)
+/* Registered and allocated memory, sorted by virtual address, and
+   registered memory and device maps, sorted by physical address. Lookups
+   take no lock, changes are serialised by region_mutex. */
+static struct uio_region_index g_mem_regions;
+static struct uio_region_index g_phys_regions = { .by_phys = 1 };
+static pthread_mutex_t region_mutex = PTHREAD_MUTEX_INITIALIZER;
+
+/* Add or remove the maps of a device to the physical address index. If
+   adding fails, the maps are simply not found by phys_to_virt lookups. */
+static void index_maps(struct uio *uio, int add)
 {
-	struct uiomux_addr_block *curr = *start;
+	struct uio_map *maps[2] = { &uio->mem, &uio->mmio };
+	struct uio_region region;
+	int i;
 
-	while (curr != NULL) {
-		fprintf(stderr, "virt=%p, phys=0x%lX, size=%d\n", curr->virt, curr->phys, curr->size);
-		curr = curr->next;
+	pthread_mutex_lock(&region_mutex);
+	for (i = 0; i < 2; i++) {
+		if (maps[i]->iomem == NULL || maps[i]->size == 0)
+			continue;
+		if (add) {
+			uio_region_add(&g_phys_regions, maps[i]->iomem,
+				       maps[i]->address, maps[i]->size);
+		} else {
+			region.virt = maps[i]->iomem;
+			region.phys = maps[i]->address;
+			region.size = maps[i]->size;
+			uio_region_remove_entry(&g_phys_regions, &region);
+		}
 	}
+	pthread_mutex_unlock(&region_mutex);
 }
 
 struct uiomux *uiomux_open_named(const char * name[])
 {
 	struct uiomux *uiomux;
-	struct uiomux_addr_block *mem;
 	int i;
 
 	pthread_mutex_lock(&mutex);
@@ -133,15 +139,16 @@ struct uiomux *uiomux_open_named(const char * name[])
 		if (!name[i])
 			break;
 		uiomux->uios[i] = uio_open(name[i]);
+		if (uiomux->uios[i])
+			index_maps(uiomux->uios[i], 1);
 	}
 
 	return uiomux;
 }
 
-struct uiomux *uiomux_open_blocks(uiomux_resource_t blocks)
+struct uiomux *uiomux_open_flags(uiomux_resource_t blocks, int flags)
 {
 	struct uiomux *uiomux;
-	struct uiomux_addr_block *mem;
 	const char *name = NULL;
 	int i, bit;
 
@@ -160,32 +167,92 @@ struct uiomux *uiomux_open_blocks(uiomux_resource_t blocks)
 	if (!uiomux)
 		return NULL;
 
+	uiomux->flags = flags;
+
 	/* Open handles to all hardware blocks */
 	for (i = 0; i < UIOMUX_BLOCK_MAX; i++) {
 		bit = 1 << i;
 		if ((blocks & bit) && (name = uiomux_name(bit)) != NULL) {
 			uiomux->uios[i] = uio_open(name);
 		}
+
+		/* A block that is already claimed is not available */
+		if (uiomux->uios[i] && (flags & UIOMUX_OPEN_EXCLUSIVE) &&
+		    uiomux_claim(uiomux->uios[i]) < 0) {
+#ifdef DEBUG
+			fprintf(stderr, "%s: Unable to claim %s\n",
+				__func__, name);
+#endif
+			uio_close(uiomux->uios[i]);
+			uiomux->uios[i] = NULL;
+		}
+
+		/* As is a block whose memory cannot be mapped at the
+		   address agreed with other processes */
+		if (uiomux->uios[i] && (flags & UIOMUX_OPEN_FIXED_MAP) &&
+		    uio_map_fixed(uiomux->uios[i]) < 0) {
+#ifdef DEBUG
+			fprintf(stderr, "%s: Unable to map %s at a fixed address\n",
+				__func__, name);
+#endif
+			if (uiomux->uios[i]->exclusive)
+				uiomux_unclaim(uiomux->uios[i], 0);
+			uio_close(uiomux->uios[i]);
+			uiomux->uios[i] = NULL;
+		}
+
+		if (uiomux->uios[i])
+			index_maps(uiomux->uios[i], 1);
 	}
 
 	return uiomux;
 }
 
+struct uiomux *uiomux_open_blocks(uiomux_resource_t blocks)
+{
+	return uiomux_open_flags(blocks, 0);
+}
+
 struct uiomux *uiomux_open(void)
 {
 	return uiomux_open_blocks(UIOMUX_ALL);
 }
 
+/* Stop the threads of a handle before it is freed. A callback of one of
+   them cannot, as its thread would go on using the handle; this is checked
+   for all of them before any is stopped, so that a refusal leaves the
+   handle as it was. */
+static int uiomux_stop_threads(struct uiomux *uiomux)
+{
+	if (uiomux_watchdog_self(uiomux) || uiomux_dispatch_self(uiomux)) {
+		errno = EDEADLK;
+		return -1;
+	}
+
+	uiomux_watchdog_stop(uiomux);
+	uiomux_sampler_stop(uiomux);
+	uiomux_dispatch_stop(uiomux);
+
+	return 0;
+}
+
+/* Free a handle whose threads are stopped */
 static void uiomux_delete(struct uiomux *uiomux)
 {
 	struct uio *uio;
 	int i;
 
+	uio_uring_free(uiomux->uring);
+
 	pthread_mutex_lock(&mutex);
 
 	for (i = 0; i < UIOMUX_BLOCK_MAX; i++) {
 		uio = uiomux->uios[i];
 		if (uio != NULL) {
+			if (uio->exclusive)
+				uiomux_unclaim(uio, uiomux->locked_resources &
+					       (1U << i));
+			index_maps(uio, 0);
 			uio_close(uio);
 		}
 	}
@@ -204,6 +271,9 @@ int uiomux_close(struct uiomux *uiomux)
 	fprintf(stderr, "%s: IN\n", __func__);
 #endif
 
+	if (uiomux_stop_threads(uiomux) < 0)
+		return -1;
+
 	uiomux_delete(uiomux);
 
 	return 0;
@@ -217,9 +287,12 @@ int uiomux_system_reset(struct uiomux *uiomux)
 
 int uiomux_system_destroy(struct uiomux *uiomux)
 {
+	if (uiomux == NULL || uiomux_stop_threads(uiomux) < 0)
+		return -1;
+
 	uiomux_delete(uiomux);
 
-	return 0;
+	return uio_shm_unlink();
 }
 
 int uiomux_lock(struct uiomux *uiomux, uiomux_resource_t blockmask)
@@ -227,6 +300,7 @@ int uiomux_lock(struct uiomux *uiomux, uiomux_resource_t blockmask)
 	unsigned long *reg_base;
 	int i, k, ret = 0;
 	struct uio *uio;
+	uint64_t start;
 
 	for (i = 0; i < UIOMUX_BLOCK_MAX; i++) {
 		if (blockmask & (1 << i)) {
@@ -237,23 +311,47 @@ int uiomux_lock(struct uiomux *uiomux, uiomux_resource_t blockmask)
 				goto undo_locks;
 			}
 
+			start = uio_shm_lock_begin(uio->shm);
+
 			/* Lock uio within this process. This is required because the
 			   fcntl()'s advisory lock is only valid between processes, not
 			   within a process. */
 			ret = pthread_mutex_lock(&uio_mutex[uio_device_index(uio)]);
 			if (ret != 0) {
 				perror("pthread_mutex_lock failed");
+				uio_shm_lock_end(uio->shm, start, 0);
 				goto undo_locks;
 			}
 
+			/* Another handle has claimed the device and holds its
+			   flock() until it is closed */
+			if (!uio->exclusive && uio_claimed[uio_device_index(uio)]) {
+				uio_shm_lock_end(uio->shm, start, 0);
+				pthread_mutex_unlock(&uio_mutex[uio_device_index(uio)]);
+				errno = EBUSY;
+				ret = -1;
+				goto undo_locks;
+			}
+
+			/* An exclusive handle already holds the flock(), and
+			   no other file handle consumes its interrupts. */
+			if (uio->exclusive) {
+				uio_shm_lock_end(uio->shm, start, 1);
+				uiomux->locked_resources |= 1U << i;
+				continue;
+			}
+
 			ret = flock(uio->dev.fd, LOCK_EX);
 			if (ret < 0) {
 				perror("flock failed");
+				uio_shm_lock_end(uio->shm, start, 0);
+				pthread_mutex_unlock(&uio_mutex[uio_device_index(uio)]);
 				goto undo_locks;
 			}
 
+			uio_shm_lock_end(uio->shm, start, 1);
 			uiomux->locked_resources |= 1U << i;
-			uio_read_nonblocking(uio);
+			uio_read_nonblocking(uio, NULL);
 		}
 	}
 
@@ -279,10 +377,16 @@ int uiomux_unlock(struct uiomux *uiomux, uiomux_resource_t blockmask)
 		if (blockmask & (1 << i)) {
 			uio = uiomux->uios[i];
 			if (uio) {
-				ret = flock(uio->dev.fd, LOCK_UN);
-				if (ret < 0)
-					perror("flock failed");
+				if (uiomux->locked_resources & (1U << i))
+					uio_shm_unlock(uio->shm);
+
+				if (!uio->exclusive) {
+					ret = flock(uio->dev.fd, LOCK_UN);
+					if (ret < 0)
+						perror("flock failed");
+				}
 
+				uiomux->locked_resources &= ~(1U << i);
 				ret = pthread_mutex_unlock(&uio_mutex[uio_device_index(uio)]);
 				if (ret != 0)
 					perror("pthread_mutex_unlock failed");
@@ -364,7 +468,9 @@ int uiomux_sleep_timeout(struct uiomux *uiomux,
 	return ret;
 }
 
-int uiomux_wakeup(struct uiomux *uiomux, uiomux_resource_t blockmask)
+int uiomux_sleep_deadline(struct uiomux *uiomux,
+			  uiomux_resource_t blockmask,
+			  const struct timespec *deadline)
 {
 	struct uio *uio;
 	int ret = 0;
@@ -376,20 +482,312 @@ int uiomux_wakeup(struct uiomux *uiomux, uiomux_resource_t blockmask)
 
 	uio = uiomux->uios[i];
 
+	if (uio) {
+#ifdef DEBUG
+		fprintf(stderr, "%s: Waiting for block %d\n", __func__, i);
+#endif
+		ret = uio_sleep_deadline(uio, deadline);
+	}
+
+	return ret;
+}
+
+int uiomux_sleep_any(struct uiomux *uiomux, uiomux_resource_t blockmask,
+		     const struct timespec *deadline,
+		     uiomux_resource_t *fired)
+{
+	struct uio *uios[UIOMUX_BLOCK_MAX];
+	int index[UIOMUX_BLOCK_MAX];
+	int i, k, n = 0, ret, fired_uios;
+
+	for (i = 0; i < UIOMUX_BLOCK_MAX; i++) {
+		if ((blockmask & (1 << i)) && uiomux->uios[i]) {
+			uios[n] = uiomux->uios[i];
+			index[n++] = i;
+		}
+	}
+
+	/* Invalid if none of the blocks is managed */
+	if (n == 0)
+		return -1;
+
+#ifdef DEBUG
+	fprintf(stderr, "%s: Waiting for %d blocks\n", __func__, n);
+#endif
+	ret = uio_sleep_any(uios, n, deadline, &fired_uios);
+	if (ret < 0)
+		return ret;
+
+	if (fired) {
+		*fired = UIOMUX_NONE;
+		for (k = 0; k < n; k++) {
+			if (fired_uios & (1 << k))
+				*fired |= 1 << index[k];
+		}
+	}
+
+	return 0;
+}
+
+int uiomux_set_spin(struct uiomux *uiomux, uiomux_resource_t blockmask,
+		    unsigned long max_spin_us, int autotune)
+{
+	int i;
+
+	/* Invalid if multiple bits are set, or block not found */
+	if ((i = uiomux_get_block_index(uiomux, blockmask)) == -1)
+		return -1;
+
+	if (uiomux->uios[i] == NULL)
+		return -1;
+
+	uio_set_spin(uiomux->uios[i], (uint64_t)max_spin_us * 1000, autotune);
+
+	return 0;
+}
+
+int uiomux_sleep_adaptive(struct uiomux *uiomux, uiomux_resource_t blockmask,
+			  const struct uiomux_poll_reg *reg)
+{
+	struct uio *uio;
+	volatile uint32_t *status = NULL;
+	int i;
+
+	/* Invalid if multiple bits are set, or block not found */
+	if ((i = uiomux_get_block_index(uiomux, blockmask)) == -1)
+		return -1;
+
+	uio = uiomux->uios[i];
+	if (uio == NULL)
+		return -1;
+
+	if (reg) {
+		if (reg->offset + sizeof(uint32_t) > uio->mmio.size ||
+		    (reg->offset & (sizeof(uint32_t) - 1)))
+			return -1;
+		status = (volatile uint32_t *)
+			((unsigned char *)uio->mmio.iomem + reg->offset);
+	}
+
+#ifdef DEBUG
+	fprintf(stderr, "%s: Waiting for block %d\n", __func__, i);
+#endif
+	return uio_sleep_adaptive(uio, status,
+				  reg ? reg->mask : 0, reg ? reg->value : 0);
+}
+
+int uiomux_wakeup(struct uiomux *uiomux, uiomux_resource_t blockmask)
+{
+	struct uio *uio;
+	int i;
+
+	/* Invalid if multiple bits are set, or block not found */
+	if ((i = uiomux_get_block_index(uiomux, blockmask)) == -1)
+		return -1;
+
+	uio = uiomux->uios[i];
+
 	if (uio) {
 #ifdef DEBUG
 		fprintf(stderr, "%s: Waking up block %d\n", __func__, i);
 #endif
-		write (uio->exit_sleep_pipe[1], "UIOX", 4);
+		uio_wakeup(uio, UIO_WAKE_ALL, pthread_self());
 	}
 	return 0;
 }
 
+int uiomux_wakeup_one(struct uiomux *uiomux, uiomux_resource_t blockmask)
+{
+	int i;
+
+	/* Invalid if multiple bits are set, or block not found */
+	if ((i = uiomux_get_block_index(uiomux, blockmask)) == -1)
+		return -1;
+
+	if (uiomux->uios[i] == NULL)
+		return -1;
+
+	uio_wakeup(uiomux->uios[i], UIO_WAKE_ONE, pthread_self());
+
+	return 0;
+}
+
+int uiomux_wakeup_thread(struct uiomux *uiomux, pthread_t thread)
+{
+	int i, n = 0;
+
+	if (uiomux == NULL)
+		return -1;
+
+	for (i = 0; i < UIOMUX_BLOCK_MAX; i++) {
+		if (uiomux->uios[i] &&
+		    uio_wakeup(uiomux->uios[i], UIO_WAKE_THREAD, thread) > 0)
+			n++;
+	}
+
+	if (n == 0) {
+		errno = ESRCH;
+		return -1;
+	}
+
+	return 0;
+}
+
+int uiomux_get_irq_fd(struct uiomux *uiomux, uiomux_resource_t blockmask)
+{
+	int i;
+
+	/* Invalid if multiple bits are set, or block not found */
+	if ((i = uiomux_get_block_index(uiomux, blockmask)) == -1)
+		return -1;
+
+	if (uiomux->uios[i] == NULL)
+		return -1;
+
+	return uiomux->uios[i]->dev.fd;
+}
+
+int uiomux_irq_enable(struct uiomux *uiomux, uiomux_resource_t blockmask)
+{
+	int i;
+
+	/* Invalid if multiple bits are set, or block not found */
+	if ((i = uiomux_get_block_index(uiomux, blockmask)) == -1)
+		return -1;
+
+	if (uiomux->uios[i] == NULL)
+		return -1;
+
+	return uio_irq_enable(uiomux->uios[i]);
+}
+
+int uiomux_irq_ack(struct uiomux *uiomux, uiomux_resource_t blockmask,
+		   unsigned long *count)
+{
+	int i;
+
+	/* Invalid if multiple bits are set, or block not found */
+	if ((i = uiomux_get_block_index(uiomux, blockmask)) == -1)
+		return -1;
+
+	if (uiomux->uios[i] == NULL)
+		return -1;
+
+	return uio_read_nonblocking(uiomux->uios[i], count);
+}
+
+int uiomux_set_engine(struct uiomux *uiomux, int engine)
+{
+	struct uio_uring *ring;
+	int i;
+
+	if (uiomux == NULL)
+		return -1;
+
+	switch (engine) {
+	case UIOMUX_ENGINE_POLL:
+		uio_uring_free(uiomux->uring);
+		uiomux->uring = NULL;
+		return UIOMUX_ENGINE_POLL;
+	case UIOMUX_ENGINE_URING:
+		if (uiomux->uring)
+			return UIOMUX_ENGINE_URING;
+
+		/* Fall back to poll if the kernel has no usable io_uring */
+		ring = uio_uring_new();
+		if (ring == NULL) {
+#ifdef DEBUG
+			fprintf(stderr, "%s: io_uring not available\n",
+				__func__);
+#endif
+			return UIOMUX_ENGINE_POLL;
+		}
+
+		for (i = 0; i < UIOMUX_BLOCK_MAX; i++) {
+			if (uiomux->uios[i])
+				uio_uring_attach(ring, uiomux->uios[i]);
+		}
+		uiomux->uring = ring;
+		return UIOMUX_ENGINE_URING;
+	default:
+		errno = EINVAL;
+		return -1;
+	}
+}
+
+int uiomux_io_read(struct uiomux *uiomux, int fd, void *buf, size_t count,
+		   off_t offset, void *user_data)
+{
+	if (uiomux == NULL || uiomux->uring == NULL) {
+		errno = ENOSYS;
+		return -1;
+	}
+
+	return uio_uring_rw(uiomux->uring, 0, fd, buf, count, offset,
+			    user_data);
+}
+
+int uiomux_io_write(struct uiomux *uiomux, int fd, const void *buf,
+		    size_t count, off_t offset, void *user_data)
+{
+	if (uiomux == NULL || uiomux->uring == NULL) {
+		errno = ENOSYS;
+		return -1;
+	}
+
+	return uio_uring_rw(uiomux->uring, 1, fd, (void *)buf, count, offset,
+			    user_data);
+}
+
+int uiomux_io_wait(struct uiomux *uiomux, uiomux_resource_t blockmask,
+		   const struct timespec *deadline, uiomux_resource_t *fired,
+		   struct uiomux_io *io, int max_io)
+{
+	struct uio *uios[UIOMUX_BLOCK_MAX];
+	struct uio_io done[UIO_URING_IO_MAX];
+	int index[UIOMUX_BLOCK_MAX];
+	int i, k, n = 0, ret, fired_uios, n_io;
+
+	if (uiomux == NULL || uiomux->uring == NULL) {
+		errno = ENOSYS;
+		return -1;
+	}
+
+	for (i = 0; i < UIOMUX_BLOCK_MAX; i++) {
+		if ((blockmask & (1 << i)) && uiomux->uios[i]) {
+			uios[n] = uiomux->uios[i];
+			index[n++] = i;
+		}
+	}
+
+	if (max_io > UIO_URING_IO_MAX)
+		max_io = UIO_URING_IO_MAX;
+
+	ret = uio_uring_wait(uiomux->uring, uios, n, deadline, &fired_uios,
+			     done, io ? max_io : 0, &n_io);
+	if (ret < 0)
+		return ret;
+
+	if (fired) {
+		*fired = UIOMUX_NONE;
+		for (k = 0; k < n; k++) {
+			if (fired_uios & (1 << k))
+				*fired |= 1 << index[k];
+		}
+	}
+
+	for (k = 0; k < n_io; k++) {
+		io[k].user_data = done[k].user_data;
+		io[k].result = done[k].result;
+	}
+
+	return n_io;
+}
+
 void *uiomux_malloc(struct uiomux *uiomux, uiomux_resource_t blockmask,
 		    size_t size, int align)
 {
 	struct uio *uio;
-	struct uiomux_addr_block *mem;
 	void *ret = NULL;
 	int i;
 
@@ -404,26 +802,22 @@ void *uiomux_malloc(struct uiomux *uiomux, uiomux_resource_t blockmask,
 		fprintf(stderr, "%s: Allocating %d bytes for block %d\n",
 			__func__, size, i);
 #endif
-		mem = malloc(sizeof(*mem));
-		if (!mem)
-			return NULL;
-
 		ret = uio_malloc(uio, size, align, 0);
 
 		if (ret) {
-			mem->virt = ret;
-			mem->phys = uio->mem.address + (ret - uio->mem.iomem);
-			mem->size = size;
-			pthread_mutex_lock(&mutex);
-			add_mem_block(&g_mem_regions, mem);
-			pthread_mutex_unlock(&mutex);
-		} else {
-			free(mem);
-		}
+			unsigned long phys;
 
+			phys = uio->mem.address + (ret - uio->mem.iomem);
+			pthread_mutex_lock(&region_mutex);
+			if (uio_region_add(&g_mem_regions, ret, phys, size) < 0) {
+				uio_free(uio, ret, size);
+				ret = NULL;
+			}
+			pthread_mutex_unlock(&region_mutex);
 #ifdef DEBUG
-		fprintf(stderr, "%s: adding phys addr 0x%lX, virt addr %p\n", __func__, mem->phys, mem->virt);
+			fprintf(stderr, "%s: adding phys addr 0x%lX, virt addr %p\n", __func__, phys, ret);
 #endif
+		}
 	}
 
 	return ret;
@@ -505,7 +899,22 @@ void
 uiomux_munlock(struct uiomux *uiomux, uiomux_resource_t blockmask,
 	       void *address, size_t size)
 {
-	uiomux_free(uiomux, blockmask, address, size);
+	struct uio *uio;
+	int i;
+
+	/* Invalid if multiple bits are set, or block not found */
+	if ((i = uiomux_get_block_index(uiomux, blockmask)) == -1)
+		return;
+
+	uio = uiomux->uios[i];
+
+	if (uio) {
+#ifdef DEBUG
+		fprintf(stderr, "%s: Unlocking memory for block %d\n",
+			__func__, i);
+#endif
+		uio_munlock(uio, address, size);
+	}
 }
 
 void
@@ -513,7 +922,6 @@ uiomux_free(struct uiomux *uiomux, uiomux_resource_t blockmask,
 	    void *address, size_t size)
 {
 	struct uio *uio;
-	struct uiomux_addr_block *mem;
 	int i;
 
 	/* Invalid if multiple bits are set, or block not found */
@@ -529,50 +937,62 @@ uiomux_free(struct uiomux *uiomux, uiomux_resource_t blockmask,
 #endif
 		uio_free(uio, address, size);
 
-		pthread_mutex_lock(&mutex);
-		mem = find_mem_block(&g_mem_regions, address);
-		if (mem) {
-			rm_mem_block(&g_mem_regions, mem);
-			free(mem);
-		}
-		pthread_mutex_unlock(&mutex);
+		pthread_mutex_lock(&region_mutex);
+		uio_region_remove(&g_mem_regions, (unsigned long)address,
+				  NULL);
+		pthread_mutex_unlock(&region_mutex);
 	}
 }
 
 int
 uiomux_register (void *virt, unsigned long phys, size_t size)
 {
-	struct uiomux_addr_block *mem;
+	int ret;
 
 #ifdef DEBUG
 	fprintf(stderr, "%s: phys addr 0x%lX, virt addr %p\n", __func__, phys, virt);
 #endif
 
-	mem = malloc(sizeof(*mem));
-	if (!mem)
-		return 1;
-	mem->virt = virt;
-	mem->phys = phys;
-	mem->size = size;
-	pthread_mutex_lock(&mutex);
-	add_mem_block(&g_mem_regions, mem);
-	pthread_mutex_unlock(&mutex);
-	return 0;
+	pthread_mutex_lock(&region_mutex);
+	ret = uio_region_add(&g_mem_regions, virt, phys, size);
+	if (ret == 0 &&
+	    (ret = uio_region_add(&g_phys_regions, virt, phys, size)) < 0)
+		uio_region_remove(&g_mem_regions, (unsigned long)virt, NULL);
+	pthread_mutex_unlock(&region_mutex);
+	return (ret < 0);
 }
 
 int
 uiomux_unregister (void *virt)
 {
-	struct uiomux_addr_block *mem;
+	struct uio_region region;
+	int ret;
+
+	pthread_mutex_lock(&region_mutex);
+	ret = uio_region_remove(&g_mem_regions, (unsigned long)virt, &region);
+	if (ret == 0)
+		uio_region_remove_entry(&g_phys_regions, &region);
+	pthread_mutex_unlock(&region_mutex);
+	return (ret < 0);
+}
 
-	pthread_mutex_lock(&mutex);
-	mem = find_mem_block(&g_mem_regions, virt);
-	if (mem) {
-		rm_mem_block(&g_mem_regions, mem);
-		free(mem);
-	}
-	pthread_mutex_unlock(&mutex);
-	return (mem == NULL);
+/* Unregister exactly the region given, where regions may overlap */
+int
+uiomux_unregister_region(void *virt, unsigned long phys, size_t size)
+{
+	struct uio_region region;
+	int ret;
+
+	region.virt = virt;
+	region.phys = phys;
+	region.size = size;
+
+	pthread_mutex_lock(&region_mutex);
+	ret = uio_region_remove_entry(&g_mem_regions, &region);
+	if (ret == 0)
+		uio_region_remove_entry(&g_phys_regions, &region);
+	pthread_mutex_unlock(&region_mutex);
+	return (ret < 0);
 }
 
 unsigned long
@@ -629,6 +1049,100 @@ uiomux_get_mem(struct uiomux *uiomux, uiomux_resource_t blockmask,
 	return uio->mem.address;
 }
 
+static int
+uio_map_desc(struct uiomux *uiomux, uiomux_resource_t blockmask,
+	     int mmio, struct uiomux_map_desc *desc)
+{
+	struct uio *uio;
+	struct uio_map *map;
+	int i;
+
+	/* Invalid if multiple bits are set, or block not found */
+	if ((i = uiomux_get_block_index(uiomux, blockmask)) == -1)
+		return -1;
+
+	uio = uiomux->uios[i];
+
+	/* Invalid if no uio associated with it */
+	if (uio == NULL)
+		return -1;
+
+	map = mmio ? &uio->mmio : &uio->mem;
+	desc->virt = map->iomem;
+	desc->phys = map->address;
+	desc->size = map->size;
+
+	return 0;
+}
+
+int
+uiomux_get_mmio_desc(struct uiomux *uiomux, uiomux_resource_t blockmask,
+		     struct uiomux_map_desc *desc)
+{
+	return uio_map_desc(uiomux, blockmask, 1, desc);
+}
+
+int
+uiomux_get_mem_desc(struct uiomux *uiomux, uiomux_resource_t blockmask,
+		    struct uiomux_map_desc *desc)
+{
+	return uio_map_desc(uiomux, blockmask, 0, desc);
+}
+
+int
+uiomux_apply_cmds(struct uiomux *uiomux, uiomux_resource_t blockmask,
+		  const struct uiomux_reg_cmd *cmds, int count)
+{
+	struct uio_map *mmio;
+	volatile uint32_t *reg;
+	uint32_t value;
+	int i, traced;
+
+	/* Invalid if multiple bits are set, or block not found */
+	if ((i = uiomux_get_block_index(uiomux, blockmask)) == -1 ||
+	    uiomux->uios[i] == NULL) {
+		errno = EINVAL;
+		return -1;
+	}
+
+	if (!(uiomux->locked_resources & blockmask)) {
+		errno = EPERM;
+		return -1;
+	}
+
+	mmio = &uiomux->uios[i]->mmio;
+
+	/* Check the whole list first, so that it is applied all or nothing */
+	for (i = 0; i < count; i++) {
+		if ((cmds[i].offset & 3) || cmds[i].offset >= mmio->size ||
+		    mmio->size - cmds[i].offset < 4) {
+			errno = EINVAL;
+			return -1;
+		}
+	}
+
+	traced = uiomux_trace_active;
+
+	__sync_synchronize();
+
+	for (i = 0; i < count; i++) {
+		reg = (volatile uint32_t *)((char *)mmio->iomem +
+					    cmds[i].offset);
+		value = cmds[i].value;
+		if (cmds[i].mask != UIOMUX_REG_ALL)
+			value = (*reg & ~cmds[i].mask) | (value & cmds[i].mask);
+		*reg = value;
+
+		if (traced)
+			uiomux_trace_log(mmio->address + cmds[i].offset,
+					 value, UIOMUX_TRACE_WRITE);
+	}
+
+	__sync_synchronize();
+
+	return 0;
+}
+
 static unsigned long
 uio_map_virt_to_phys(struct uio_map *map, void *virt_address)
 {
@@ -686,14 +1200,12 @@ uiomux_virt_to_phys(struct uiomux *uiomux, uiomux_resource_t blockmask,
 unsigned long
 uiomux_all_virt_to_phys(void *virt)
 {
-	struct uiomux_addr_block *mem;
+	const struct uio_region *mem;
 	unsigned long phys = 0;
 
-	pthread_mutex_lock(&mutex);
-	mem = find_mem_block(&g_mem_regions, virt);
+	mem = uio_region_find(&g_mem_regions, (unsigned long)virt);
 	if (mem)
-		phys = mem->phys + (virt - mem->virt);
-	pthread_mutex_unlock(&mutex);
+		phys = mem->phys + ((char *)virt - (char *)mem->virt);
 
 #ifdef DEBUG
 	fprintf(stderr, "%s: got phys addr 0x%X, virt addr %p\n", __func__, phys, virt);
@@ -702,6 +1214,26 @@ uiomux_all_virt_to_phys(void *virt)
 	return phys;
 }
 
+void *
+uiomux_all_phys_to_virt(unsigned long phys)
+{
+	const struct uio_region *mem;
+
+	mem = uio_region_find(&g_phys_regions, phys);
+	if (mem == NULL)
+		return NULL;
+
+	return (char *)mem->virt + (phys - mem->phys);
+}
+
+int
+uiomux_all_virt_to_phys_sg(const struct uiomux_iovec *iov, int iovcnt,
+			   struct uiomux_segment *segs, int max_segs)
+{
+	return uio_region_translate(&g_mem_regions, iov, iovcnt,
+				    segs, max_segs);
+}
+
 
 void *
 uiomux_phys_to_virt(struct uiomux *uiomux, uiomux_resource_t blockmask,
@@ -837,6 +1369,264 @@ int uiomux_meminfo(struct uiomux *uiomux)
 	return 0;
 }
 
+static void print_holder(pid_t pid, pid_t tid)
+{
+	char fname[64], cmdline[64];
+	FILE *fp;
+	size_t n = 0;
+
+	snprintf(fname, sizeof(fname), "/proc/%d/cmdline", pid);
+	if ((fp = fopen(fname, "r")) != NULL) {
+		n = fread(cmdline, 1, sizeof(cmdline) - 1, fp);
+		fclose(fp);
+	}
+	cmdline[n] = '\0';
+
+	if (n > 0)
+		printf("pid %d tid %d %s", pid, tid, cmdline);
+	else
+		printf("pid %d tid %d (exited)", pid, tid);
+}
+
+int uiomux_get_lockstat(struct uiomux *uiomux, uiomux_resource_t blockmask,
+			struct uiomux_lockstat *stat)
+{
+	struct uio_shm_device *dev;
+	uint64_t now, acquired;
+	int i;
+
+	/* Invalid if multiple bits are set, or block not found */
+	if ((i = uiomux_get_block_index(uiomux, blockmask)) == -1)
+		return -1;
+
+	if (uiomux->uios[i] == NULL || (dev = uiomux->uios[i]->shm) == NULL)
+		return -1;
+
+	memset(stat, 0, sizeof(*stat));
+
+	stat->holder_pid = dev->holder_pid;
+	stat->holder_tid = dev->holder_tid;
+	acquired = dev->acquired;
+	now = uio_time_ns();
+	if (stat->holder_pid && now > acquired)
+		stat->held_us = (now - acquired) / 1000;
+	stat->waiters = dev->waiters;
+
+	stat->lock_count = dev->lock_count;
+	if (stat->lock_count) {
+		stat->hold_avg_us = dev->hold_total / stat->lock_count / 1000;
+		stat->wait_avg_us = dev->wait_total / stat->lock_count / 1000;
+	}
+	stat->hold_max_us = dev->hold_max / 1000;
+	stat->wait_max_us = dev->wait_max / 1000;
+	stat->watchdog_trips = dev->watchdog_trips;
+
+	return 0;
+}
+
+int uiomux_get_irqstat(struct uiomux *uiomux, uiomux_resource_t blockmask,
+		       struct uiomux_irqstat *stat)
+{
+	struct uio_shm_device *dev;
+	int i, k;
+
+	/* Invalid if multiple bits are set, or block not found */
+	if ((i = uiomux_get_block_index(uiomux, blockmask)) == -1)
+		return -1;
+
+	if (uiomux->uios[i] == NULL || (dev = uiomux->uios[i]->shm) == NULL)
+		return -1;
+
+	memset(stat, 0, sizeof(*stat));
+
+	stat->count = dev->irq_count;
+	stat->coalesced = dev->irq_coalesced;
+	stat->waits = dev->irq_waits;
+	if (stat->waits)
+		stat->latency_avg_us = dev->irq_latency_total / stat->waits / 1000;
+	stat->latency_max_us = dev->irq_latency_max / 1000;
+	for (k = 0; k < UIOMUX_IRQ_HIST_BUCKETS && k < UIO_SHM_IRQ_BUCKETS; k++)
+		stat->hist[k] = dev->irq_hist[k];
+
+	return 0;
+}
+
+int uiomux_get_extents(struct uiomux *uiomux, uiomux_resource_t blockmask,
+		       struct uiomux_extent *extents, int max,
+		       unsigned long *untracked)
+{
+	struct uio_shm_extent *table;
+	struct uio *uio;
+	long pagesize;
+	int i, n;
+
+	/* Invalid if multiple bits are set, or block not found */
+	if ((i = uiomux_get_block_index(uiomux, blockmask)) == -1)
+		return -1;
+
+	if ((uio = uiomux->uios[i]) == NULL || uio->shm == NULL)
+		return -1;
+
+	table = malloc(UIO_SHM_EXTENTS * sizeof(*table));
+	if (table == NULL)
+		return -1;
+
+	pagesize = sysconf(_SC_PAGESIZE);
+
+	n = uio_shm_extents(uio->shm, table);
+	for (i = 0; i < n && i < max; i++) {
+		extents[i].address = uio->mem.address +
+			table[i].start * pagesize;
+		extents[i].size = table[i].count * pagesize;
+		extents[i].pid = table[i].pid;
+		extents[i].tid = table[i].tid;
+		extents[i].flags = table[i].flags;
+	}
+
+	if (untracked)
+		*untracked = uio->shm->extents_untracked;
+
+	free(table);
+
+	return n;
+}
+
+static void memstat_copy(struct uiomux_memstat *stat, pid_t pid,
+			 struct uio_shm_memstat *m)
+{
+	stat->pid = pid;
+	stat->live_bytes = m->live;
+	stat->peak_bytes = m->peak;
+	stat->allocs = m->allocs;
+	stat->frees = m->frees;
+	stat->failed = m->failed;
+}
+
+static struct uio_shm_device *
+uiomux_get_shm(struct uiomux *uiomux, uiomux_resource_t blockmask)
+{
+	int i;
+
+	/* Invalid if multiple bits are set, or block not found */
+	if ((i = uiomux_get_block_index(uiomux, blockmask)) == -1)
+		return NULL;
+
+	if (uiomux->uios[i] == NULL)
+		return NULL;
+
+	return uiomux->uios[i]->shm;
+}
+
+int uiomux_get_memstat(struct uiomux *uiomux, uiomux_resource_t blockmask,
+		       struct uiomux_memstat *stat)
+{
+	struct uio_shm_device *dev;
+
+	if ((dev = uiomux_get_shm(uiomux, blockmask)) == NULL)
+		return -1;
+
+	/* Return the memory of processes which died to the total first */
+	uio_shm_mem_procs(dev, NULL, NULL, 0);
+	memstat_copy(stat, 0, &dev->mem);
+
+	return 0;
+}
+
+static int memstat_cmp(const void *a, const void *b)
+{
+	const struct uiomux_memstat *ma = a, *mb = b;
+
+	if (ma->live_bytes != mb->live_bytes)
+		return ma->live_bytes > mb->live_bytes ? -1 : 1;
+	return ma->pid - mb->pid;
+}
+
+int uiomux_get_proc_memstat(struct uiomux *uiomux, uiomux_resource_t blockmask,
+			    struct uiomux_memstat *stats, int max)
+{
+	struct uio_shm_device *dev;
+	struct uio_shm_memstat *m;
+	struct uiomux_memstat *all;
+	pid_t *pids;
+	int i, n = -1;
+
+	if ((dev = uiomux_get_shm(uiomux, blockmask)) == NULL)
+		return -1;
+
+	pids = malloc(UIO_SHM_PROCS * sizeof(*pids));
+	m = malloc(UIO_SHM_PROCS * sizeof(*m));
+	all = malloc(UIO_SHM_PROCS * sizeof(*all));
+	if (pids == NULL || m == NULL || all == NULL)
+		goto out;
+
+	/* Sort all of them, so that the largest users come first */
+	n = uio_shm_mem_procs(dev, pids, m, UIO_SHM_PROCS);
+	for (i = 0; i < n; i++)
+		memstat_copy(&all[i], pids[i], &m[i]);
+	qsort(all, n, sizeof(*all), memstat_cmp);
+
+	for (i = 0; i < n && i < max; i++)
+		stats[i] = all[i];
+
+out:
+	free(all);
+	free(m);
+	free(pids);
+
+	return n;
+}
+
+int uiomux_reset_mem_peak(struct uiomux *uiomux, uiomux_resource_t blockmask)
+{
+	struct uio_shm_device *dev;
+
+	if ((dev = uiomux_get_shm(uiomux, blockmask)) == NULL)
+		return -1;
+
+	uio_shm_mem_reset_peak(dev);
+
+	return 0;
+}
+
+int uiomux_holders(struct uiomux *uiomux)
+{
+	struct uiomux_lockstat stat;
+	struct uio *uio;
+	int i;
+
+	uiomux_showversion(uiomux);
+
+	for (i = 0; i < UIOMUX_BLOCK_MAX; i++) {
+		uio = uiomux->uios[i];
+		if (uio == NULL)
+			continue;
+
+		printf("%s: %s", uio->dev.path, uio->dev.name);
+
+		if (uiomux_get_lockstat(uiomux, 1 << i, &stat) < 0) {
+			printf("\tshared state not available\n");
+			continue;
+		}
+
+		printf("\t");
+		if (stat.holder_pid) {
+			print_holder(stat.holder_pid, stat.holder_tid);
+			printf(", held %lu.%03lu ms\n",
+			       stat.held_us / 1000, stat.held_us % 1000);
+		} else {
+			printf("unlocked\n");
+		}
+		printf("\t%u waiting, %lu locks, hold avg/max %lu/%lu us, "
+		       "wait avg/max %lu/%lu us, %lu watchdog trips\n",
+		       stat.waiters, stat.lock_count,
+		       stat.hold_avg_us, stat.hold_max_us,
+		       stat.wait_avg_us, stat.wait_max_us,
+		       stat.watchdog_trips);
+	}
+
+	return 0;
+}
+
 int uiomux_list_device(char ***names, int *count)
 {
 	return uio_list_device(names, count);
@@ -32,7 +32,10 @@
  * Library-private defines
  */
 
-#define UIOMUX_BLOCK_MAX 	UIO_DEVICE_MAX
+/* UIOMUX_BLOCK_MAX is public, in resource.h */
+#if UIOMUX_BLOCK_MAX != UIO_DEVICE_MAX
+#error "UIOMUX_BLOCK_MAX and UIO_DEVICE_MAX differ"
+#endif
 
 /***********************************************************
  * Library-private Types
@@ -42,14 +45,22 @@ struct uiomux {
   /* Locked resources */
   uiomux_resource_t locked_resources;
 
+  /* UIOMUX_OPEN_* flags given at open time */
+  int flags;
+
   struct uio * uios[UIOMUX_BLOCK_MAX];
-};
 
-struct uiomux_addr_block {
-	void *virt;
-	unsigned long phys;
-	size_t size;
-	struct uiomux_addr_block *next;
+  /* Lock hold-time watchdog, if enabled */
+  struct uiomux_watchdog * watchdog;
+
+  /* Status register sampler, if started */
+  struct uiomux_sampler * sampler;
+
+  /* Completion dispatcher, if started */
+  struct uiomux_dispatch * dispatch;
+
+  /* io_uring engine, or NULL to wait with ppoll() */
+  struct uio_uring * uring;
 };
 
 /***********************************************************
@@ -62,4 +73,19 @@ uiomux_close (struct uiomux * uiomux);
 const char *
 uiomux_name(uiomux_resource_t resource);
 
+int
+uiomux_watchdog_stop (struct uiomux * uiomux);
+
+int
+uiomux_watchdog_self (struct uiomux * uiomux);
+
+int
+uiomux_dispatch_self (struct uiomux * uiomux);
+
+void
+uiomux_sampler_stop (struct uiomux * uiomux);
+
+int
+uiomux_unregister_region (void * virt, unsigned long phys, size_t size);
+
 #endif /* __UIOMUX_PRIVATE_H__ */
@@ -0,0 +1,695 @@
+/*
+ * UIOMux: a conflict manager for system resources, including UIO devices.
+ * Copyright (C) 2009 Renesas Technology Corp.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston MA  02110-1301 USA
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <poll.h>
+#include <sys/eventfd.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+
+#include "uio.h"
+#include "shm.h"
+#include "uring.h"
+
+#ifdef HAVE_IO_URING
+#include <linux/io_uring.h>
+#endif
+
+/* #define DEBUG */
+
+#ifdef HAVE_IO_URING
+
+/* Enough for an interrupt poll per device, the wakeup poll and all
+   buffer I/O in flight */
+#define URING_ENTRIES		64
+
+/* user_data of a request: its kind in the upper half, its slot below */
+#define URING_IRQ		1ULL
+#define URING_WAKE		2ULL
+#define URING_IO		3ULL
+#define URING_CANCEL		4ULL
+#define URING_DATA(kind, i)	(((kind) << 32) | (i))
+
+/* Time allowed for outstanding requests to finish when freeing a ring */
+#define URING_DRAIN_MS		1000
+
+/* States of a buffer I/O slot */
+#define URING_IO_FREE		0
+#define URING_IO_INFLIGHT	1
+#define URING_IO_DONE		2	/* on the done list */
+
+struct uio_uring_slot {
+	struct uio *uio;
+	int irq_armed;		/* poll for an interrupt submitted */
+	int fired;		/* interrupt seen, not yet consumed */
+	int failed;		/* poll reported an error on the device */
+	uint64_t enabled;	/* ns; when the interrupt was last enabled */
+};
+
+struct uio_uring {
+	int fd;
+
+	pthread_mutex_t lock;
+	pthread_cond_t cond;
+	int leader;		/* a thread is blocked in io_uring_enter() */
+
+	/* Written to get the leader out of io_uring_enter() when a waiter
+	   is woken up */
+	int wake_efd;
+	int wake_armed;
+
+	int draining;		/* cancelling everything to free the ring */
+
+	/* Submission queue */
+	unsigned *sq_head, *sq_tail, *sq_mask, *sq_array;
+	struct io_uring_sqe *sqes;
+	unsigned to_submit;
+
+	/* Completion queue */
+	unsigned *cq_head, *cq_tail, *cq_mask;
+	struct io_uring_cqe *cqes;
+
+	void *sq_ring, *cq_ring;
+	size_t sq_ring_size, cq_ring_size, sqes_size;
+
+	struct uio_uring_slot slots[UIO_DEVICE_MAX];
+	int n_slots;
+
+	/* Buffer reads and writes in flight, and completed. A slot stays
+	   busy until its completion is handed to the caller, so the done
+	   list can never hold more than UIO_URING_IO_MAX entries. */
+	void *io_user_data[UIO_URING_IO_MAX];
+	int io_busy[UIO_URING_IO_MAX];
+	struct uio_io done[UIO_URING_IO_MAX];
+	int done_slot[UIO_URING_IO_MAX];
+	int n_done;
+};
+
+static int uring_setup(unsigned entries, struct io_uring_params *p)
+{
+	return syscall(__NR_io_uring_setup, entries, p);
+}
+
+static int uring_enter(int fd, unsigned to_submit, unsigned min_complete,
+		       unsigned flags, const void *arg, size_t argsz)
+{
+	return syscall(__NR_io_uring_enter, fd, to_submit, min_complete,
+		       flags, arg, argsz);
+}
+
+/* Get a submission queue entry, to be submitted by the next uring_enter().
+   Called with ring->lock held. */
+static struct io_uring_sqe *uring_get_sqe(struct uio_uring *ring)
+{
+	struct io_uring_sqe *sqe;
+	unsigned tail, index;
+
+	tail = *ring->sq_tail;
+	if (tail - *(volatile unsigned *)ring->sq_head > *ring->sq_mask)
+		return NULL;
+
+	index = tail & *ring->sq_mask;
+	sqe = &ring->sqes[index];
+	memset(sqe, 0, sizeof(*sqe));
+	ring->sq_array[index] = index;
+
+	/* The kernel must see the entry before the new tail */
+	__sync_synchronize();
+	*ring->sq_tail = tail + 1;
+	ring->to_submit++;
+
+	return sqe;
+}
+
+/* Submit queued entries without waiting. Called with ring->lock held. */
+static int uring_submit(struct uio_uring *ring)
+{
+	int ret;
+
+	while (ring->to_submit > 0) {
+		ret = uring_enter(ring->fd, ring->to_submit, 0, 0, NULL, 0);
+		if (ret < 0) {
+			if (errno == EINTR)
+				continue;
+			return ret;
+		}
+		ring->to_submit -= ret;
+	}
+
+	return 0;
+}
+
+static int uring_poll(struct uio_uring *ring, int fd, uint64_t data)
+{
+	struct io_uring_sqe *sqe;
+
+	if ((sqe = uring_get_sqe(ring)) == NULL)
+		return -1;
+
+	sqe->opcode = IORING_OP_POLL_ADD;
+	sqe->fd = fd;
+	sqe->poll_events = POLLIN;
+	sqe->user_data = data;
+
+	return 0;
+}
+
+/* Move completions into the slots and the done list. Called with
+   ring->lock held. */
+static void uring_reap(struct uio_uring *ring)
+{
+	struct io_uring_cqe *cqe;
+	struct uio_uring_slot *slot;
+	unsigned head, i;
+	eventfd_t value;
+
+	head = *ring->cq_head;
+	while (head != *(volatile unsigned *)ring->cq_tail) {
+		/* Read the entry only after seeing the tail that published it */
+		__sync_synchronize();
+		cqe = &ring->cqes[head & *ring->cq_mask];
+		i = cqe->user_data & 0xffffffff;
+
+		switch (cqe->user_data >> 32) {
+		case URING_IRQ:
+			slot = &ring->slots[i];
+			slot->irq_armed = 0;
+			if (cqe->res < 0 ||
+			    (cqe->res & (POLLERR | POLLHUP | POLLNVAL)))
+				slot->failed = 1;
+			else if (cqe->res > 0)
+				slot->fired = 1;
+			break;
+		case URING_WAKE:
+			/* Waiters check their own eventfds after each reap */
+			ring->wake_armed = 0;
+			eventfd_read(ring->wake_efd, &value);
+			break;
+		case URING_IO:
+			ring->done[ring->n_done].user_data =
+				ring->io_user_data[i];
+			ring->done[ring->n_done].result = cqe->res;
+			ring->done_slot[ring->n_done] = i;
+			ring->n_done++;
+			ring->io_busy[i] = URING_IO_DONE;
+			break;
+		default:
+			break;
+		}
+
+		head++;
+	}
+
+	/* Finish reading the entries before handing them back */
+	__sync_synchronize();
+	*ring->cq_head = head;
+}
+
+/* Block until a completion arrives or the deadline passes. Called with
+   ring->lock held; the lock is dropped while blocked so that other threads
+   can submit. Only one thread blocks in the kernel at a time, the others
+   wait on the condition variable for it to reap. */
+static int uring_block(struct uio_uring *ring, const struct timespec *deadline)
+{
+	struct io_uring_getevents_arg arg;
+	struct __kernel_timespec ts;
+	struct timespec remaining;
+	unsigned to_submit;
+	int ret;
+
+	if (!ring->wake_armed && !ring->draining &&
+	    uring_poll(ring, ring->wake_efd, URING_DATA(URING_WAKE, 0)) == 0)
+		ring->wake_armed = 1;
+
+	if (ring->leader) {
+		/* Polls submitted now wake the leader when they complete */
+		if (uring_submit(ring) < 0)
+			return -1;
+		if (deadline == NULL)
+			return pthread_cond_wait(&ring->cond, &ring->lock);
+		return pthread_cond_timedwait(&ring->cond, &ring->lock,
+					      deadline);
+	}
+
+	memset(&arg, 0, sizeof(arg));
+	if (uio_deadline_remaining(deadline, &remaining)) {
+		ts.tv_sec = remaining.tv_sec;
+		ts.tv_nsec = remaining.tv_nsec;
+		arg.ts = (uint64_t)(uintptr_t)&ts;
+	}
+
+	to_submit = ring->to_submit;
+	ring->to_submit = 0;
+	ring->leader = 1;
+	pthread_mutex_unlock(&ring->lock);
+
+	ret = uring_enter(ring->fd, to_submit, 1,
+			  IORING_ENTER_GETEVENTS | IORING_ENTER_EXT_ARG,
+			  &arg, sizeof(arg));
+
+	pthread_mutex_lock(&ring->lock);
+	ring->leader = 0;
+	/* Nothing was submitted if the wait failed */
+	if (ret < 0)
+		ring->to_submit += to_submit;
+	else if ((unsigned)ret < to_submit)
+		ring->to_submit += to_submit - ret;
+	uring_reap(ring);
+	pthread_cond_broadcast(&ring->cond);
+
+	return (ret < 0 && errno != ETIME && errno != EINTR) ? -1 : 0;
+}
+
+static int deadline_passed(const struct timespec *deadline)
+{
+	struct timespec remaining;
+
+	if (deadline == NULL)
+		return 0;
+
+	uio_deadline_remaining(deadline, &remaining);
+	return remaining.tv_sec == 0 && remaining.tv_nsec == 0;
+}
+
+struct uio_uring *uio_uring_new(void)
+{
+	struct uio_uring *ring;
+	struct io_uring_params p;
+	pthread_condattr_t attr;
+
+	ring = (struct uio_uring *)calloc(1, sizeof(*ring));
+	if (ring == NULL)
+		return NULL;
+
+	ring->wake_efd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+	if (ring->wake_efd < 0)
+		goto err_free;
+
+	memset(&p, 0, sizeof(p));
+	ring->fd = uring_setup(URING_ENTRIES, &p);
+	if (ring->fd < 0)
+		goto err_efd;
+
+	/* Waits with a timeout need IORING_ENTER_EXT_ARG (Linux 5.11) */
+	if (!(p.features & IORING_FEAT_EXT_ARG)) {
+		errno = ENOSYS;
+		goto err_close;
+	}
+
+	ring->sq_ring_size = p.sq_off.array + p.sq_entries * sizeof(unsigned);
+	ring->cq_ring_size = p.cq_off.cqes +
+		p.cq_entries * sizeof(struct io_uring_cqe);
+	ring->sqes_size = p.sq_entries * sizeof(struct io_uring_sqe);
+
+	ring->sq_ring = mmap(NULL, ring->sq_ring_size, PROT_READ | PROT_WRITE,
+			     MAP_SHARED | MAP_POPULATE, ring->fd,
+			     IORING_OFF_SQ_RING);
+	if (ring->sq_ring == MAP_FAILED)
+		goto err_close;
+
+	ring->cq_ring = mmap(NULL, ring->cq_ring_size, PROT_READ | PROT_WRITE,
+			     MAP_SHARED | MAP_POPULATE, ring->fd,
+			     IORING_OFF_CQ_RING);
+	if (ring->cq_ring == MAP_FAILED)
+		goto err_sq;
+
+	ring->sqes = (struct io_uring_sqe *)
+		mmap(NULL, ring->sqes_size, PROT_READ | PROT_WRITE,
+		     MAP_SHARED | MAP_POPULATE, ring->fd, IORING_OFF_SQES);
+	if (ring->sqes == MAP_FAILED)
+		goto err_cq;
+
+	ring->sq_head = (unsigned *)((char *)ring->sq_ring + p.sq_off.head);
+	ring->sq_tail = (unsigned *)((char *)ring->sq_ring + p.sq_off.tail);
+	ring->sq_mask = (unsigned *)((char *)ring->sq_ring + p.sq_off.ring_mask);
+	ring->sq_array = (unsigned *)((char *)ring->sq_ring + p.sq_off.array);
+	ring->cq_head = (unsigned *)((char *)ring->cq_ring + p.cq_off.head);
+	ring->cq_tail = (unsigned *)((char *)ring->cq_ring + p.cq_off.tail);
+	ring->cq_mask = (unsigned *)((char *)ring->cq_ring + p.cq_off.ring_mask);
+	ring->cqes = (struct io_uring_cqe *)
+		((char *)ring->cq_ring + p.cq_off.cqes);
+
+	pthread_mutex_init(&ring->lock, NULL);
+	pthread_condattr_init(&attr);
+	pthread_condattr_setclock(&attr, CLOCK_MONOTONIC);
+	pthread_cond_init(&ring->cond, &attr);
+	pthread_condattr_destroy(&attr);
+
+	return ring;
+
+err_cq:
+	munmap(ring->cq_ring, ring->cq_ring_size);
+err_sq:
+	munmap(ring->sq_ring, ring->sq_ring_size);
+err_close:
+	{
+		int save_errno = errno;
+		close(ring->fd);
+		errno = save_errno;
+	}
+err_efd:
+	{
+		int save_errno = errno;
+		close(ring->wake_efd);
+		errno = save_errno;
+	}
+err_free:
+	free(ring);
+	return NULL;
+}
+
+static int uring_busy(struct uio_uring *ring)
+{
+	int i;
+
+	if (ring->wake_armed)
+		return 1;
+	for (i = 0; i < ring->n_slots; i++) {
+		if (ring->slots[i].irq_armed)
+			return 1;
+	}
+	for (i = 0; i < UIO_URING_IO_MAX; i++) {
+		if (ring->io_busy[i] == URING_IO_INFLIGHT)
+			return 1;
+	}
+
+	return 0;
+}
+
+static void uring_cancel(struct uio_uring *ring, int opcode, uint64_t data)
+{
+	struct io_uring_sqe *sqe;
+
+	if ((sqe = uring_get_sqe(ring)) == NULL)
+		return;
+
+	sqe->opcode = opcode;
+	sqe->addr = data;
+	sqe->user_data = URING_DATA(URING_CANCEL, 0);
+}
+
+void uio_uring_free(struct uio_uring *ring)
+{
+	struct timespec deadline;
+	int i;
+
+	if (ring == NULL)
+		return;
+
+	pthread_mutex_lock(&ring->lock);
+
+	/* Buffers written by the kernel must outlive its requests */
+	for (i = 0; i < ring->n_slots; i++) {
+		if (ring->slots[i].irq_armed)
+			uring_cancel(ring, IORING_OP_POLL_REMOVE,
+				     URING_DATA(URING_IRQ, i));
+	}
+	if (ring->wake_armed)
+		uring_cancel(ring, IORING_OP_POLL_REMOVE,
+			     URING_DATA(URING_WAKE, 0));
+	for (i = 0; i < UIO_URING_IO_MAX; i++) {
+		if (ring->io_busy[i] == URING_IO_INFLIGHT)
+			uring_cancel(ring, IORING_OP_ASYNC_CANCEL,
+				     URING_DATA(URING_IO, i));
+	}
+
+	clock_gettime(CLOCK_MONOTONIC, &deadline);
+	deadline.tv_sec += URING_DRAIN_MS / 1000;
+	ring->draining = 1;
+	while (uring_busy(ring) && !deadline_passed(&deadline)) {
+		if (uring_block(ring, &deadline) < 0)
+			break;
+	}
+
+	for (i = 0; i < ring->n_slots; i++)
+		ring->slots[i].uio->uring = NULL;
+
+	pthread_mutex_unlock(&ring->lock);
+
+	pthread_cond_destroy(&ring->cond);
+	pthread_mutex_destroy(&ring->lock);
+	munmap(ring->sqes, ring->sqes_size);
+	munmap(ring->cq_ring, ring->cq_ring_size);
+	munmap(ring->sq_ring, ring->sq_ring_size);
+	close(ring->fd);
+	close(ring->wake_efd);
+	free(ring);
+}
+
+/* Get the thread blocked in io_uring_enter() to reap, so that a waiter
+   woken through its eventfd notices */
+void uio_uring_kick(struct uio_uring *ring)
+{
+	eventfd_write(ring->wake_efd, 1);
+}
+
+int uio_uring_attach(struct uio_uring *ring, struct uio *uio)
+{
+	if (ring->n_slots == UIO_DEVICE_MAX)
+		return -1;
+
+	ring->slots[ring->n_slots].uio = uio;
+	uio->uring_slot = ring->n_slots++;
+	uio->uring = ring;
+
+	return 0;
+}
+
+/* Wait for an interrupt on any of n devices, or for buffer I/O to complete
+   if max_io is non-zero, until the CLOCK_MONOTONIC deadline. Interrupts and
+   wakeups that arrive while nobody waits for their device are kept until
+   the next wait, as with uio_sleep_any(). Returns 0 and sets *fired and
+   *n_io if anything completed; returns -1 on timeout, wakeup or error. */
+int uio_uring_wait(struct uio_uring *ring, struct uio **uios, int n,
+		   const struct timespec *deadline, int *fired,
+		   struct uio_io *io, int max_io, int *n_io)
+{
+	struct uio_waiter waiters[UIO_DEVICE_MAX];
+	struct uio_uring_slot *slot;
+	struct uio_thread *t;
+	unsigned long count;
+	uint64_t woken;
+	int ret, k, entered = 0, pending = 0, save_errno;
+
+	if ((t = uio_thread_self()) == NULL)
+		return -1;
+
+	for (k = 0; k < n; k++) {
+		ret = uio_irq_enable(uios[k]);
+		if (ret < 0)
+			return ret;
+	}
+
+	/* Wakeups of this thread must now also kick the ring */
+	t->ring = ring;
+	__sync_synchronize();
+
+	for (k = 0; k < n; k++)
+		pending |= uio_wait_begin(uios[k], &waiters[k], t);
+
+	pthread_mutex_lock(&ring->lock);
+
+	for (k = 0; k < n; k++)
+		ring->slots[uios[k]->uring_slot].enabled = uio_time_ns();
+
+	for (;;) {
+		uring_reap(ring);
+
+		if (pending || uio_thread_woken(t)) {
+			errno = EINTR;
+			ret = -1;
+			goto out;
+		}
+
+		*fired = 0;
+		woken = uio_time_ns();
+		for (k = 0; k < n; k++) {
+			slot = &ring->slots[uios[k]->uring_slot];
+
+			/* Polling again would fail at once, forever */
+			if (slot->failed) {
+				slot->failed = 0;
+				errno = EIO;
+				ret = -1;
+				goto out;
+			}
+			if (!slot->fired)
+				continue;
+
+			/* The count may have been read by uiomux_irq_ack()
+			   since the poll completed; enable the interrupt
+			   again before polling for it */
+			slot->fired = 0;
+			if (uio_read_nonblocking(uios[k], &count) < 0) {
+				if (uio_irq_enable(uios[k]) == 0)
+					slot->enabled = uio_time_ns();
+				continue;
+			}
+			uio_shm_irq(uios[k]->shm, count, slot->enabled, woken);
+			*fired |= 1 << k;
+		}
+
+		if (n_io) {
+			*n_io = (ring->n_done < max_io) ? ring->n_done : max_io;
+			memcpy(io, ring->done, *n_io * sizeof(*io));
+			for (k = 0; k < *n_io; k++)
+				ring->io_busy[ring->done_slot[k]] = URING_IO_FREE;
+			ring->n_done -= *n_io;
+			memmove(ring->done, &ring->done[*n_io],
+				ring->n_done * sizeof(*io));
+			memmove(ring->done_slot, &ring->done_slot[*n_io],
+				ring->n_done * sizeof(*ring->done_slot));
+		}
+
+		if (*fired || (n_io && *n_io)) {
+			ret = 0;
+			goto out;
+		}
+
+		/* An expired deadline still checks interrupt status once */
+		if (entered && deadline_passed(deadline)) {
+			errno = ETIMEDOUT;
+			ret = -1;
+			goto out;
+		}
+
+		for (k = 0; k < n; k++) {
+			slot = &ring->slots[uios[k]->uring_slot];
+			if (!slot->irq_armed &&
+			    uring_poll(ring, uios[k]->dev.fd,
+				       URING_DATA(URING_IRQ, uios[k]->uring_slot)) == 0)
+				slot->irq_armed = 1;
+		}
+
+		if (uring_block(ring, deadline) < 0) {
+			ret = -1;
+			goto out;
+		}
+		entered = 1;
+	}
+
+out:
+	save_errno = errno;
+	pthread_mutex_unlock(&ring->lock);
+
+	for (k = 0; k < n; k++)
+		uio_wait_end(uios[k], &waiters[k]);
+	t->ring = NULL;
+
+	/* A wakeup that raced with a completion is absorbed by it, rather
+	   than ending the next sleep early */
+	uio_thread_woken(t);
+
+	errno = save_errno;
+	return ret;
+}
+
+/* Start a read or write of a buffer, to complete in uio_uring_wait() */
+int uio_uring_rw(struct uio_uring *ring, int write, int fd, void *buf,
+		 size_t count, off_t offset, void *user_data)
+{
+	struct io_uring_sqe *sqe;
+	int i, ret;
+
+	pthread_mutex_lock(&ring->lock);
+
+	for (i = 0; i < UIO_URING_IO_MAX; i++) {
+		if (!ring->io_busy[i])
+			break;
+	}
+	if (i == UIO_URING_IO_MAX || (sqe = uring_get_sqe(ring)) == NULL) {
+		pthread_mutex_unlock(&ring->lock);
+		errno = EAGAIN;
+		return -1;
+	}
+
+	sqe->opcode = write ? IORING_OP_WRITE : IORING_OP_READ;
+	sqe->fd = fd;
+	sqe->addr = (uint64_t)(uintptr_t)buf;
+	sqe->len = count;
+	sqe->off = offset;
+	sqe->user_data = URING_DATA(URING_IO, i);
+
+	ring->io_busy[i] = URING_IO_INFLIGHT;
+	ring->io_user_data[i] = user_data;
+
+	/* Start the transfer now rather than at the next wait. If the kernel
+	   did not take it, withdraw it: the caller is free to reuse the
+	   buffer after a failure. Entries are consumed in order and this one
+	   was queued last, so it is still at the tail. */
+	ret = uring_submit(ring);
+	if (ret < 0 && ring->to_submit > 0) {
+		(*ring->sq_tail)--;
+		ring->to_submit--;
+		ring->io_busy[i] = URING_IO_FREE;
+	} else {
+		ret = 0;
+	}
+
+	pthread_mutex_unlock(&ring->lock);
+
+	return ret;
+}
+
+#else /* !HAVE_IO_URING */
+
+struct uio_uring *uio_uring_new(void)
+{
+	errno = ENOSYS;
+	return NULL;
+}
+
+void uio_uring_free(struct uio_uring *ring)
+{
+}
+
+void uio_uring_kick(struct uio_uring *ring)
+{
+}
+
+int uio_uring_attach(struct uio_uring *ring, struct uio *uio)
+{
+	return -1;
+}
+
+int uio_uring_wait(struct uio_uring *ring, struct uio **uios, int n,
+		   const struct timespec *deadline, int *fired,
+		   struct uio_io *io, int max_io, int *n_io)
+{
+	errno = ENOSYS;
+	return -1;
+}
+
+int uio_uring_rw(struct uio_uring *ring, int write, int fd, void *buf,
+		 size_t count, off_t offset, void *user_data)
+{
+	errno = ENOSYS;
+	return -1;
+}
+
+#endif /* HAVE_IO_URING */
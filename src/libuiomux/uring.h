@@ -0,0 +1,60 @@
+/*
+ * UIOMux: a conflict manager for system resources, including UIO devices.
+ * Copyright (C) 2009 Renesas Technology Corp.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston MA  02110-1301 USA
+ */
+
+#ifndef __UIOMUX_URING_H__
+#define __UIOMUX_URING_H__
+
+#include <sys/types.h>
+#include <time.h>
+
+#include "uio.h"
+
+/* Maximum number of buffer reads and writes in flight on a ring */
+#define UIO_URING_IO_MAX	32
+
+struct uio_uring;
+
+/* A completed buffer read or write */
+struct uio_io {
+  void *user_data;
+  long result;		/* bytes transferred, or -errno */
+};
+
+struct uio_uring *
+uio_uring_new (void);
+
+void
+uio_uring_free (struct uio_uring * ring);
+
+void
+uio_uring_kick (struct uio_uring * ring);
+
+int
+uio_uring_attach (struct uio_uring * ring, struct uio * uio);
+
+int
+uio_uring_wait (struct uio_uring * ring, struct uio ** uios, int n,
+                const struct timespec * deadline, int * fired,
+                struct uio_io * io, int max_io, int * n_io);
+
+int
+uio_uring_rw (struct uio_uring * ring, int write, int fd, void * buf,
+              size_t count, off_t offset, void * user_data);
+
+#endif /* __UIOMUX_URING_H__ */
@@ -0,0 +1,228 @@
+/*
+ * UIOMux: a conflict manager for system resources, including UIO devices.
+ * Copyright (C) 2009 Renesas Technology Corp.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston MA  02110-1301 USA
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+#include <time.h>
+
+#include "uiomux/uiomux.h"
+#include "uiomux_private.h"
+#include "uio.h"
+#include "shm.h"
+
+/* #define DEBUG */
+
+/* Shortest interval between two checks of the lock holders */
+#define WATCHDOG_MIN_PERIOD_MS 10
+
+struct uiomux_watchdog {
+	pthread_t thread;
+	pthread_mutex_t lock;
+	pthread_cond_t cond;
+	int stop;
+
+	uiomux_resource_t resources;
+	unsigned long threshold_ms;
+	uiomux_watchdog_cb callback;
+	void *user_data;
+
+	/* lock_seq of the last hold reported by this handle */
+	unsigned int reported[UIOMUX_BLOCK_MAX];
+};
+
+static void watchdog_check(struct uiomux *uiomux, struct uiomux_watchdog *wd)
+{
+	struct uio_shm_device *dev;
+	uint64_t now, acquired;
+	unsigned long held_ms;
+	unsigned int seq, old;
+	pid_t pid, tid;
+	int i;
+
+	now = uio_time_ns();
+
+	for (i = 0; i < UIOMUX_BLOCK_MAX; i++) {
+		if (!(wd->resources & (1 << i)) || uiomux->uios[i] == NULL)
+			continue;
+
+		dev = uiomux->uios[i]->shm;
+		if (dev == NULL)
+			continue;
+
+		pid = dev->holder_pid;
+		tid = dev->holder_tid;
+		seq = dev->lock_seq;
+		acquired = dev->acquired;
+
+		if (pid == 0 || acquired > now)
+			continue;
+
+		held_ms = (now - acquired) / 1000000;
+		if (held_ms < wd->threshold_ms || wd->reported[i] == seq)
+			continue;
+
+		wd->reported[i] = seq;
+
+		/* Count each overlong hold once, whichever process saw it */
+		old = dev->watchdog_seq;
+		if (old != seq &&
+		    __sync_bool_compare_and_swap(&dev->watchdog_seq, old, seq))
+			__sync_fetch_and_add(&dev->watchdog_trips, 1);
+
+		if (wd->callback) {
+			wd->callback(uiomux, 1 << i, pid, tid, held_ms,
+				     wd->user_data);
+		} else {
+			fprintf(stderr,
+				"uiomux: %s held for %lu ms by pid %d tid %d\n",
+				dev->name, held_ms, pid, tid);
+		}
+	}
+}
+
+static void *watchdog_main(void *arg)
+{
+	struct uiomux *uiomux = (struct uiomux *)arg;
+	struct uiomux_watchdog *wd = uiomux->watchdog;
+	unsigned long period_ms;
+	struct timespec ts;
+
+	period_ms = wd->threshold_ms / 4;
+	if (period_ms < WATCHDOG_MIN_PERIOD_MS)
+		period_ms = WATCHDOG_MIN_PERIOD_MS;
+
+	pthread_mutex_lock(&wd->lock);
+	while (!wd->stop) {
+		clock_gettime(CLOCK_MONOTONIC, &ts);
+		ts.tv_sec += period_ms / 1000;
+		ts.tv_nsec += (period_ms % 1000) * 1000000;
+		if (ts.tv_nsec >= 1000000000) {
+			ts.tv_sec++;
+			ts.tv_nsec -= 1000000000;
+		}
+
+		pthread_cond_timedwait(&wd->cond, &wd->lock, &ts);
+		if (wd->stop)
+			break;
+
+		/* The callback may take its time; don't hold up uiomux_close() */
+		pthread_mutex_unlock(&wd->lock);
+		watchdog_check(uiomux, wd);
+		pthread_mutex_lock(&wd->lock);
+	}
+	pthread_mutex_unlock(&wd->lock);
+
+	return NULL;
+}
+
+/* Nonzero if called from the watchdog thread of the handle */
+int uiomux_watchdog_self(struct uiomux *uiomux)
+{
+	struct uiomux_watchdog *wd = uiomux->watchdog;
+
+	return wd != NULL && pthread_equal(pthread_self(), wd->thread);
+}
+
+int uiomux_watchdog_stop(struct uiomux *uiomux)
+{
+	struct uiomux_watchdog *wd = uiomux->watchdog;
+
+	if (wd == NULL)
+		return 0;
+
+	/* A callback cannot wait for its own thread to finish */
+	if (uiomux_watchdog_self(uiomux)) {
+		errno = EDEADLK;
+		return -1;
+	}
+
+	pthread_mutex_lock(&wd->lock);
+	wd->stop = 1;
+	pthread_cond_signal(&wd->cond);
+	pthread_mutex_unlock(&wd->lock);
+
+	pthread_join(wd->thread, NULL);
+
+	pthread_cond_destroy(&wd->cond);
+	pthread_mutex_destroy(&wd->lock);
+	free(wd);
+	uiomux->watchdog = NULL;
+
+	return 0;
+}
+
+int uiomux_set_watchdog(struct uiomux *uiomux, uiomux_resource_t blockmask,
+			unsigned long threshold_ms,
+			uiomux_watchdog_cb callback, void *user_data)
+{
+	struct uiomux_watchdog *wd;
+	pthread_condattr_t attr;
+	int ret;
+
+	if (uiomux == NULL)
+		return -1;
+
+	if (uiomux_watchdog_stop(uiomux) < 0)
+		return -1;
+
+	if (threshold_ms == 0)
+		return 0;
+
+	/* Lock holders are only known through the shared state */
+	if (uio_shm_get() == NULL) {
+		errno = ENOSYS;
+		return -1;
+	}
+
+	wd = (struct uiomux_watchdog *)calloc(1, sizeof(*wd));
+	if (wd == NULL)
+		return -1;
+
+	wd->resources = blockmask;
+	wd->threshold_ms = threshold_ms;
+	wd->callback = callback;
+	wd->user_data = user_data;
+
+	pthread_mutex_init(&wd->lock, NULL);
+	pthread_condattr_init(&attr);
+	pthread_condattr_setclock(&attr, CLOCK_MONOTONIC);
+	pthread_cond_init(&wd->cond, &attr);
+	pthread_condattr_destroy(&attr);
+
+	uiomux->watchdog = wd;
+
+	ret = pthread_create(&wd->thread, NULL, watchdog_main, uiomux);
+	if (ret != 0) {
+		pthread_cond_destroy(&wd->cond);
+		pthread_mutex_destroy(&wd->lock);
+		free(wd);
+		uiomux->watchdog = NULL;
+		errno = ret;
+		return -1;
+	}
+
+	return 0;
+}
@@ -99,3 +99,193 @@ LOCAL_SHARED_LIBRARIES := libuiomux
 LOCAL_MODULE := timeout
 LOCAL_MODULE_TAGS := optional
 include $(BUILD_EXECUTABLE)
+
+#exclusive-open
+include $(CLEAR_VARS)
+LOCAL_C_INCLUDES := external/libuiomux/include
+LOCAL_CFLAGS := -DVERSION=\"1.0.0\"
+LOCAL_SRC_FILES := exclusive-open.c
+LOCAL_SHARED_LIBRARIES := libuiomux
+LOCAL_MODULE := exclusive-open
+LOCAL_MODULE_TAGS := optional
+include $(BUILD_EXECUTABLE)
+
+#watchdog
+include $(CLEAR_VARS)
+LOCAL_C_INCLUDES := external/libuiomux/include
+LOCAL_CFLAGS := -DVERSION=\"1.0.0\"
+LOCAL_SRC_FILES := watchdog.c
+LOCAL_SHARED_LIBRARIES := libuiomux
+LOCAL_MODULE := watchdog
+LOCAL_MODULE_TAGS := optional
+include $(BUILD_EXECUTABLE)
+
+#sleep-any
+include $(CLEAR_VARS)
+LOCAL_C_INCLUDES := external/libuiomux/include
+LOCAL_CFLAGS := -DVERSION=\"1.0.0\"
+LOCAL_SRC_FILES := sleep-any.c
+LOCAL_SHARED_LIBRARIES := libuiomux
+LOCAL_MODULE := sleep-any
+LOCAL_MODULE_TAGS := optional
+include $(BUILD_EXECUTABLE)
+
+#dispatch
+include $(CLEAR_VARS)
+LOCAL_C_INCLUDES := external/libuiomux/include
+LOCAL_CFLAGS := -DVERSION=\"1.0.0\"
+LOCAL_SRC_FILES := dispatch.c
+LOCAL_SHARED_LIBRARIES := libuiomux
+LOCAL_MODULE := dispatch
+LOCAL_MODULE_TAGS := optional
+include $(BUILD_EXECUTABLE)
+
+#uring
+include $(CLEAR_VARS)
+LOCAL_C_INCLUDES := external/libuiomux/include
+LOCAL_CFLAGS := -DVERSION=\"1.0.0\"
+LOCAL_SRC_FILES := uring.c
+LOCAL_SHARED_LIBRARIES := libuiomux
+LOCAL_MODULE := uring
+LOCAL_MODULE_TAGS := optional
+include $(BUILD_EXECUTABLE)
+
+#wakeup-modes
+include $(CLEAR_VARS)
+LOCAL_C_INCLUDES := external/libuiomux/include
+LOCAL_CFLAGS := -DVERSION=\"1.0.0\"
+LOCAL_SRC_FILES := wakeup-modes.c
+LOCAL_SHARED_LIBRARIES := libuiomux
+LOCAL_MODULE := wakeup-modes
+LOCAL_MODULE_TAGS := optional
+include $(BUILD_EXECUTABLE)
+
+#register
+include $(CLEAR_VARS)
+LOCAL_C_INCLUDES := external/libuiomux/include
+LOCAL_CFLAGS := -DVERSION=\"1.0.0\"
+LOCAL_SRC_FILES := register.c
+LOCAL_SHARED_LIBRARIES := libuiomux
+LOCAL_MODULE := register
+LOCAL_MODULE_TAGS := optional
+include $(BUILD_EXECUTABLE)
+
+#translate
+include $(CLEAR_VARS)
+LOCAL_C_INCLUDES := external/libuiomux/include
+LOCAL_CFLAGS := -DVERSION=\"1.0.0\"
+LOCAL_SRC_FILES := translate.c
+LOCAL_SHARED_LIBRARIES := libuiomux
+LOCAL_MODULE := translate
+LOCAL_MODULE_TAGS := optional
+include $(BUILD_EXECUTABLE)
+
+#fixed-map
+include $(CLEAR_VARS)
+LOCAL_C_INCLUDES := external/libuiomux/include
+LOCAL_CFLAGS := -DVERSION=\"1.0.0\"
+LOCAL_SRC_FILES := fixed-map.c
+LOCAL_SHARED_LIBRARIES := libuiomux
+LOCAL_MODULE := fixed-map
+LOCAL_MODULE_TAGS := optional
+include $(BUILD_EXECUTABLE)
+
+#pin
+include $(CLEAR_VARS)
+LOCAL_C_INCLUDES := external/libuiomux/include
+LOCAL_CFLAGS := -DVERSION=\"1.0.0\"
+LOCAL_SRC_FILES := pin.c
+LOCAL_SHARED_LIBRARIES := libuiomux
+LOCAL_MODULE := pin
+LOCAL_MODULE_TAGS := optional
+include $(BUILD_EXECUTABLE)
+
+#snapshot
+include $(CLEAR_VARS)
+LOCAL_C_INCLUDES := external/libuiomux/include
+LOCAL_CFLAGS := -DVERSION=\"1.0.0\"
+LOCAL_SRC_FILES := snapshot.c
+LOCAL_SHARED_LIBRARIES := libuiomux
+LOCAL_MODULE := snapshot
+LOCAL_MODULE_TAGS := optional
+include $(BUILD_EXECUTABLE)
+
+#trace
+include $(CLEAR_VARS)
+LOCAL_C_INCLUDES := external/libuiomux/include
+LOCAL_CFLAGS := -DVERSION=\"1.0.0\"
+LOCAL_SRC_FILES := trace.c
+LOCAL_SHARED_LIBRARIES := libuiomux
+LOCAL_MODULE := trace
+LOCAL_MODULE_TAGS := optional
+include $(BUILD_EXECUTABLE)
+
+#cmdlist
+include $(CLEAR_VARS)
+LOCAL_C_INCLUDES := external/libuiomux/include
+LOCAL_CFLAGS := -DVERSION=\"1.0.0\"
+LOCAL_SRC_FILES := cmdlist.c
+LOCAL_SHARED_LIBRARIES := libuiomux
+LOCAL_MODULE := cmdlist
+LOCAL_MODULE_TAGS := optional
+include $(BUILD_EXECUTABLE)
+
+#sampler
+include $(CLEAR_VARS)
+LOCAL_C_INCLUDES := external/libuiomux/include
+LOCAL_CFLAGS := -DVERSION=\"1.0.0\"
+LOCAL_SRC_FILES := sampler.c
+LOCAL_SHARED_LIBRARIES := libuiomux
+LOCAL_MODULE := sampler
+LOCAL_MODULE_TAGS := optional
+include $(BUILD_EXECUTABLE)
+
+#extents
+include $(CLEAR_VARS)
+LOCAL_C_INCLUDES := external/libuiomux/include
+LOCAL_CFLAGS := -DVERSION=\"1.0.0\"
+LOCAL_SRC_FILES := extents.c
+LOCAL_SHARED_LIBRARIES := libuiomux
+LOCAL_MODULE := extents
+LOCAL_MODULE_TAGS := optional
+include $(BUILD_EXECUTABLE)
+
+#memstat
+include $(CLEAR_VARS)
+LOCAL_C_INCLUDES := external/libuiomux/include
+LOCAL_CFLAGS := -DVERSION=\"1.0.0\"
+LOCAL_SRC_FILES := memstat.c
+LOCAL_SHARED_LIBRARIES := libuiomux
+LOCAL_MODULE := memstat
+LOCAL_MODULE_TAGS := optional
+include $(BUILD_EXECUTABLE)
+
+#bench-lock
+include $(CLEAR_VARS)
+LOCAL_C_INCLUDES := external/libuiomux/include
+LOCAL_CFLAGS := -DVERSION=\"1.0.0\"
+LOCAL_SRC_FILES := bench-lock.c
+LOCAL_SHARED_LIBRARIES := libuiomux
+LOCAL_MODULE := bench-lock
+LOCAL_MODULE_TAGS := optional
+include $(BUILD_EXECUTABLE)
+
+#bench-sleep
+include $(CLEAR_VARS)
+LOCAL_C_INCLUDES := external/libuiomux/include
+LOCAL_CFLAGS := -DVERSION=\"1.0.0\"
+LOCAL_SRC_FILES := bench-sleep.c
+LOCAL_SHARED_LIBRARIES := libuiomux
+LOCAL_MODULE := bench-sleep
+LOCAL_MODULE_TAGS := optional
+include $(BUILD_EXECUTABLE)
+
+#bench-translate
+include $(CLEAR_VARS)
+LOCAL_C_INCLUDES := external/libuiomux/include
+LOCAL_CFLAGS := -DVERSION=\"1.0.0\"
+LOCAL_SRC_FILES := bench-translate.c
+LOCAL_SHARED_LIBRARIES := libuiomux
+LOCAL_MODULE := bench-translate
+LOCAL_MODULE_TAGS := optional
+include $(BUILD_EXECUTABLE)
@@ -0,0 +1,97 @@
+/*
+ * UIOMux: a conflict manager for system resources, including UIO devices.
+ * Copyright (C) 2009 Renesas Technology Corp.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston MA  02110-1301 USA
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+
+#include <uiomux/uiomux.h>
+
+#include "uiomux_tests.h"
+
+#define ITERATIONS 100000
+
+static double
+elapsed_ns (struct timespec * start, struct timespec * end)
+{
+  return (end->tv_sec - start->tv_sec) * 1e9 +
+         (end->tv_nsec - start->tv_nsec);
+}
+
+static void
+bench (const char * mode, int flags, uiomux_resource_t resource)
+{
+  UIOMux * uiomux;
+  struct timespec start, end;
+  void * mem;
+  int i;
+
+  uiomux = uiomux_open_flags (resource, flags);
+  if (uiomux == NULL || !uiomux_check_resource (uiomux, resource)) {
+    INFO ("%s: %s not available, skipping", mode, uiomux_name (resource));
+    if (uiomux)
+      uiomux_close (uiomux);
+    return;
+  }
+
+  clock_gettime (CLOCK_MONOTONIC, &start);
+  for (i = 0; i < ITERATIONS; i++) {
+    uiomux_lock (uiomux, resource);
+    uiomux_unlock (uiomux, resource);
+  }
+  clock_gettime (CLOCK_MONOTONIC, &end);
+  printf ("%-10s lock/unlock  %8.1f ns/op\n", mode,
+          elapsed_ns (&start, &end) / ITERATIONS);
+
+  clock_gettime (CLOCK_MONOTONIC, &start);
+  for (i = 0; i < ITERATIONS; i++) {
+    if ((mem = uiomux_malloc (uiomux, resource, 4096, 32)) == NULL)
+      break;
+    uiomux_free (uiomux, resource, mem, 4096);
+  }
+  clock_gettime (CLOCK_MONOTONIC, &end);
+  if (i > 0)
+    printf ("%-10s malloc/free  %8.1f ns/op\n", mode,
+            elapsed_ns (&start, &end) / i);
+
+  uiomux_close (uiomux);
+}
+
+int
+main (int argc, char *argv[])
+{
+  uiomux_resource_t resource = UIOMUX_SH_VEU;
+  int i;
+
+  if (argc > 1) {
+    for (i = 0; i < 16; i++) {
+      if (uiomux_name (1<<i) && !strcmp (argv[1], uiomux_name (1<<i)))
+        resource = 1<<i;
+    }
+  }
+
+  bench ("default", 0, resource);
+  bench ("exclusive", UIOMUX_OPEN_EXCLUSIVE, resource);
+
+  exit (0);
+}
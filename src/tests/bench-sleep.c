@@ -0,0 +1,154 @@
+/*
+ * UIOMux: a conflict manager for system resources, including UIO devices.
+ * Copyright (C) 2009 Renesas Technology Corp.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston MA  02110-1301 USA
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sched.h>
+#include <semaphore.h>
+#include <sys/socket.h>
+
+#include <uiomux/uiomux.h>
+
+#include "uiomux_tests.h"
+
+#define ITERATIONS 10000
+
+static UIOMux * uiomux;
+static uiomux_resource_t resource = UIOMUX_SH_VEU;
+static sem_t woken;
+static volatile int done = 0;
+
+static double
+elapsed_ns (struct timespec * start, struct timespec * end)
+{
+  return (end->tv_sec - start->tv_sec) * 1e9 +
+         (end->tv_nsec - start->tv_nsec);
+}
+
+static void *
+sleeper (void * arg)
+{
+  while (!done) {
+    uiomux_sleep (uiomux, resource);
+    sem_post (&woken);
+  }
+
+  return NULL;
+}
+
+/* Discard the interrupt enables written to a stand-in socket */
+static void *
+drain (void * arg)
+{
+  int fd = *(int *)arg;
+  char buf[256];
+
+  while (read (fd, buf, sizeof (buf)) > 0)
+    ;
+
+  return NULL;
+}
+
+/* Round trip from a wakeup to a sleeping thread and back */
+static void
+bench_wakeup (const char * name, int mode)
+{
+  struct timespec start, end;
+  pthread_t thread;
+  int i;
+
+  done = 0;
+  sem_init (&woken, 0, 0);
+  pthread_create (&thread, NULL, sleeper, NULL);
+
+  clock_gettime (CLOCK_MONOTONIC, &start);
+  for (i = 0; i < ITERATIONS; i++) {
+    if (mode == 0)
+      uiomux_wakeup (uiomux, resource);
+    else if (mode == 1)
+      uiomux_wakeup_one (uiomux, resource);
+    else
+      while (uiomux_wakeup_thread (uiomux, thread) < 0)
+        sched_yield ();
+    sem_wait (&woken);
+  }
+  clock_gettime (CLOCK_MONOTONIC, &end);
+  printf ("%-20s %8.1f ns/op\n", name,
+          elapsed_ns (&start, &end) / ITERATIONS);
+
+  done = 1;
+  uiomux_wakeup (uiomux, resource);
+  pthread_join (thread, NULL);
+  sem_destroy (&woken);
+}
+
+int
+main (int argc, char *argv[])
+{
+  struct timespec start, end, expired;
+  pthread_t drainer;
+  int sv[2];
+  int i;
+
+  if (argc > 1) {
+    for (i = 0; i < 16; i++) {
+      if (uiomux_name (1<<i) && !strcmp (argv[1], uiomux_name (1<<i)))
+        resource = 1<<i;
+    }
+  }
+
+  uiomux = uiomux_open_blocks (resource);
+  if (uiomux == NULL || !uiomux_check_resource (uiomux, resource)) {
+    INFO ("%s not available, skipping", uiomux_name (resource));
+    exit (0);
+  }
+
+  /* Cost of a wait which returns immediately */
+  expired.tv_sec = expired.tv_nsec = 0;
+  clock_gettime (CLOCK_MONOTONIC, &start);
+  for (i = 0; i < ITERATIONS; i++)
+    uiomux_sleep_deadline (uiomux, resource, &expired);
+  clock_gettime (CLOCK_MONOTONIC, &end);
+  printf ("expired deadline     %8.1f ns/op\n",
+          elapsed_ns (&start, &end) / ITERATIONS);
+
+  /* Sleeps must block to measure wakeups; a file standing in for the
+     device is always readable, so swap in a socket which never is */
+  if (argc > 2 && !strcmp (argv[2], "-s")) {
+    if (socketpair (AF_UNIX, SOCK_STREAM, 0, sv) < 0 ||
+        dup2 (sv[0], uiomux_get_irq_fd (uiomux, resource)) < 0)
+      FAIL ("Replacing interrupt fd");
+    pthread_create (&drainer, NULL, drain, &sv[1]);
+  }
+
+  bench_wakeup ("wakeup round trip", 0);
+  bench_wakeup ("wakeup_one", 1);
+  bench_wakeup ("wakeup_thread", 2);
+
+  uiomux_close (uiomux);
+
+  exit (0);
+}
@@ -0,0 +1,331 @@
+/*
+ * UIOMux: a conflict manager for system resources, including UIO devices.
+ * Copyright (C) 2009 Renesas Technology Corp.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston MA  02110-1301 USA
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include <uiomux/uiomux.h>
+
+#include "uiomux_tests.h"
+
+#define LOOKUPS 1000000
+
+/* Addresses translated per call in the batch lookups */
+#define SG_BATCH 32
+
+/* Regions registered for the multithreaded runs */
+#define THREAD_REGIONS 256
+
+/* Regions are 4 KiB, placed every 8 KiB so that lookups can miss */
+#define REGION_SIZE 4096
+#define REGION_STRIDE 8192
+#define REGION_BASE 0x40000000UL
+
+static double
+elapsed_ns (struct timespec * start, struct timespec * end)
+{
+  return (end->tv_sec - start->tv_sec) * 1e9 +
+         (end->tv_nsec - start->tv_nsec);
+}
+
+static char *
+region_virt (unsigned long i)
+{
+  return (char *) (REGION_BASE + i * REGION_STRIDE);
+}
+
+static void
+bench (unsigned long nr_regions)
+{
+  struct timespec start, end;
+  struct uiomux_iovec iov[SG_BATCH];
+  struct uiomux_segment segs[SG_BATCH];
+  unsigned long phys, sum = 0;
+  unsigned int seed = 1;
+  unsigned long i, j, k;
+
+  /* Register in a scrambled order rather than sorted */
+  clock_gettime (CLOCK_MONOTONIC, &start);
+  for (i = 0; i < nr_regions; i++) {
+    j = (i * 7919) % nr_regions;
+    if (uiomux_register (region_virt (j), 0x80000000UL + j * REGION_SIZE,
+                         REGION_SIZE) != 0)
+      FAIL ("Registering region %lu", j);
+  }
+  clock_gettime (CLOCK_MONOTONIC, &end);
+  printf ("%6lu regions  register  %8.1f ns/op\n", nr_regions,
+          elapsed_ns (&start, &end) / nr_regions);
+
+  /* The same address every time */
+  clock_gettime (CLOCK_MONOTONIC, &start);
+  for (i = 0; i < LOOKUPS; i++)
+    sum += uiomux_all_virt_to_phys (region_virt (nr_regions / 2) + 64);
+  clock_gettime (CLOCK_MONOTONIC, &end);
+  printf ("%6lu regions  same      %8.1f ns/op\n", nr_regions,
+          elapsed_ns (&start, &end) / LOOKUPS);
+
+  /* Random addresses, about half of which fall between regions */
+  clock_gettime (CLOCK_MONOTONIC, &start);
+  for (i = 0; i < LOOKUPS; i++) {
+    seed = seed * 1103515245 + 12345;
+    j = (seed >> 8) % (nr_regions * (REGION_STRIDE / 64));
+    sum += uiomux_all_virt_to_phys ((char *) REGION_BASE + j * 64);
+  }
+  clock_gettime (CLOCK_MONOTONIC, &end);
+  printf ("%6lu regions  random    %8.1f ns/op\n", nr_regions,
+          elapsed_ns (&start, &end) / LOOKUPS);
+
+  /* Random physical addresses */
+  clock_gettime (CLOCK_MONOTONIC, &start);
+  for (i = 0; i < LOOKUPS; i++) {
+    seed = seed * 1103515245 + 12345;
+    j = (seed >> 8) % (nr_regions * REGION_SIZE);
+    sum += (unsigned long) uiomux_all_phys_to_virt (0x80000000UL + j);
+  }
+  clock_gettime (CLOCK_MONOTONIC, &end);
+  printf ("%6lu regions  phys      %8.1f ns/op\n", nr_regions,
+          elapsed_ns (&start, &end) / LOOKUPS);
+
+  /* The same random addresses, a batch of SG_BATCH at a time */
+  seed = 1;
+  clock_gettime (CLOCK_MONOTONIC, &start);
+  for (i = 0; i < LOOKUPS; i += SG_BATCH) {
+    for (j = 0; j < SG_BATCH; j++) {
+      seed = seed * 1103515245 + 12345;
+      k = (seed >> 8) % (nr_regions * (REGION_STRIDE / 64));
+      iov[j].virt = (char *) REGION_BASE + k * 64;
+      iov[j].len = 64;
+    }
+    if (uiomux_all_virt_to_phys_sg (iov, SG_BATCH, segs, SG_BATCH) < 0)
+      FAIL ("Translating batch");
+    sum += segs[0].phys;
+  }
+  clock_gettime (CLOCK_MONOTONIC, &end);
+  printf ("%6lu regions  batch     %8.1f ns/op\n", nr_regions,
+          elapsed_ns (&start, &end) / LOOKUPS);
+
+  /* Check the translation once, outside the timed loops */
+  phys = uiomux_all_virt_to_phys (region_virt (nr_regions - 1) + 100);
+  if (phys != 0x80000000UL + (nr_regions - 1) * REGION_SIZE + 100)
+    FAIL ("Translating region %lu", nr_regions - 1);
+
+  for (i = 0; i < nr_regions; i++) {
+    if (uiomux_unregister (region_virt (i)) != 0)
+      FAIL ("Unregistering region %lu", i);
+  }
+
+  /* Keep the lookups from being optimised away */
+  if (sum == 1)
+    printf ("\n");
+}
+
+/* Translation within one resource, out of line and with a descriptor */
+static void
+bench_desc (uiomux_resource_t resource)
+{
+  UIOMux * uiomux;
+  struct uiomux_map_desc desc;
+  struct timespec start, end;
+  unsigned long i, sum = 0;
+  char * virt;
+
+  uiomux = uiomux_open_blocks (resource);
+  if (uiomux == NULL || uiomux_get_mem_desc (uiomux, resource, &desc) < 0 ||
+      desc.size == 0) {
+    INFO ("%s not available, skipping descriptor lookups",
+          uiomux_name (resource));
+    if (uiomux)
+      uiomux_close (uiomux);
+    return;
+  }
+  virt = (char *) desc.virt;
+
+  clock_gettime (CLOCK_MONOTONIC, &start);
+  for (i = 0; i < LOOKUPS; i++)
+    sum += uiomux_virt_to_phys (uiomux, resource, virt + (i & 0xfff));
+  clock_gettime (CLOCK_MONOTONIC, &end);
+  printf ("%-6s virt_to_phys       %8.1f ns/op\n", uiomux_name (resource),
+          elapsed_ns (&start, &end) / LOOKUPS);
+
+  clock_gettime (CLOCK_MONOTONIC, &start);
+  for (i = 0; i < LOOKUPS; i++)
+    sum += uiomux_desc_virt_to_phys (&desc, virt + (i & 0xfff));
+  clock_gettime (CLOCK_MONOTONIC, &end);
+  printf ("%-6s desc_virt_to_phys  %8.1f ns/op\n", uiomux_name (resource),
+          elapsed_ns (&start, &end) / LOOKUPS);
+
+  uiomux_close (uiomux);
+
+  if (sum == 1)
+    printf ("\n");
+}
+
+/* Pinning a user buffer, the first time and again from the cache */
+static void
+bench_pin (size_t len)
+{
+  struct uiomux_segment * segs;
+  struct timespec start, end;
+  int i, n, max_segs = len / 4096 + 2;
+  char * buf;
+
+  buf = malloc (len);
+  segs = malloc (max_segs * sizeof (*segs));
+  if (buf == NULL || segs == NULL)
+    FAIL ("Allocating %zu byte buffer", len);
+  memset (buf, 0, len);
+
+  clock_gettime (CLOCK_MONOTONIC, &start);
+  n = uiomux_pin (buf, len, segs, max_segs);
+  clock_gettime (CLOCK_MONOTONIC, &end);
+  if (n < 0) {
+    INFO ("Pinning not available, skipping");
+    goto out;
+  }
+  printf ("%7zu KiB  pin        %10.1f ns/op  %d runs\n", len / 1024,
+          elapsed_ns (&start, &end), n);
+
+  clock_gettime (CLOCK_MONOTONIC, &start);
+  for (i = 0; i < LOOKUPS / 100; i++) {
+    uiomux_pin (buf, len, segs, max_segs);
+    uiomux_unpin (buf, len);
+  }
+  clock_gettime (CLOCK_MONOTONIC, &end);
+  printf ("%7zu KiB  pin cached %10.1f ns/op\n", len / 1024,
+          elapsed_ns (&start, &end) / (LOOKUPS / 100));
+
+  uiomux_unpin (buf, len);
+out:
+  free (segs);
+  free (buf);
+}
+
+static void *
+lookup_thread (void * arg)
+{
+  unsigned long i, j, sum = 0;
+  unsigned int seed = (unsigned long) arg;
+
+  for (i = 0; i < LOOKUPS; i++) {
+    seed = seed * 1103515245 + 12345;
+    j = (seed >> 8) % THREAD_REGIONS;
+    sum += uiomux_all_virt_to_phys (region_virt (j) + 64);
+  }
+
+  return (void *) sum;
+}
+
+static volatile int churn_stop;
+
+/* Register and unregister a region past the others until told to stop */
+static void *
+churn_thread (void * arg)
+{
+  unsigned long n = 0;
+
+  while (!churn_stop) {
+    uiomux_register (region_virt (THREAD_REGIONS), 0x10000000UL,
+                     REGION_SIZE);
+    uiomux_unregister (region_virt (THREAD_REGIONS));
+    n++;
+  }
+
+  return (void *) n;
+}
+
+static void
+bench_threads (int nr_threads, int churn)
+{
+  pthread_t threads[nr_threads], churner;
+  struct timespec start, end;
+  void * changes = NULL;
+  double ns;
+  int i;
+
+  churn_stop = 0;
+  if (churn && pthread_create (&churner, NULL, churn_thread, NULL) != 0)
+    FAIL ("Creating churn thread");
+
+  clock_gettime (CLOCK_MONOTONIC, &start);
+  for (i = 0; i < nr_threads; i++) {
+    if (pthread_create (&threads[i], NULL, lookup_thread,
+                        (void *) (unsigned long) (i + 1)) != 0)
+      FAIL ("Creating thread %d", i);
+  }
+  for (i = 0; i < nr_threads; i++)
+    pthread_join (threads[i], NULL);
+  clock_gettime (CLOCK_MONOTONIC, &end);
+
+  if (churn) {
+    churn_stop = 1;
+    pthread_join (churner, &changes);
+  }
+
+  ns = elapsed_ns (&start, &end);
+  printf ("%3d threads%s  %8.1f ns/op  %8.2f Mop/s", nr_threads,
+          churn ? " +churn" : "       ", ns / LOOKUPS,
+          nr_threads * LOOKUPS * 1e3 / ns);
+  if (churn)
+    printf ("  %8.0f changes/s", (unsigned long) changes * 1e9 / ns);
+  printf ("\n");
+}
+
+int
+main (int argc, char *argv[])
+{
+  unsigned long sizes[] = { 1, 16, 256, 4096 };
+  unsigned int i;
+  int max_threads, n;
+
+  if (argc > 1)
+    max_threads = atoi (argv[1]);
+  else
+    max_threads = sysconf (_SC_NPROCESSORS_ONLN);
+  if (max_threads < 1)
+    max_threads = 1;
+
+  for (i = 0; i < sizeof (sizes) / sizeof (sizes[0]); i++)
+    bench (sizes[i]);
+
+  bench_desc (UIOMUX_SH_VEU);
+  bench_pin (1024 * 1024);
+
+  /* Scaling with the number of threads looking up addresses at once */
+  for (i = 0; i < THREAD_REGIONS; i++)
+    uiomux_register (region_virt (i), 0x80000000UL + i * REGION_SIZE,
+                     REGION_SIZE);
+
+  for (n = 1; n <= max_threads; n *= 2) {
+    bench_threads (n, 0);
+    bench_threads (n, 1);
+  }
+
+  for (i = 0; i < THREAD_REGIONS; i++)
+    uiomux_unregister (region_virt (i));
+
+  exit (0);
+}
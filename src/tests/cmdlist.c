@@ -0,0 +1,93 @@
+/*
+ * UIOMux: a conflict manager for system resources, including UIO devices.
+ * Copyright (C) 2009 Renesas Technology Corp.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston MA  02110-1301 USA
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+#include <errno.h>
+
+#include <uiomux/uiomux.h>
+
+#include "uiomux_tests.h"
+
+int
+main (int argc, char *argv[])
+{
+  UIOMux * uiomux;
+  struct uiomux_map_desc mmio;
+  struct uiomux_reg_cmd cmds[3] = {
+    { 0x10, 0x12345678, UIOMUX_REG_ALL },
+    { 0x14, 0x000000ab, 0x000000ff },
+    { 0x18, 0x00000000, UIOMUX_REG_ALL },
+  };
+  uint32_t saved[3];
+  int i;
+
+  INFO ("Opening UIOMux for VEU");
+  uiomux = uiomux_open_blocks (UIOMUX_SH_VEU);
+  if (uiomux == NULL)
+    FAIL ("Opening UIOMux");
+
+  if (!uiomux_check_resource (uiomux, UIOMUX_SH_VEU)) {
+    INFO ("VEU not available, checking failure");
+    if (uiomux_apply_cmds (uiomux, UIOMUX_SH_VEU, cmds, 3) != -1 ||
+        errno != EINVAL)
+      FAIL ("Applying commands to unmanaged resource");
+    uiomux_close (uiomux);
+    exit (0);
+  }
+
+  uiomux_get_mmio_desc (uiomux, UIOMUX_SH_VEU, &mmio);
+
+  INFO ("Applying commands without the lock");
+  if (uiomux_apply_cmds (uiomux, UIOMUX_SH_VEU, cmds, 3) != -1 ||
+      errno != EPERM)
+    FAIL ("Applied commands without the lock");
+
+  uiomux_lock (uiomux, UIOMUX_SH_VEU);
+  for (i = 0; i < 3; i++)
+    saved[i] = uiomux_reg_read (&mmio, 0x10 + i * 4);
+  uiomux_reg_write (&mmio, 0x14, 0x11111111);
+  uiomux_reg_write (&mmio, 0x18, 0xffffffff);
+
+  INFO ("Applying a list with a bad offset");
+  cmds[2].offset = mmio.size;
+  if (uiomux_apply_cmds (uiomux, UIOMUX_SH_VEU, cmds, 3) != -1 ||
+      errno != EINVAL)
+    FAIL ("Applied a list with a bad offset");
+  if (uiomux_reg_read (&mmio, 0x10) != saved[0])
+    FAIL ("Bad list was partly applied");
+
+  INFO ("Applying commands");
+  cmds[2].offset = 0x18;
+  if (uiomux_apply_cmds (uiomux, UIOMUX_SH_VEU, cmds, 3) != 0)
+    FAIL ("Applying commands");
+  if (uiomux_reg_read (&mmio, 0x10) != 0x12345678 ||
+      uiomux_reg_read (&mmio, 0x14) != 0x111111ab ||
+      uiomux_reg_read (&mmio, 0x18) != 0)
+    FAIL ("Registers not as commanded");
+
+  for (i = 0; i < 3; i++)
+    uiomux_reg_write (&mmio, 0x10 + i * 4, saved[i]);
+  uiomux_unlock (uiomux, UIOMUX_SH_VEU);
+
+  uiomux_close (uiomux);
+
+  exit (0);
+}
@@ -0,0 +1,144 @@
+/*
+ * UIOMux: a conflict manager for system resources, including UIO devices.
+ * Copyright (C) 2009 Renesas Technology Corp.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston MA  02110-1301 USA
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <errno.h>
+#include <stdio.h>
+#include <unistd.h>
+
+#include <uiomux/uiomux.h>
+
+#include "uiomux_tests.h"
+
+static int callbacks = 0;
+static int stop_ret = 0;
+static int close_errno = 0;
+static int destroy_errno = 0;
+static volatile int tripped = 0;
+
+static void
+watchdog_cb (UIOMux * uiomux, uiomux_resource_t resource, pid_t pid,
+             pid_t tid, unsigned long held_ms, void * user_data)
+{
+  tripped++;
+}
+
+static void
+completion (UIOMux * uiomux, uiomux_resource_t resource,
+            unsigned long irq_count, void * user_data)
+{
+  if (user_data != &callbacks)
+    FAIL ("Wrong user_data in completion callback");
+
+  /* The dispatcher cannot be stopped from its own thread, nor the handle
+     closed or destroyed */
+  if (callbacks++ == 0) {
+    stop_ret = uiomux_dispatch_stop (uiomux);
+    if (uiomux_close (uiomux) == -1)
+      close_errno = errno;
+    if (uiomux_system_destroy (uiomux) == -1)
+      destroy_errno = errno;
+  }
+}
+
+int
+main (int argc, char *argv[])
+{
+  UIOMux * uiomux;
+  uiomux_resource_t blocks;
+  struct uiomux_completion c;
+  int ret;
+
+  INFO ("Opening UIOMux for VEU and BEU");
+  uiomux = uiomux_open_blocks (UIOMUX_SH_VEU | UIOMUX_SH_BEU);
+  if (uiomux == NULL)
+    FAIL ("Opening UIOMux");
+
+  if (uiomux_dispatch_poll (uiomux, &c) != -1)
+    FAIL ("Polling without a dispatcher succeeded");
+
+  INFO ("Starting dispatcher");
+  if (uiomux_dispatch_start (uiomux, UIOMUX_DISPATCH_QUEUE) != 0)
+    FAIL ("Starting dispatcher");
+
+  if (uiomux_dispatch_start (uiomux, 0) != -1)
+    FAIL ("Starting a second dispatcher succeeded");
+
+  blocks = uiomux_check_resource (uiomux, UIOMUX_SH_VEU | UIOMUX_SH_BEU);
+  if (blocks == UIOMUX_NONE) {
+    INFO ("Neither VEU nor BEU available, checking failure");
+    if (uiomux_dispatch_register (uiomux, UIOMUX_SH_VEU, completion,
+                                  &callbacks) != -1)
+      FAIL ("Registering an unmanaged block succeeded");
+  } else {
+    /* Without shared state there is no watchdog to check */
+    if (uiomux_set_watchdog (uiomux, blocks, 20, watchdog_cb, NULL) < 0)
+      tripped = -1;
+
+    INFO ("Registering available blocks");
+    if (uiomux_dispatch_register (uiomux, blocks, completion,
+                                  &callbacks) != 0)
+      FAIL ("Registering blocks");
+
+    usleep (10000);
+
+    if (callbacks > 0 && stop_ret != -1)
+      FAIL ("Stopping the dispatcher from a callback succeeded");
+    if (callbacks > 0 && (close_errno != EDEADLK || destroy_errno != EDEADLK))
+      FAIL ("Closing the handle from a callback succeeded");
+
+    if (tripped == 0) {
+      INFO ("Checking the watchdog survived the refused close");
+      uiomux_lock (uiomux, blocks);
+      usleep (100000);
+      uiomux_unlock (uiomux, blocks);
+      if (tripped == 0)
+        FAIL ("Watchdog stopped by a refused close");
+    }
+
+    while ((ret = uiomux_dispatch_poll (uiomux, &c)) == 1) {
+      if (c.resource == UIOMUX_NONE || (c.resource & ~blocks))
+        FAIL ("Unexpected block completed: 0x%x", c.resource);
+    }
+    if (ret != 0)
+      FAIL ("Polling the completion queue");
+
+    INFO ("%d completions dispatched", callbacks);
+
+    if (uiomux_dispatch_unregister (uiomux, blocks) != 0)
+      FAIL ("Unregistering blocks");
+  }
+
+  INFO ("Stopping dispatcher");
+  if (uiomux_dispatch_stop (uiomux) != 0)
+    FAIL ("Stopping dispatcher");
+
+  /* uiomux_close() stops a running dispatcher */
+  uiomux_dispatch_start (uiomux, 0);
+
+  INFO ("Closing UIOMux");
+  ret = uiomux_close (uiomux);
+  if (ret != 0)
+    FAIL ("Closing UIOMux");
+
+  exit (0);
+}
@@ -0,0 +1,108 @@
+/*
+ * UIOMux: a conflict manager for system resources, including UIO devices.
+ * Copyright (C) 2009 Renesas Technology Corp.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston MA  02110-1301 USA
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <errno.h>
+#include <stdio.h>
+
+#include <uiomux/uiomux.h>
+
+#include "uiomux_tests.h"
+
+int
+main (int argc, char *argv[])
+{
+  UIOMux * uiomux, * other;
+  void * mem;
+  int ret;
+
+  INFO ("Opening UIOMux exclusively for BEU");
+  uiomux = uiomux_open_flags (UIOMUX_SH_BEU, UIOMUX_OPEN_EXCLUSIVE);
+  if (uiomux == NULL)
+    FAIL ("Opening UIOMux");
+
+  if (!uiomux_check_resource (uiomux, UIOMUX_SH_BEU)) {
+    INFO ("BEU not available, skipping");
+    uiomux_close (uiomux);
+    exit (0);
+  }
+
+  INFO ("Opening a second exclusive UIOMux for BEU");
+  other = uiomux_open_flags (UIOMUX_SH_BEU, UIOMUX_OPEN_EXCLUSIVE);
+  if (other == NULL)
+    FAIL ("Opening second UIOMux");
+  if (uiomux_check_resource (other, UIOMUX_SH_BEU))
+    FAIL ("BEU claimed twice");
+  uiomux_close (other);
+
+  INFO ("Locking BEU through a shared UIOMux in the same process");
+  other = uiomux_open_blocks (UIOMUX_SH_BEU);
+  if (other == NULL)
+    FAIL ("Opening shared UIOMux");
+  if (uiomux_check_resource (other, UIOMUX_SH_BEU)) {
+    if (uiomux_lock (other, UIOMUX_SH_BEU) != -1 || errno != EBUSY)
+      FAIL ("Locking a block claimed in the same process did not fail");
+  }
+  uiomux_close (other);
+
+  uiomux_lock (uiomux, UIOMUX_SH_BEU);
+  INFO ("Locked");
+  uiomux_unlock (uiomux, UIOMUX_SH_BEU);
+  INFO ("Unlocked");
+
+  mem = uiomux_malloc (uiomux, UIOMUX_SH_BEU, 4096, 32);
+  if (mem) {
+    INFO ("Allocated 4096 bytes");
+    uiomux_free (uiomux, UIOMUX_SH_BEU, mem, 4096);
+  }
+
+  INFO ("Closing UIOMux");
+  ret = uiomux_close (uiomux);
+  if (ret != 0)
+    FAIL ("Closing UIOMux");
+
+  INFO ("Reopening UIOMux exclusively for BEU");
+  uiomux = uiomux_open_flags (UIOMUX_SH_BEU, UIOMUX_OPEN_EXCLUSIVE);
+  if (uiomux == NULL || !uiomux_check_resource (uiomux, UIOMUX_SH_BEU))
+    FAIL ("BEU not released on close");
+  uiomux_close (uiomux);
+
+  INFO ("Claiming BEU while a shared UIOMux has it locked");
+  other = uiomux_open_blocks (UIOMUX_SH_BEU);
+  if (other == NULL || uiomux_lock (other, UIOMUX_SH_BEU) != 0)
+    FAIL ("Locking shared UIOMux");
+  uiomux = uiomux_open_flags (UIOMUX_SH_BEU, UIOMUX_OPEN_EXCLUSIVE);
+  if (uiomux == NULL)
+    FAIL ("Opening exclusive UIOMux");
+  if (uiomux_check_resource (uiomux, UIOMUX_SH_BEU))
+    FAIL ("BEU claimed while locked in the same process");
+  uiomux_close (uiomux);
+  uiomux_unlock (other, UIOMUX_SH_BEU);
+
+  INFO ("Locking the shared UIOMux after the exclusive one is closed");
+  if (uiomux_lock (other, UIOMUX_SH_BEU) != 0)
+    FAIL ("Locking shared UIOMux");
+  uiomux_unlock (other, UIOMUX_SH_BEU);
+  uiomux_close (other);
+
+  exit (0);
+}
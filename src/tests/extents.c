@@ -0,0 +1,113 @@
+/*
+ * UIOMux: a conflict manager for system resources, including UIO devices.
+ * Copyright (C) 2009 Renesas Technology Corp.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston MA  02110-1301 USA
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+#include <unistd.h>
+#include <sys/wait.h>
+
+#include <uiomux/uiomux.h>
+
+#include "uiomux_tests.h"
+
+/* Extents owned by a process */
+static int
+extents_of (UIOMux * uiomux, pid_t pid, struct uiomux_extent * own, int max)
+{
+  struct uiomux_extent extents[16];
+  int i, n, k = 0;
+
+  n = uiomux_get_extents (uiomux, UIOMUX_SH_VEU, extents, 16, NULL);
+  if (n < 0 || n > 16)
+    FAIL ("Getting extents");
+
+  for (i = 0; i < n; i++) {
+    if (extents[i].pid == pid && k < max)
+      own[k++] = extents[i];
+  }
+
+  return k;
+}
+
+int
+main (int argc, char *argv[])
+{
+  UIOMux * uiomux;
+  struct uiomux_extent own[4];
+  unsigned long phys;
+  unsigned long pagesize = sysconf (_SC_PAGESIZE);
+  char * a, * b;
+  pid_t pid;
+  int n;
+
+  INFO ("Opening UIOMux for VEU");
+  uiomux = uiomux_open_blocks (UIOMUX_SH_VEU);
+  if (uiomux == NULL)
+    FAIL ("Opening UIOMux");
+
+  if (!uiomux_check_resource (uiomux, UIOMUX_SH_VEU)) {
+    INFO ("VEU not available, checking failure");
+    if (uiomux_get_extents (uiomux, UIOMUX_SH_VEU, own, 4, NULL) != -1)
+      FAIL ("Extents of unmanaged resource");
+    uiomux_close (uiomux);
+    exit (0);
+  }
+
+  INFO ("Allocating two adjacent buffers");
+  a = uiomux_malloc (uiomux, UIOMUX_SH_VEU, 4 * pagesize, 1);
+  b = uiomux_malloc (uiomux, UIOMUX_SH_VEU, 2 * pagesize, 1);
+  if (a == NULL || b == NULL || b != a + 4 * pagesize)
+    FAIL ("Allocating buffers");
+  phys = uiomux_virt_to_phys (uiomux, UIOMUX_SH_VEU, a);
+
+  n = extents_of (uiomux, getpid (), own, 4);
+  if (n != 1 || own[0].address != phys || own[0].size != 6 * pagesize ||
+      own[0].tid == 0 || own[0].flags != 0)
+    FAIL ("Expected one merged extent, got %d", n);
+
+  INFO ("Freeing a page in the middle");
+  uiomux_free (uiomux, UIOMUX_SH_VEU, a + pagesize, pagesize);
+  n = extents_of (uiomux, getpid (), own, 4);
+  if (n != 2 || own[0].size != pagesize ||
+      own[1].address != phys + 2 * pagesize || own[1].size != 4 * pagesize)
+    FAIL ("Expected two extents around the hole, got %d", n);
+
+  uiomux_free (uiomux, UIOMUX_SH_VEU, a, pagesize);
+  uiomux_free (uiomux, UIOMUX_SH_VEU, a + 2 * pagesize, 2 * pagesize);
+  uiomux_free (uiomux, UIOMUX_SH_VEU, b, 2 * pagesize);
+  if (extents_of (uiomux, getpid (), own, 4) != 0)
+    FAIL ("Extents left after freeing");
+
+  INFO ("Checking extents of an exited process are dropped");
+  if ((pid = fork ()) == 0) {
+    uiomux_close (uiomux);
+    uiomux = uiomux_open_blocks (UIOMUX_SH_VEU);
+    if (uiomux_malloc (uiomux, UIOMUX_SH_VEU, pagesize, 1) == NULL)
+      _exit (1);
+    _exit (0);
+  }
+  waitpid (pid, NULL, 0);
+  if (extents_of (uiomux, pid, own, 4) != 0)
+    FAIL ("Extent of exited process %d", pid);
+
+  uiomux_close (uiomux);
+
+  exit (0);
+}
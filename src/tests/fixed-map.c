@@ -0,0 +1,128 @@
+/*
+ * UIOMux: a conflict manager for system resources, including UIO devices.
+ * Copyright (C) 2009 Renesas Technology Corp.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston MA  02110-1301 USA
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <sys/mman.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include <uiomux/uiomux.h>
+
+#include "uiomux_tests.h"
+
+static void *
+mem_iomem (UIOMux * uiomux)
+{
+  void * iomem = NULL;
+
+  uiomux_get_mem (uiomux, UIOMUX_SH_VEU, NULL, NULL, &iomem);
+  return iomem;
+}
+
+int
+main (int argc, char *argv[])
+{
+  UIOMux * fixed, * fixed2, * plain;
+  void * agreed, * other;
+  pid_t pid;
+  int status;
+
+  INFO ("Opening UIOMux for VEU with a fixed memory map");
+  fixed = uiomux_open_flags (UIOMUX_SH_VEU, UIOMUX_OPEN_FIXED_MAP);
+  if (fixed == NULL)
+    FAIL ("Opening UIOMux");
+
+  if (!uiomux_check_resource (fixed, UIOMUX_SH_VEU)) {
+    INFO ("VEU not available, skipping");
+    uiomux_close (fixed);
+    exit (0);
+  }
+  agreed = mem_iomem (fixed);
+
+  INFO ("Opening a second handle with a fixed memory map");
+  fixed2 = uiomux_open_flags (UIOMUX_SH_VEU, UIOMUX_OPEN_FIXED_MAP);
+  if (fixed2 == NULL || !uiomux_check_resource (fixed2, UIOMUX_SH_VEU))
+    FAIL ("Opening second handle");
+  if (mem_iomem (fixed2) != agreed)
+    FAIL ("Second handle mapped at %p, not %p", mem_iomem (fixed2), agreed);
+
+  INFO ("Checking the fixed map against an ordinary one");
+  plain = uiomux_open_blocks (UIOMUX_SH_VEU);
+  if (plain == NULL || !uiomux_check_resource (plain, UIOMUX_SH_VEU))
+    FAIL ("Opening ordinary handle");
+  *(volatile unsigned long *) agreed = 0x5a5a1234;
+  if (*(volatile unsigned long *) mem_iomem (plain) != 0x5a5a1234)
+    FAIL ("Fixed and ordinary maps differ");
+
+  INFO ("Closing the first handle");
+  uiomux_close (fixed);
+  if (*(volatile unsigned long *) mem_iomem (fixed2) != 0x5a5a1234)
+    FAIL ("Fixed map lost with the first handle");
+
+  INFO ("Mapping at the same address in a child process");
+  fflush (stdout);
+  pid = fork ();
+  if (pid == 0) {
+    /* Drop the inherited mapping, so that the child maps anew */
+    uiomux_close (fixed2);
+    fixed = uiomux_open_flags (UIOMUX_SH_VEU, UIOMUX_OPEN_FIXED_MAP);
+    if (fixed == NULL || !uiomux_check_resource (fixed, UIOMUX_SH_VEU))
+      exit (1);
+    if (mem_iomem (fixed) != agreed)
+      exit (2);
+    if (*(volatile unsigned long *) agreed != 0x5a5a1234)
+      exit (3);
+    uiomux_close (fixed);
+    exit (0);
+  }
+  if (pid < 0 || waitpid (pid, &status, 0) != pid)
+    FAIL ("Running child");
+  if (!WIFEXITED (status) || WEXITSTATUS (status) != 0)
+    FAIL ("Child failed to map at %p (status %d)", agreed, status);
+
+  uiomux_close (plain);
+  uiomux_close (fixed2);
+
+  INFO ("Claiming with a fixed map while the address is taken");
+  other = mmap (agreed, sysconf (_SC_PAGESIZE), PROT_READ,
+                MAP_PRIVATE | MAP_ANONYMOUS | MAP_FIXED, -1, 0);
+  if (other != agreed)
+    FAIL ("Occupying the agreed address");
+  fixed = uiomux_open_flags (UIOMUX_SH_VEU,
+                             UIOMUX_OPEN_EXCLUSIVE | UIOMUX_OPEN_FIXED_MAP);
+  if (fixed == NULL)
+    FAIL ("Opening exclusive handle");
+  if (uiomux_check_resource (fixed, UIOMUX_SH_VEU))
+    FAIL ("Mapped over another mapping");
+  uiomux_close (fixed);
+
+  /* The failed open must not have left the block claimed */
+  plain = uiomux_open_blocks (UIOMUX_SH_VEU);
+  if (plain == NULL || uiomux_lock (plain, UIOMUX_SH_VEU) != 0)
+    FAIL ("Locking after a failed exclusive open");
+  uiomux_unlock (plain, UIOMUX_SH_VEU);
+  uiomux_close (plain);
+  munmap (other, sysconf (_SC_PAGESIZE));
+
+  exit (0);
+}
@@ -0,0 +1,140 @@
+/*
+ * UIOMux: a conflict manager for system resources, including UIO devices.
+ * Copyright (C) 2009 Renesas Technology Corp.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston MA  02110-1301 USA
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+#include <signal.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/wait.h>
+
+#include <uiomux/uiomux.h>
+
+#include "uiomux_tests.h"
+
+/* Statistics of one process, or all zero if it has none */
+static struct uiomux_memstat
+memstat_of (UIOMux * uiomux, pid_t pid)
+{
+  struct uiomux_memstat stats[16], none;
+  int i, n;
+
+  n = uiomux_get_proc_memstat (uiomux, UIOMUX_SH_VEU, stats, 16);
+  if (n < 0)
+    FAIL ("Getting process statistics");
+
+  for (i = 0; i < n && i < 16; i++) {
+    if (stats[i].pid == pid)
+      return stats[i];
+  }
+
+  memset (&none, 0, sizeof (none));
+  return none;
+}
+
+int
+main (int argc, char *argv[])
+{
+  UIOMux * uiomux;
+  struct uiomux_memstat before, total, own;
+  unsigned long pagesize = sysconf (_SC_PAGESIZE), size;
+  char * a, * iomem;
+  pid_t pid;
+
+  INFO ("Opening UIOMux for VEU");
+  uiomux = uiomux_open_blocks (UIOMUX_SH_VEU);
+  if (uiomux == NULL)
+    FAIL ("Opening UIOMux");
+
+  if (!uiomux_check_resource (uiomux, UIOMUX_SH_VEU)) {
+    INFO ("VEU not available, checking failure");
+    if (uiomux_get_memstat (uiomux, UIOMUX_SH_VEU, &total) != -1)
+      FAIL ("Statistics of unmanaged resource");
+    uiomux_close (uiomux);
+    exit (0);
+  }
+
+  uiomux_get_mem (uiomux, UIOMUX_SH_VEU, NULL, &size, (void **) &iomem);
+  if (uiomux_get_memstat (uiomux, UIOMUX_SH_VEU, &before) != 0)
+    FAIL ("Getting statistics");
+
+  INFO ("Allocating three pages, and failing to allocate too much");
+  a = uiomux_malloc (uiomux, UIOMUX_SH_VEU, 3 * pagesize, 1);
+  if (a == NULL)
+    FAIL ("Allocating");
+  if (uiomux_malloc (uiomux, UIOMUX_SH_VEU, 2 * size, 1) != NULL)
+    FAIL ("Allocated more than the region");
+
+  uiomux_get_memstat (uiomux, UIOMUX_SH_VEU, &total);
+  own = memstat_of (uiomux, getpid ());
+  if (total.live_bytes != before.live_bytes + 3 * pagesize ||
+      total.allocs != before.allocs + 1 || total.failed != before.failed + 1)
+    FAIL ("Total not updated");
+  if (own.live_bytes != 3 * pagesize || own.peak_bytes != 3 * pagesize ||
+      own.allocs != 1 || own.failed != 1)
+    FAIL ("Process statistics not updated");
+
+  INFO ("Freeing, keeping the peak until it is reset");
+  uiomux_free (uiomux, UIOMUX_SH_VEU, a, 3 * pagesize);
+  own = memstat_of (uiomux, getpid ());
+  if (own.live_bytes != 0 || own.peak_bytes != 3 * pagesize ||
+      own.frees != 1)
+    FAIL ("Free not accounted");
+  uiomux_reset_mem_peak (uiomux, UIOMUX_SH_VEU);
+  if (memstat_of (uiomux, getpid ()).peak_bytes != 0)
+    FAIL ("Peak not reset");
+
+  INFO ("Locking and unlocking memory, which is not allocated");
+  a = uiomux_malloc (uiomux, UIOMUX_SH_VEU, pagesize, 1);
+  if (a == NULL)
+    FAIL ("Allocating");
+  if (uiomux_mlock (uiomux, UIOMUX_SH_VEU, iomem + size - pagesize,
+                    pagesize) != 0)
+    FAIL ("Locking the last page");
+  uiomux_munlock (uiomux, UIOMUX_SH_VEU, iomem + size - pagesize, pagesize);
+  own = memstat_of (uiomux, getpid ());
+  if (own.live_bytes != pagesize || own.allocs != 2 || own.frees != 1)
+    FAIL ("Locked memory accounted");
+  uiomux_free (uiomux, UIOMUX_SH_VEU, a, pagesize);
+
+  INFO ("Checking memory of an exited process is returned");
+  if ((pid = fork ()) == 0) {
+    uiomux_close (uiomux);
+    uiomux = uiomux_open_blocks (UIOMUX_SH_VEU);
+    if (uiomux_malloc (uiomux, UIOMUX_SH_VEU, pagesize, 1) == NULL)
+      _exit (1);
+    pause ();
+    _exit (0);
+  }
+  do {
+    usleep (1000);
+  } while (memstat_of (uiomux, pid).live_bytes != pagesize);
+  kill (pid, SIGKILL);
+  waitpid (pid, NULL, 0);
+
+  uiomux_get_memstat (uiomux, UIOMUX_SH_VEU, &total);
+  if (total.live_bytes != before.live_bytes ||
+      memstat_of (uiomux, pid).allocs != 0)
+    FAIL ("Memory of exited process still counted");
+
+  uiomux_close (uiomux);
+
+  exit (0);
+}
@@ -0,0 +1,110 @@
+/*
+ * UIOMux: a conflict manager for system resources, including UIO devices.
+ * Copyright (C) 2009 Renesas Technology Corp.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston MA  02110-1301 USA
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <errno.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <uiomux/uiomux.h>
+
+#include "uiomux_tests.h"
+
+#define BUF_SIZE (256 * 1024)
+#define MAX_SEGS 256
+
+/* Check that runs tile a buffer and agree with uiomux_all_virt_to_phys */
+static void
+check_runs (char * buf, size_t len, struct uiomux_segment * segs, int n)
+{
+  size_t off = 0;
+  int i;
+
+  for (i = 0; i < n; i++) {
+    if (segs[i].len == 0 || segs[i].gap)
+      FAIL ("Run %d is empty or a gap", i);
+    if (uiomux_all_virt_to_phys (buf + off) != segs[i].phys)
+      FAIL ("Start of run %d does not translate", i);
+    if (uiomux_all_virt_to_phys (buf + off + segs[i].len - 1) !=
+        segs[i].phys + segs[i].len - 1)
+      FAIL ("End of run %d does not translate", i);
+    off += segs[i].len;
+  }
+  if (off != len)
+    FAIL ("Runs cover %zu bytes, not %zu", off, len);
+}
+
+int
+main (int argc, char *argv[])
+{
+  struct uiomux_segment segs[MAX_SEGS], again[MAX_SEGS];
+  char * buf;
+  int n, m;
+
+  buf = malloc (BUF_SIZE + 100);
+  if (buf == NULL)
+    FAIL ("Allocating buffer");
+  memset (buf, 0xa5, BUF_SIZE + 100);
+
+  INFO ("Pinning an unaligned %d byte buffer", BUF_SIZE);
+  n = uiomux_pin (buf + 100, BUF_SIZE, segs, MAX_SEGS);
+  if (n < 0) {
+    if (errno == EPERM || errno == ENOENT || errno == ENOMEM) {
+      INFO ("Pinning not permitted here (%s), skipping", strerror (errno));
+      exit (0);
+    }
+    FAIL ("Pinning buffer: %s", strerror (errno));
+  }
+  INFO ("Buffer is in %d physically contiguous runs", n);
+  check_runs (buf + 100, BUF_SIZE, segs, n);
+
+  INFO ("Pinning the same buffer again");
+  m = uiomux_pin (buf + 100, BUF_SIZE, again, MAX_SEGS);
+  if (m != n || memcmp (segs, again, n * sizeof (segs[0])))
+    FAIL ("Pinning again gave different runs");
+
+  if (n > 1 && uiomux_pin (buf + 100, BUF_SIZE, again, 1) != -1)
+    FAIL ("Pinning into too few segments succeeded");
+
+  INFO ("Pinning an overlapping buffer");
+  m = uiomux_pin (buf + 4096, 8192, again, MAX_SEGS);
+  if (m < 0)
+    FAIL ("Pinning overlapping buffer");
+  check_runs (buf + 4096, 8192, again, m);
+
+  INFO ("Unpinning");
+  if (uiomux_unpin (buf + 4096, 8192) != 0)
+    FAIL ("Unpinning overlapping buffer");
+  if (uiomux_unpin (buf + 100, BUF_SIZE) != 0)
+    FAIL ("Unpinning buffer once");
+  check_runs (buf + 100, BUF_SIZE, segs, n);
+  if (uiomux_unpin (buf + 100, BUF_SIZE) != 0)
+    FAIL ("Unpinning buffer twice");
+  if (uiomux_all_virt_to_phys (buf + 100) != 0)
+    FAIL ("Unpinned buffer still translates");
+  if (uiomux_unpin (buf + 100, BUF_SIZE) == 0)
+    FAIL ("Unpinning buffer three times succeeded");
+
+  free (buf);
+
+  exit (0);
+}
@@ -0,0 +1,205 @@
+/*
+ * UIOMux: a conflict manager for system resources, including UIO devices.
+ * Copyright (C) 2009 Renesas Technology Corp.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston MA  02110-1301 USA
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <errno.h>
+#include <pthread.h>
+
+#include <uiomux/uiomux.h>
+
+#include "uiomux_tests.h"
+
+#define NR_REGIONS 100
+
+/* Regions of 0x1000 bytes, every 0x2000 bytes, registered out of order */
+#define VIRT(i) ((char *) 0x10000000 + (i) * 0x2000)
+#define PHYS(i) (0x50000000UL + (i) * 0x1000)
+
+/* A second mapping of the memory of several regions */
+#define ALIAS ((char *) 0x30000000)
+
+/* A region with a smaller one registered inside it */
+#define OUTER ((char *) 0x40000000)
+#define INNER (OUTER + 0x1000)
+
+static volatile int churn_stop;
+
+/* Add and remove the even regions, growing the table past its first size */
+static void *
+churn_thread (void * arg)
+{
+  int i;
+
+  while (!churn_stop) {
+    for (i = 0; i < NR_REGIONS; i += 2)
+      uiomux_register (VIRT(i), PHYS(i), 0x1000);
+    for (i = 0; i < NR_REGIONS; i += 2)
+      uiomux_unregister (VIRT(i));
+  }
+
+  return NULL;
+}
+
+int
+main (int argc, char *argv[])
+{
+  pthread_t churner;
+  struct uiomux_iovec iov[3];
+  struct uiomux_segment segs[8];
+  unsigned long phys;
+  char * virt;
+  int i, j, n;
+
+  INFO ("Registering %d regions", NR_REGIONS);
+  for (i = 0; i < NR_REGIONS; i++) {
+    j = (i * 37) % NR_REGIONS;
+    if (uiomux_register (VIRT(j), PHYS(j), 0x1000) != 0)
+      FAIL ("Registering region %d", j);
+  }
+
+  INFO ("Translating region edges");
+  for (i = 0; i < NR_REGIONS; i++) {
+    if ((phys = uiomux_all_virt_to_phys (VIRT(i))) != PHYS(i))
+      FAIL ("Start of region %d: got 0x%lx", i, phys);
+    if ((phys = uiomux_all_virt_to_phys (VIRT(i) + 0xfff)) != PHYS(i) + 0xfff)
+      FAIL ("End of region %d: got 0x%lx", i, phys);
+    if ((phys = uiomux_all_virt_to_phys (VIRT(i) + 0x1000)) != 0)
+      FAIL ("Past region %d: got 0x%lx", i, phys);
+  }
+  if (uiomux_all_virt_to_phys (VIRT(0) - 1) != 0)
+    FAIL ("Below the first region");
+
+  INFO ("Translating physical addresses back");
+  for (i = 0; i < NR_REGIONS; i++) {
+    if (uiomux_all_phys_to_virt (PHYS(i) + 0x123) != VIRT(i) + 0x123)
+      FAIL ("Physical address in region %d", i);
+  }
+  if (uiomux_all_phys_to_virt (PHYS(NR_REGIONS)) != NULL)
+    FAIL ("Physical address past the last region");
+
+  INFO ("Translating through overlapping physical regions");
+  if (uiomux_register (ALIAS, PHYS(10), 0x4000) != 0)
+    FAIL ("Registering alias over regions 10 to 13");
+  for (i = 10; i < 14; i++) {
+    virt = uiomux_all_phys_to_virt (PHYS(i) + 0x10);
+    if (virt != VIRT(i) + 0x10 && virt != ALIAS + (i - 10) * 0x1000 + 0x10)
+      FAIL ("Physical address in region %d with alias", i);
+  }
+  uiomux_unregister (ALIAS);
+  for (i = 10; i < 14; i++) {
+    if (uiomux_all_phys_to_virt (PHYS(i)) != VIRT(i))
+      FAIL ("Physical address in region %d after alias removed", i);
+  }
+
+  INFO ("Translating ranges to segments");
+  iov[0].virt = VIRT(3) + 0x800;	/* region 3, gap, region 4 */
+  iov[0].len = 0x2000;
+  iov[1].virt = VIRT(0) - 0x100;	/* below all regions */
+  iov[1].len = 0x80;
+  iov[2].virt = VIRT(7);		/* empty */
+  iov[2].len = 0;
+  n = uiomux_all_virt_to_phys_sg (iov, 3, segs, 8);
+  if (n != 4)
+    FAIL ("Expected 4 segments, got %d", n);
+  if (segs[0].phys != PHYS(3) + 0x800 || segs[0].len != 0x800 ||
+      segs[0].gap || segs[0].index != 0)
+    FAIL ("Segment 0 in region 3");
+  if (segs[1].phys != 0 || segs[1].len != 0x1000 || !segs[1].gap ||
+      segs[1].index != 0)
+    FAIL ("Segment 1 in gap after region 3");
+  if (segs[2].phys != PHYS(4) || segs[2].len != 0x800 || segs[2].gap ||
+      segs[2].index != 0)
+    FAIL ("Segment 2 in region 4");
+  if (segs[3].len != 0x80 || !segs[3].gap || segs[3].index != 1)
+    FAIL ("Segment 3 below all regions");
+
+  INFO ("Splitting a range at a region boundary");
+  if (uiomux_register (VIRT(5) + 0x1000, 0x60000000, 0x1000) != 0)
+    FAIL ("Registering region after region 5");
+  iov[0].virt = VIRT(5) + 0x100;
+  iov[0].len = 0x1f00;
+  n = uiomux_all_virt_to_phys_sg (iov, 1, segs, 8);
+  if (n != 2 || segs[0].phys != PHYS(5) + 0x100 || segs[0].len != 0xf00 ||
+      segs[1].phys != 0x60000000 || segs[1].len != 0x1000 ||
+      segs[0].gap || segs[1].gap)
+    FAIL ("Range across regions 5 and its neighbour");
+  uiomux_unregister (VIRT(5) + 0x1000);
+
+  iov[0].virt = VIRT(3) + 0x800;
+  iov[0].len = 0x2000;
+  if (uiomux_all_virt_to_phys_sg (iov, 1, segs, 2) != -1 || errno != ENOSPC)
+    FAIL ("Translating into too few segments");
+
+  INFO ("Translating ranges through overlapping regions");
+  if (uiomux_register (OUTER, 0x70000000, 0x10000) != 0 ||
+      uiomux_register (INNER, 0x78000000, 0x1000) != 0)
+    FAIL ("Registering a region inside another");
+  iov[0].virt = OUTER + 0x5000;		/* past the inner region */
+  iov[0].len = 0x100;
+  n = uiomux_all_virt_to_phys_sg (iov, 1, segs, 8);
+  if (n != 1 || segs[0].gap || segs[0].phys != 0x70005000 ||
+      segs[0].len != 0x100)
+    FAIL ("Range in the outer region past the inner one");
+  iov[0].virt = OUTER;
+  iov[0].len = 0x10000;
+  n = uiomux_all_virt_to_phys_sg (iov, 1, segs, 8);
+  if (n != 3 || segs[0].phys != 0x70000000 || segs[0].len != 0x1000 ||
+      segs[1].phys != 0x78000000 || segs[1].len != 0x1000 ||
+      segs[2].phys != 0x70002000 || segs[2].len != 0xe000 ||
+      segs[0].gap || segs[1].gap || segs[2].gap)
+    FAIL ("Range across the outer and inner regions");
+  if (uiomux_unregister (INNER) != 0 || uiomux_unregister (OUTER) != 0)
+    FAIL ("Unregistering overlapping regions");
+
+  INFO ("Unregistering every other region");
+  for (i = 0; i < NR_REGIONS; i += 2) {
+    if (uiomux_unregister (VIRT(i) + 0x800) != 0)
+      FAIL ("Unregistering region %d", i);
+  }
+  if (uiomux_unregister (VIRT(0)) == 0)
+    FAIL ("Unregistering region 0 twice");
+
+  INFO ("Translating remaining regions");
+  for (i = 0; i < NR_REGIONS; i++) {
+    phys = uiomux_all_virt_to_phys (VIRT(i) + 0x10);
+    if (phys != ((i % 2) ? PHYS(i) + 0x10 : 0))
+      FAIL ("Region %d: got 0x%lx", i, phys);
+  }
+
+  INFO ("Translating while regions are added and removed");
+  if (pthread_create (&churner, NULL, churn_thread, NULL) != 0)
+    FAIL ("Creating churn thread");
+  for (j = 0; j < 200; j++) {
+    for (i = 1; i < NR_REGIONS; i += 2) {
+      phys = uiomux_all_virt_to_phys (VIRT(i) + 0x20);
+      if (phys != PHYS(i) + 0x20)
+        FAIL ("Region %d during changes: got 0x%lx", i, phys);
+    }
+  }
+  churn_stop = 1;
+  pthread_join (churner, NULL);
+
+  for (i = 1; i < NR_REGIONS; i += 2)
+    uiomux_unregister (VIRT(i));
+
+  exit (0);
+}
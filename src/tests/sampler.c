@@ -0,0 +1,96 @@
+/*
+ * UIOMux: a conflict manager for system resources, including UIO devices.
+ * Copyright (C) 2009 Renesas Technology Corp.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston MA  02110-1301 USA
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+#include <errno.h>
+#include <unistd.h>
+
+#include <uiomux/uiomux.h>
+
+#include "uiomux_tests.h"
+
+#define STATUS 0x20
+
+int
+main (int argc, char *argv[])
+{
+  UIOMux * uiomux;
+  struct uiomux_map_desc mmio;
+  struct uiomux_sample_reg reg = { UIOMUX_SH_VEU, STATUS, 0x1, 0x6 };
+  struct uiomux_samplestat stat;
+  uint32_t saved;
+  int i;
+
+  INFO ("Opening UIOMux for VEU");
+  uiomux = uiomux_open_blocks (UIOMUX_SH_VEU);
+  if (uiomux == NULL)
+    FAIL ("Opening UIOMux");
+
+  if (!uiomux_check_resource (uiomux, UIOMUX_SH_VEU)) {
+    INFO ("VEU not available, checking failure");
+    if (uiomux_set_sampler (uiomux, &reg, 1, 10000) != -1 || errno != EINVAL)
+      FAIL ("Sampling unmanaged resource");
+    if (uiomux_get_samplestat (uiomux, UIOMUX_SH_VEU, &stat) != -1)
+      FAIL ("Statistics of unsampled resource");
+    uiomux_close (uiomux);
+    exit (0);
+  }
+
+  INFO ("Sampling a bad offset");
+  reg.offset = 2;
+  if (uiomux_set_sampler (uiomux, &reg, 1, 10000) != -1 || errno != EINVAL)
+    FAIL ("Sampled a bad offset");
+  reg.offset = STATUS;
+
+  uiomux_get_mmio_desc (uiomux, UIOMUX_SH_VEU, &mmio);
+  saved = uiomux_reg_read (&mmio, STATUS);
+
+  INFO ("Sampling a status register busy half of the time");
+  if (uiomux_set_sampler (uiomux, &reg, 1, 10000) != 0)
+    FAIL ("Starting sampler");
+  for (i = 0; i < 10; i++) {
+    uiomux_reg_write (&mmio, STATUS, 0x3);	/* busy, state 1 */
+    usleep (20000);
+    uiomux_reg_write (&mmio, STATUS, 0x4);	/* idle, state 2 */
+    usleep (20000);
+  }
+
+  if (uiomux_get_samplestat (uiomux, UIOMUX_SH_VEU, &stat) != 0)
+    FAIL ("Getting statistics");
+  INFO ("%lu samples, %lu busy in %lu runs", stat.samples, stat.busy,
+        stat.busy_runs);
+  if (stat.samples < 100 || stat.busy < stat.samples / 5 ||
+      stat.busy > stat.samples * 4 / 5 || stat.busy_runs < 5)
+    FAIL ("Busy ratio not about half");
+  if (stat.states[1] + stat.states[2] + stat.states[3] != stat.samples)
+    FAIL ("States outside the written values");
+
+  INFO ("Stopping sampler");
+  if (uiomux_set_sampler (uiomux, NULL, 0, 0) != 0)
+    FAIL ("Stopping sampler");
+  if (uiomux_get_samplestat (uiomux, UIOMUX_SH_VEU, &stat) != -1)
+    FAIL ("Statistics after stopping");
+
+  uiomux_reg_write (&mmio, STATUS, saved);
+  uiomux_close (uiomux);
+
+  exit (0);
+}
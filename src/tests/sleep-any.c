@@ -0,0 +1,79 @@
+/*
+ * UIOMux: a conflict manager for system resources, including UIO devices.
+ * Copyright (C) 2009 Renesas Technology Corp.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston MA  02110-1301 USA
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <stdio.h>
+#include <time.h>
+
+#include <uiomux/uiomux.h>
+
+#include "uiomux_tests.h"
+
+int
+main (int argc, char *argv[])
+{
+  UIOMux * uiomux;
+  uiomux_resource_t blocks, fired;
+  struct timespec deadline;
+  int i, ret;
+
+  INFO ("Opening UIOMux for VEU and BEU");
+  uiomux = uiomux_open_blocks (UIOMUX_SH_VEU | UIOMUX_SH_BEU);
+  if (uiomux == NULL)
+    FAIL ("Opening UIOMux");
+
+  blocks = uiomux_check_resource (uiomux, UIOMUX_SH_VEU | UIOMUX_SH_BEU);
+  if (blocks == UIOMUX_NONE) {
+    INFO ("Neither VEU nor BEU available, checking failure");
+    if (uiomux_sleep_any (uiomux, UIOMUX_SH_VEU | UIOMUX_SH_BEU,
+                          NULL, &fired) != -1)
+      FAIL ("Waiting on no managed blocks succeeded");
+    uiomux_close (uiomux);
+    exit (0);
+  }
+
+  clock_gettime (CLOCK_MONOTONIC, &deadline);
+  deadline.tv_nsec += 100000000;
+  if (deadline.tv_nsec >= 1000000000) {
+    deadline.tv_sec++;
+    deadline.tv_nsec -= 1000000000;
+  }
+
+  INFO ("uiomux_sleep_any-ing with a deadline 100 ms from now");
+  if (uiomux_sleep_any (uiomux, blocks, &deadline, &fired) < 0) {
+    INFO ("Woken up after deadline (or other error)");
+  } else {
+    if (fired == UIOMUX_NONE || (fired & ~blocks))
+      FAIL ("Unexpected blocks fired: 0x%x", fired);
+    for (i = 0; i < 16; i++) {
+      if (fired & (1<<i))
+        INFO ("Woken up due to %s event", uiomux_name (1<<i));
+    }
+  }
+
+  INFO ("Closing UIOMux");
+  ret = uiomux_close (uiomux);
+  if (ret != 0)
+    FAIL ("Closing UIOMux");
+
+  exit (0);
+}
@@ -0,0 +1,102 @@
+/*
+ * UIOMux: a conflict manager for system resources, including UIO devices.
+ * Copyright (C) 2009 Renesas Technology Corp.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston MA  02110-1301 USA
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <string.h>
+#include <unistd.h>
+
+#include <uiomux/uiomux.h>
+
+#include "uiomux_tests.h"
+
+#define SNAPSHOT_FILE "snapshot-test.bin"
+
+int
+main (int argc, char *argv[])
+{
+  UIOMux * uiomux;
+  struct uiomux_snapshot * a, * b;
+  struct uiomux_reg_change changes[4];
+  volatile uint32_t * regs;
+  size_t size;
+  FILE * fp;
+  int n;
+
+  INFO ("Opening UIOMux for VEU");
+  uiomux = uiomux_open_blocks (UIOMUX_SH_VEU);
+  if (uiomux == NULL)
+    FAIL ("Opening UIOMux");
+
+  if (!uiomux_check_resource (uiomux, UIOMUX_SH_VEU)) {
+    INFO ("VEU not available, checking failure");
+    if (uiomux_snapshot_size (uiomux, UIOMUX_SH_VEU) != 0)
+      FAIL ("Snapshot size of unmanaged resource");
+    uiomux_close (uiomux);
+    exit (0);
+  }
+
+  size = uiomux_snapshot_size (uiomux, UIOMUX_SH_VEU);
+  a = malloc (size);
+  b = malloc (size);
+  if (size == 0 || a == NULL || b == NULL)
+    FAIL ("Allocating snapshots");
+
+  INFO ("Taking two snapshots around a register write");
+  uiomux_get_mmio (uiomux, UIOMUX_SH_VEU, NULL, NULL, (void **) &regs);
+  if (uiomux_snapshot_mmio (uiomux, UIOMUX_SH_VEU, a, size - 1) != -1)
+    FAIL ("Snapshot into a short buffer succeeded");
+  if (uiomux_snapshot_mmio (uiomux, UIOMUX_SH_VEU, a, size) != 0)
+    FAIL ("Taking first snapshot");
+  regs[2] = ~regs[2];
+  if (uiomux_snapshot_mmio (uiomux, UIOMUX_SH_VEU, b, size) != 0)
+    FAIL ("Taking second snapshot");
+  regs[2] = ~regs[2];
+
+  INFO ("Comparing snapshots");
+  n = uiomux_snapshot_diff (a, b, changes, 4);
+  if (n != 1 || changes[0].offset != 8 ||
+      changes[0].new_value != ~changes[0].old_value)
+    FAIL ("Expected one change at offset 8, got %d", n);
+  if (uiomux_snapshot_diff (a, a, changes, 4) != 0)
+    FAIL ("Snapshot differs from itself");
+  b->address++;
+  if (uiomux_snapshot_diff (a, b, changes, 4) != -1)
+    FAIL ("Comparing snapshots of different regions succeeded");
+
+  INFO ("Writing a snapshot file");
+  if (uiomux_snapshot_mmio_filename (uiomux, UIOMUX_SH_VEU, "%s",
+                                     SNAPSHOT_FILE) != 0)
+    FAIL ("Writing snapshot file");
+  if ((fp = fopen (SNAPSHOT_FILE, "r")) == NULL ||
+      fread (b, 1, size, fp) != size || fgetc (fp) != EOF)
+    FAIL ("Reading back snapshot file");
+  fclose (fp);
+  unlink (SNAPSHOT_FILE);
+  if (uiomux_snapshot_diff (a, b, changes, 4) != 0)
+    FAIL ("Snapshot file differs from snapshot");
+
+  free (a);
+  free (b);
+  uiomux_close (uiomux);
+
+  exit (0);
+}
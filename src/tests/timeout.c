@@ -23,6 +23,7 @@
 
 #include <stdio.h>
 #include <sys/time.h>
+#include <time.h>
 
 #include <uiomux/uiomux.h>
 
@@ -39,6 +40,7 @@ main() {
 	unsigned long veu_phys_memory_base;
 	int i;
 	struct timeval tval;
+	struct timespec deadline;
 
 	tval.tv_sec = 5;
 	tval.tv_usec = 0;
@@ -56,5 +58,15 @@ main() {
 		INFO ("Woken up due to VEU event");
 	}
 
+	clock_gettime (CLOCK_MONOTONIC, &deadline);
+	deadline.tv_sec += 1;
+
+	INFO ("uiomux_sleep-ing with a deadline 1 sec from now");
+	if (uiomux_sleep_deadline(uiomux, UIOMUX_SH_VEU, &deadline) < 0) {
+		INFO ("Woken up after deadline (or other error)");
+	} else {
+		INFO ("Woken up due to VEU event");
+	}
+
 	return 0;
 }
@@ -0,0 +1,132 @@
+/*
+ * UIOMux: a conflict manager for system resources, including UIO devices.
+ * Copyright (C) 2009 Renesas Technology Corp.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston MA  02110-1301 USA
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+#define UIOMUX_TRACE
+
+#include <string.h>
+#include <unistd.h>
+#include <pthread.h>
+
+#include <uiomux/uiomux.h>
+
+#include "uiomux_tests.h"
+
+#define TRACE_FILE "trace-test.bin"
+
+#define NR_WRITES 100
+
+/* A register file in ordinary memory, at a made-up physical address */
+static uint32_t regs[16];
+static struct uiomux_map_desc mmio = { regs, 0xfe920000, sizeof (regs) };
+
+static void *
+writer (void * arg)
+{
+  unsigned long offset = (unsigned long) arg;
+  int i;
+
+  for (i = 0; i < NR_WRITES; i++)
+    uiomux_reg_write (&mmio, offset, uiomux_reg_read (&mmio, offset) + 1);
+
+  return NULL;
+}
+
+static struct uiomux_trace_entry *
+load (struct uiomux_trace_header * header)
+{
+  struct uiomux_trace_entry * entries;
+  FILE * fp;
+
+  if ((fp = fopen (TRACE_FILE, "r")) == NULL)
+    FAIL ("Opening trace file");
+  if (fread (header, sizeof (*header), 1, fp) != 1 ||
+      header->magic != UIOMUX_TRACE_MAGIC)
+    FAIL ("Reading trace header");
+  entries = malloc ((header->count + 1) * sizeof (*entries));
+  if (fread (entries, sizeof (*entries), header->count, fp) != header->count)
+    FAIL ("Reading trace entries");
+  fclose (fp);
+
+  return entries;
+}
+
+int
+main (int argc, char *argv[])
+{
+  struct uiomux_trace_header header;
+  struct uiomux_trace_entry * entries;
+  pthread_t threads[2];
+  uint32_t i, count[2] = { 0, 0 };
+
+  INFO ("Accessing registers before tracing");
+  uiomux_reg_write (&mmio, 0, 0x1234);
+  if (regs[0] != 0x1234 || uiomux_reg_read (&mmio, 0) != 0x1234)
+    FAIL ("Register access");
+
+  INFO ("Tracing register accesses of two threads");
+  if (uiomux_trace_start (0) != 0)
+    FAIL ("Starting trace");
+  pthread_create (&threads[0], NULL, writer, (void *) 4);
+  pthread_create (&threads[1], NULL, writer, (void *) 8);
+  pthread_join (threads[0], NULL);
+  pthread_join (threads[1], NULL);
+  uiomux_trace_stop ();
+  uiomux_reg_write (&mmio, 0, 0);
+
+  if (uiomux_trace_save (TRACE_FILE) != 4 * NR_WRITES)
+    FAIL ("Saving trace");
+
+  INFO ("Checking trace");
+  entries = load (&header);
+  if (header.count != 4 * NR_WRITES || header.dropped != 0)
+    FAIL ("Trace has %u entries, %u dropped", header.count, header.dropped);
+  for (i = 0; i < header.count; i++) {
+    if (i > 0 && entries[i].time_ns < entries[i-1].time_ns)
+      FAIL ("Entry %u out of order", i);
+    if (entries[i].address != 0xfe920004 && entries[i].address != 0xfe920008)
+      FAIL ("Entry %u has address 0x%llx", i,
+            (unsigned long long) entries[i].address);
+    /* Each thread reads the value it wrote last */
+    if (entries[i].op == UIOMUX_TRACE_WRITE)
+      if (entries[i].value != ++count[(entries[i].address >> 2) & 1])
+        FAIL ("Entry %u wrote %u", i, entries[i].value);
+  }
+  if (count[0] != NR_WRITES || count[1] != NR_WRITES)
+    FAIL ("Missing writes");
+  free (entries);
+
+  INFO ("Overflowing a short ring buffer");
+  uiomux_trace_start (8);
+  writer ((void *) 12);
+  uiomux_trace_stop ();
+  if (uiomux_trace_save (TRACE_FILE) != 8)
+    FAIL ("Saving short trace");
+  entries = load (&header);
+  if (header.dropped != 2 * NR_WRITES - 8 ||
+      entries[7].value != NR_WRITES || entries[7].op != UIOMUX_TRACE_WRITE)
+    FAIL ("Short trace kept the wrong entries");
+  free (entries);
+
+  unlink (TRACE_FILE);
+
+  exit (0);
+}
@@ -0,0 +1,107 @@
+/*
+ * UIOMux: a conflict manager for system resources, including UIO devices.
+ * Copyright (C) 2009 Renesas Technology Corp.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston MA  02110-1301 USA
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <uiomux/uiomux.h>
+
+#include "uiomux_tests.h"
+
+/* Check a descriptor against the out-of-line translation functions */
+static void
+check_desc (UIOMux * uiomux, uiomux_resource_t resource,
+            const char * what, struct uiomux_map_desc * desc)
+{
+  char * virt = (char *) desc->virt;
+  void * any;
+  unsigned long i;
+
+  INFO ("Checking %s descriptor of %s", what, uiomux_name (resource));
+  for (i = 0; i < desc->size; i += desc->size / 4 ? desc->size / 4 : 1) {
+    if (uiomux_desc_virt_to_phys (desc, virt + i) !=
+        uiomux_virt_to_phys (uiomux, resource, virt + i))
+      FAIL ("virt_to_phys at offset 0x%lx", i);
+    if (uiomux_desc_phys_to_virt (desc, desc->phys + i) !=
+        uiomux_phys_to_virt (uiomux, resource, desc->phys + i))
+      FAIL ("phys_to_virt at offset 0x%lx", i);
+    any = uiomux_all_phys_to_virt (desc->phys + i);
+    if (any == NULL ||
+        uiomux_virt_to_phys (uiomux, resource, any) != desc->phys + i)
+      FAIL ("all_phys_to_virt at offset 0x%lx", i);
+  }
+}
+
+int
+main (int argc, char *argv[])
+{
+  UIOMux * uiomux;
+  struct uiomux_map_desc desc;
+  char * base = (char *) 0x20000000;
+  int ret;
+
+  INFO ("Translating with a constructed descriptor");
+  desc.virt = base;
+  desc.phys = 0x48000000;
+  desc.size = 0x1000;
+  if (uiomux_desc_virt_to_phys (&desc, base) != 0x48000000)
+    FAIL ("Start of region");
+  if (uiomux_desc_virt_to_phys (&desc, base + 0xfff) != 0x48000fff)
+    FAIL ("End of region");
+  if (uiomux_desc_virt_to_phys (&desc, base + 0x1000) != 0)
+    FAIL ("Past end of region");
+  if (uiomux_desc_virt_to_phys (&desc, base - 1) != 0)
+    FAIL ("Below start of region");
+  if (uiomux_desc_phys_to_virt (&desc, 0x48000800) != base + 0x800)
+    FAIL ("Physical address within region");
+  if (uiomux_desc_phys_to_virt (&desc, 0x48001000) != NULL)
+    FAIL ("Physical address past end of region");
+  if (uiomux_desc_phys_to_virt (&desc, 0x47ffffff) != NULL)
+    FAIL ("Physical address below region");
+
+  INFO ("Opening UIOMux for VEU");
+  uiomux = uiomux_open_blocks (UIOMUX_SH_VEU);
+  if (uiomux == NULL)
+    FAIL ("Opening UIOMux");
+
+  if (!uiomux_check_resource (uiomux, UIOMUX_SH_VEU)) {
+    INFO ("VEU not available, checking failure");
+    if (uiomux_get_mem_desc (uiomux, UIOMUX_SH_VEU, &desc) != -1)
+      FAIL ("Getting descriptor of unmanaged resource succeeded");
+  } else {
+    if (uiomux_get_mem_desc (uiomux, UIOMUX_SH_VEU, &desc) != 0)
+      FAIL ("Getting memory descriptor");
+    check_desc (uiomux, UIOMUX_SH_VEU, "memory", &desc);
+    if (uiomux_get_mmio_desc (uiomux, UIOMUX_SH_VEU, &desc) != 0)
+      FAIL ("Getting MMIO descriptor");
+    check_desc (uiomux, UIOMUX_SH_VEU, "MMIO", &desc);
+  }
+
+  if (uiomux_get_mmio_desc (uiomux, UIOMUX_SH_VEU | UIOMUX_SH_BEU,
+                            &desc) != -1)
+    FAIL ("Getting descriptor of more than one resource succeeded");
+
+  INFO ("Closing UIOMux");
+  ret = uiomux_close (uiomux);
+  if (ret != 0)
+    FAIL ("Closing UIOMux");
+
+  exit (0);
+}
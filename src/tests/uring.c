@@ -0,0 +1,181 @@
+/*
+ * UIOMux: a conflict manager for system resources, including UIO devices.
+ * Copyright (C) 2009 Renesas Technology Corp.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston MA  02110-1301 USA
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <errno.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/eventfd.h>
+
+#include <uiomux/uiomux.h>
+
+#include "uiomux_tests.h"
+
+/* Transfers a handle may have in flight */
+#define IO_MAX 32
+
+static void
+deadline_in_ms (struct timespec * deadline, long ms)
+{
+  clock_gettime (CLOCK_MONOTONIC, deadline);
+  deadline->tv_sec += ms / 1000;
+  deadline->tv_nsec += (ms % 1000) * 1000000;
+  if (deadline->tv_nsec >= 1000000000) {
+    deadline->tv_sec++;
+    deadline->tv_nsec -= 1000000000;
+  }
+}
+
+int
+main (int argc, char *argv[])
+{
+  UIOMux * uiomux;
+  uiomux_resource_t blocks, fired;
+  struct uiomux_io io[4], many[IO_MAX * 2];
+  struct timespec deadline;
+  char filename[] = "/tmp/uiomux-uring-XXXXXX";
+  char filename2[] = "/tmp/uiomux-uring-XXXXXX";
+  int tags[IO_MAX], seen[IO_MAX];
+  char buf[16];
+  uint64_t value = 0;
+  int fd, efd, ret, round, i, k, n;
+
+  INFO ("Opening UIOMux for VEU and BEU");
+  uiomux = uiomux_open_blocks (UIOMUX_SH_VEU | UIOMUX_SH_BEU);
+  if (uiomux == NULL)
+    FAIL ("Opening UIOMux");
+
+  if (uiomux_set_engine (uiomux, 42) != -1)
+    FAIL ("Setting an unknown engine succeeded");
+
+  INFO ("Selecting the io_uring engine");
+  if (uiomux_set_engine (uiomux, UIOMUX_ENGINE_URING) != UIOMUX_ENGINE_URING) {
+    INFO ("io_uring not available, checking fallback");
+    if (uiomux_io_read (uiomux, 0, buf, sizeof (buf), 0, NULL) != -1 ||
+        errno != ENOSYS)
+      FAIL ("Buffer read without io_uring did not fail with ENOSYS");
+    uiomux_close (uiomux);
+    exit (0);
+  }
+
+  INFO ("Writing and reading back a file");
+  if ((fd = mkstemp (filename)) < 0)
+    FAIL ("Creating temporary file");
+  unlink (filename);
+
+  if (uiomux_io_write (uiomux, fd, "UIOMux", 7, 0, &fd) != 0)
+    FAIL ("Starting write");
+  if (uiomux_io_wait (uiomux, UIOMUX_NONE, NULL, NULL, io, 4) != 1)
+    FAIL ("Waiting for write");
+  if (io[0].user_data != &fd || io[0].result != 7)
+    FAIL ("Write completed with %ld", io[0].result);
+
+  memset (buf, 0, sizeof (buf));
+  if (uiomux_io_read (uiomux, fd, buf, sizeof (buf), 0, buf) != 0)
+    FAIL ("Starting read");
+  if (uiomux_io_wait (uiomux, UIOMUX_NONE, NULL, NULL, io, 4) != 1)
+    FAIL ("Waiting for read");
+  if (io[0].user_data != buf || io[0].result != 7 || strcmp (buf, "UIOMux"))
+    FAIL ("Read completed with %ld", io[0].result);
+  close (fd);
+
+  INFO ("Reading an eventfd across a timed out wait");
+  if ((efd = eventfd (0, 0)) < 0)
+    FAIL ("Creating eventfd");
+
+  if (uiomux_io_read (uiomux, efd, &value, sizeof (value), -1, &efd) != 0)
+    FAIL ("Starting eventfd read");
+
+  deadline_in_ms (&deadline, 20);
+  if (uiomux_io_wait (uiomux, UIOMUX_NONE, &deadline, NULL, io, 4) != -1)
+    FAIL ("Wait returned before the eventfd was written");
+
+  if (eventfd_write (efd, 3) < 0)
+    FAIL ("Writing eventfd");
+
+  deadline_in_ms (&deadline, 1000);
+  ret = uiomux_io_wait (uiomux, UIOMUX_NONE, &deadline, NULL, io, 4);
+  if (ret != 1 || io[0].user_data != &efd || io[0].result != 8 || value != 3)
+    FAIL ("Eventfd read completed with %ld", ret == 1 ? io[0].result : 0L);
+  close (efd);
+
+  blocks = uiomux_check_resource (uiomux, UIOMUX_SH_VEU | UIOMUX_SH_BEU);
+  if (blocks != UIOMUX_NONE) {
+    INFO ("Waking up a sleep through the ring");
+    uiomux_wakeup (uiomux, blocks & UIOMUX_SH_VEU ? UIOMUX_SH_VEU : UIOMUX_SH_BEU);
+    if (uiomux_sleep_any (uiomux, blocks, NULL, &fired) != -1)
+      FAIL ("Sleep was not woken up");
+
+    deadline_in_ms (&deadline, 20);
+    if (uiomux_io_wait (uiomux, blocks, &deadline, &fired, io, 4) == 0)
+      INFO ("Woken up by interrupt: 0x%x", fired);
+
+    INFO ("Reaping more transfers than fit in flight across sleeps");
+    if ((fd = mkstemp (filename2)) < 0)
+      FAIL ("Creating temporary file");
+    unlink (filename2);
+
+    for (round = 0; round < 3; round++) {
+      for (i = 0; i < IO_MAX; i++) {
+        if (uiomux_io_write (uiomux, fd, "x", 1, round * IO_MAX + i,
+                             &tags[i]) != 0)
+          FAIL ("Starting write %d of round %d", i, round);
+      }
+
+      /* Sleeps reap the completions without returning them */
+      for (i = 0; i < 3; i++) {
+        deadline_in_ms (&deadline, 10);
+        uiomux_sleep_any (uiomux, blocks, &deadline, &fired);
+      }
+
+      if (uiomux_io_write (uiomux, fd, "x", 1, 0, NULL) != -1 ||
+          errno != EAGAIN)
+        FAIL ("Write started while all slots await collection");
+
+      memset (seen, 0, sizeof (seen));
+      for (n = 0; n < IO_MAX; n += ret) {
+        deadline_in_ms (&deadline, 1000);
+        ret = uiomux_io_wait (uiomux, UIOMUX_NONE, &deadline, NULL,
+                              many, IO_MAX * 2);
+        if (ret <= 0 || n + ret > IO_MAX)
+          FAIL ("Collected %d + %d writes of round %d", n, ret, round);
+        for (i = 0; i < ret; i++) {
+          k = (int *) many[i].user_data - tags;
+          if (k < 0 || k >= IO_MAX || seen[k] || many[i].result != 1)
+            FAIL ("Bad completion %d of round %d", k, round);
+          seen[k] = 1;
+        }
+      }
+    }
+    close (fd);
+  }
+
+  INFO ("Closing UIOMux");
+  ret = uiomux_close (uiomux);
+  if (ret != 0)
+    FAIL ("Closing UIOMux");
+
+  exit (0);
+}
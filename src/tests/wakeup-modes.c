@@ -0,0 +1,184 @@
+/*
+ * UIOMux: a conflict manager for system resources, including UIO devices.
+ * Copyright (C) 2009 Renesas Technology Corp.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston MA  02110-1301 USA
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <stdio.h>
+#include <time.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sys/socket.h>
+
+#include <uiomux/uiomux.h>
+
+#include "uiomux_tests.h"
+
+#define SLEEPERS 3
+
+static UIOMux * uiomux;
+static uiomux_resource_t resource;
+static volatile int woken[SLEEPERS];
+
+static void *
+sleeper (void * arg)
+{
+  int i = (int)(long)arg;
+
+  if (uiomux_sleep (uiomux, resource) < 0)
+    woken[i] = 1;
+  else
+    woken[i] = 2;
+
+  return NULL;
+}
+
+static int
+count_woken (void)
+{
+  int i, n = 0;
+
+  /* Give woken threads time to run */
+  usleep (50000);
+
+  for (i = 0; i < SLEEPERS; i++)
+    if (woken[i])
+      n++;
+
+  return n;
+}
+
+static int
+sleep_blocks (void)
+{
+  struct timespec deadline;
+
+  clock_gettime (CLOCK_MONOTONIC, &deadline);
+  deadline.tv_nsec += 10000000;
+  if (deadline.tv_nsec >= 1000000000) {
+    deadline.tv_sec++;
+    deadline.tv_nsec -= 1000000000;
+  }
+
+  return uiomux_sleep_deadline (uiomux, resource, &deadline) < 0;
+}
+
+static void
+test_modes (void)
+{
+  pthread_t threads[SLEEPERS];
+  struct timespec expired = {0, 0};
+  int i, ret;
+
+  INFO ("Checking that wakeups without a sleeper are kept once");
+  uiomux_wakeup (uiomux, resource);
+  uiomux_wakeup (uiomux, resource);
+  if (uiomux_sleep_deadline (uiomux, resource, &expired) != -1)
+    FAIL ("Pending wakeup was lost");
+  if (!sleep_blocks ())
+    FAIL ("Second wakeup was not coalesced with the first");
+
+  uiomux_wakeup_one (uiomux, resource);
+  if (uiomux_sleep_deadline (uiomux, resource, &expired) != -1)
+    FAIL ("Pending wakeup of one was lost");
+
+  INFO ("Starting %d sleepers", SLEEPERS);
+  for (i = 0; i < SLEEPERS; i++) {
+    woken[i] = 0;
+    pthread_create (&threads[i], NULL, sleeper, (void *)(long)i);
+    usleep (20000);
+  }
+
+  INFO ("Waking one sleeper");
+  uiomux_wakeup_one (uiomux, resource);
+  if ((ret = count_woken ()) != 1 || !woken[0])
+    FAIL ("uiomux_wakeup_one woke %d sleepers, not the oldest", ret);
+
+  INFO ("Waking the last sleeper by thread");
+  if (uiomux_wakeup_thread (uiomux, threads[SLEEPERS - 1]) != 0)
+    FAIL ("Waking a sleeping thread");
+  if ((ret = count_woken ()) != 2 || !woken[SLEEPERS - 1])
+    FAIL ("uiomux_wakeup_thread woke %d sleepers", ret - 1);
+
+  INFO ("Waking all remaining sleepers");
+  uiomux_wakeup (uiomux, resource);
+  if ((ret = count_woken ()) != SLEEPERS)
+    FAIL ("uiomux_wakeup left %d sleepers", SLEEPERS - ret);
+
+  for (i = 0; i < SLEEPERS; i++) {
+    pthread_join (threads[i], NULL);
+    if (woken[i] != 1)
+      FAIL ("Sleeper %d returned an interrupt", i);
+  }
+
+  if (!sleep_blocks ())
+    FAIL ("Wakeup of sleepers was kept for a later sleep");
+}
+
+int
+main (int argc, char *argv[])
+{
+  int sv[2];
+  int ret;
+
+  INFO ("Opening UIOMux for VEU and BEU");
+  uiomux = uiomux_open_blocks (UIOMUX_SH_VEU | UIOMUX_SH_BEU);
+  if (uiomux == NULL)
+    FAIL ("Opening UIOMux");
+
+  if (uiomux_wakeup_thread (uiomux, pthread_self ()) != -1)
+    FAIL ("Waking a thread which is not sleeping succeeded");
+
+  resource = uiomux_check_resource (uiomux, UIOMUX_SH_VEU) ? UIOMUX_SH_VEU :
+             uiomux_check_resource (uiomux, UIOMUX_SH_BEU) ? UIOMUX_SH_BEU :
+             UIOMUX_NONE;
+  if (resource == UIOMUX_NONE) {
+    INFO ("Neither VEU nor BEU available, checking failure");
+    if (uiomux_wakeup_one (uiomux, UIOMUX_SH_VEU) != -1)
+      FAIL ("Waking an unmanaged block succeeded");
+    uiomux_close (uiomux);
+    exit (0);
+  }
+
+  /* A device which is always readable (such as a file standing in for
+     it) never lets a sleep block; swap in a socket which never is */
+  if (!sleep_blocks ()) {
+    INFO ("%s does not block, replacing its interrupt fd",
+          uiomux_name (resource));
+    if (socketpair (AF_UNIX, SOCK_STREAM, 0, sv) < 0 ||
+        dup2 (sv[0], uiomux_get_irq_fd (uiomux, resource)) < 0)
+      FAIL ("Replacing interrupt fd");
+  }
+
+  INFO ("Testing wakeups with ppoll()");
+  test_modes ();
+
+  if (uiomux_set_engine (uiomux, UIOMUX_ENGINE_URING) == UIOMUX_ENGINE_URING) {
+    INFO ("Testing wakeups with io_uring");
+    test_modes ();
+  }
+
+  INFO ("Closing UIOMux");
+  ret = uiomux_close (uiomux);
+  if (ret != 0)
+    FAIL ("Closing UIOMux");
+
+  exit (0);
+}
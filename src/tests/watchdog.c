@@ -0,0 +1,106 @@
+/*
+ * UIOMux: a conflict manager for system resources, including UIO devices.
+ * Copyright (C) 2009 Renesas Technology Corp.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston MA  02110-1301 USA
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <errno.h>
+#include <stdio.h>
+#include <unistd.h>
+
+#include <uiomux/uiomux.h>
+
+#include "uiomux_tests.h"
+
+static volatile int tripped = 0;
+static int set_errno = 0;
+static int close_errno = 0;
+
+static void
+watchdog_cb (UIOMux * uiomux, uiomux_resource_t resource, pid_t pid,
+             pid_t tid, unsigned long held_ms, void * user_data)
+{
+  INFO ("%s held for %lu ms by pid %d tid %d", uiomux_name (resource),
+        held_ms, pid, tid);
+
+  /* The watchdog cannot be replaced, nor the handle closed, from its own
+     thread */
+  if (tripped++ == 0) {
+    if (uiomux_set_watchdog (uiomux, resource, 10, NULL, NULL) == -1)
+      set_errno = errno;
+    if (uiomux_close (uiomux) == -1)
+      close_errno = errno;
+  }
+}
+
+int
+main (int argc, char *argv[])
+{
+  UIOMux * uiomux;
+  struct uiomux_lockstat stat;
+  int ret;
+
+  INFO ("Opening UIOMux for BEU");
+  uiomux = uiomux_open ();
+  if (uiomux == NULL)
+    FAIL ("Opening UIOMux");
+
+  if (!uiomux_check_resource (uiomux, UIOMUX_SH_BEU)) {
+    INFO ("BEU not available, skipping");
+    uiomux_close (uiomux);
+    exit (0);
+  }
+
+  INFO ("Setting a 50 ms watchdog");
+  if (uiomux_set_watchdog (uiomux, UIOMUX_SH_BEU, 50, watchdog_cb, NULL) < 0) {
+    INFO ("Shared state not available, skipping");
+    uiomux_close (uiomux);
+    exit (0);
+  }
+
+  uiomux_lock (uiomux, UIOMUX_SH_BEU);
+  INFO ("Locked, holding for 200 ms");
+
+  if (uiomux_get_lockstat (uiomux, UIOMUX_SH_BEU, &stat) < 0)
+    FAIL ("Getting lock statistics");
+  if (stat.holder_pid != getpid ())
+    FAIL ("Holder is pid %d", stat.holder_pid);
+
+  usleep (200000);
+  uiomux_unlock (uiomux, UIOMUX_SH_BEU);
+  INFO ("Unlocked");
+
+  if (tripped != 1)
+    FAIL ("Watchdog tripped %d times", tripped);
+  if (set_errno != EDEADLK || close_errno != EDEADLK)
+    FAIL ("Watchdog changed from its callback");
+
+  if (uiomux_get_lockstat (uiomux, UIOMUX_SH_BEU, &stat) < 0)
+    FAIL ("Getting lock statistics");
+  if (stat.holder_pid != 0)
+    FAIL ("Holder still set after unlock");
+
+  INFO ("Closing UIOMux");
+  ret = uiomux_close (uiomux);
+  if (ret != 0)
+    FAIL ("Closing UIOMux");
+
+  exit (0);
+}
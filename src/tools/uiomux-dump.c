@@ -0,0 +1,124 @@
+/*
+ * UIOMux: a conflict manager for system resources, including UIO devices.
+ * Copyright (C) 2009 Renesas Technology Corp.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston MA  02110-1301 USA
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+
+#include <uiomux/uiomux.h>
+
+/* Read and check a snapshot file written by uiomux_snapshot_mmio_filename() */
+static struct uiomux_snapshot *
+load_snapshot (const char * path)
+{
+  struct uiomux_snapshot * snap;
+  FILE * fp;
+  long size;
+
+  if ((fp = fopen (path, "r")) == NULL) {
+    fprintf (stderr, "uiomux: %s: %s\n", path, strerror (errno));
+    return NULL;
+  }
+
+  fseek (fp, 0, SEEK_END);
+  size = ftell (fp);
+  rewind (fp);
+
+  if (size < (long) sizeof (*snap) || (snap = malloc (size)) == NULL ||
+      fread (snap, 1, size, fp) != (size_t) size) {
+    fprintf (stderr, "uiomux: %s: unable to read snapshot\n", path);
+    fclose (fp);
+    return NULL;
+  }
+  fclose (fp);
+
+  if (snap->magic != UIOMUX_SNAPSHOT_MAGIC ||
+      snap->version != UIOMUX_SNAPSHOT_VERSION ||
+      sizeof (*snap) + snap->size > (size_t) size) {
+    fprintf (stderr, "uiomux: %s: not a version %d snapshot\n", path,
+             UIOMUX_SNAPSHOT_VERSION);
+    free (snap);
+    return NULL;
+  }
+
+  return snap;
+}
+
+static void
+print_header (const char * path, struct uiomux_snapshot * snap)
+{
+  const char * name = uiomux_name (snap->resource);
+
+  printf ("%s: %s registers at 0x%08llx, %u bytes, taken at %llu.%09llu\n",
+          path, name ? name : "?", (unsigned long long) snap->address,
+          snap->size, (unsigned long long) snap->time_ns / 1000000000,
+          (unsigned long long) snap->time_ns % 1000000000);
+}
+
+void
+dump (int argc, char *argv[])
+{
+  struct uiomux_snapshot * a, * b;
+  struct uiomux_reg_change * changes;
+  int i, n;
+
+  if (argc < 3) {
+    fprintf (stderr, "Usage: uiomux dump <snapshot> [<later snapshot>]\n");
+    exit (1);
+  }
+
+  if ((a = load_snapshot (argv[2])) == NULL)
+    exit (1);
+  print_header (argv[2], a);
+
+  /* One snapshot: all registers, as uiomux_dump_mmio() prints them */
+  if (argc < 4) {
+    for (i = 0; i < (int) (a->size / 4); i++)
+      printf ("%04x:\t%08x\n", i * 4, a->regs[i]);
+    free (a);
+    return;
+  }
+
+  /* Two snapshots: only the registers which changed */
+  if ((b = load_snapshot (argv[3])) == NULL)
+    exit (1);
+  print_header (argv[3], b);
+
+  changes = malloc ((a->size / 4) * sizeof (*changes));
+  if (changes == NULL || (n = uiomux_snapshot_diff (a, b, changes,
+                                                    a->size / 4)) < 0) {
+    fprintf (stderr, "uiomux: snapshots are not of the same registers\n");
+    exit (1);
+  }
+
+  printf ("%d registers changed in %.3f ms\n", n,
+          (double) (int64_t) (b->time_ns - a->time_ns) / 1e6);
+  for (i = 0; i < n; i++)
+    printf ("%04x:\t%08x -> %08x\n", changes[i].offset,
+            changes[i].old_value, changes[i].new_value);
+
+  free (changes);
+  free (b);
+  free (a);
+}
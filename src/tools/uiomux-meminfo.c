@@ -0,0 +1,185 @@
+/*
+ * UIOMux: a conflict manager for system resources, including UIO devices.
+ * Copyright (C) 2009 Renesas Technology Corp.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston MA  02110-1301 USA
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <uiomux/uiomux.h>
+
+static void
+print_json_string (const char * s)
+{
+  putchar ('"');
+  for (; *s; s++) {
+    if (*s == '"' || *s == '\\')
+      printf ("\\%c", *s);
+    else if ((unsigned char) *s < 0x20)
+      printf ("\\u%04x", (unsigned char) *s);
+    else
+      putchar (*s);
+  }
+  putchar ('"');
+}
+
+/* Command line of a process, with its arguments separated by spaces */
+static char *
+read_cmdline (pid_t pid, char * cmdline, size_t len)
+{
+  char path[64];
+  FILE * fp;
+  size_t n = 0, i;
+
+  snprintf (path, sizeof (path), "/proc/%d/cmdline", pid);
+  if ((fp = fopen (path, "r")) != NULL) {
+    n = fread (cmdline, 1, len - 1, fp);
+    fclose (fp);
+  }
+  while (n > 0 && cmdline[n - 1] == '\0')
+    n--;
+  for (i = 0; i < n; i++) {
+    if (cmdline[i] == '\0')
+      cmdline[i] = ' ';
+  }
+  cmdline[n] = '\0';
+
+  return cmdline;
+}
+
+static void
+print_json_extent (struct uiomux_extent * e)
+{
+  char cmdline[256];
+
+  printf ("        {\"address\": %lu, \"size\": %lu, \"pid\": %d, "
+          "\"tid\": %d, \"shared\": %s, \"locked\": %s, \"cmdline\": ",
+          e->address, e->size, (int) e->pid, (int) e->tid,
+          (e->flags & UIOMUX_EXTENT_SHARED) ? "true" : "false",
+          (e->flags & UIOMUX_EXTENT_LOCKED) ? "true" : "false");
+  print_json_string (read_cmdline (e->pid, cmdline, sizeof (cmdline)));
+  printf ("}");
+}
+
+/* Memory allocations of each UIO device, for monitoring tools */
+void
+meminfo_json (void)
+{
+  struct uiomux * uiomux;
+  struct uiomux_extent * extents;
+  unsigned long address, size, untracked;
+  int i, k, n, first = 1;
+
+  if ((uiomux = uiomux_open ()) == NULL)
+    return;
+
+  printf ("{\n  \"devices\": [");
+
+  for (i = 0; i < UIOMUX_BLOCK_MAX; i++) {
+    if (uiomux_get_mem (uiomux, 1<<i, &address, &size, NULL) == 0)
+      continue;
+
+    /* The extents may change between the two calls; take what fits */
+    if ((n = uiomux_get_extents (uiomux, 1<<i, NULL, 0, NULL)) < 0)
+      continue;
+    extents = malloc ((n + 1) * sizeof (*extents));
+    if (extents == NULL)
+      continue;
+    k = n + 1;
+    n = uiomux_get_extents (uiomux, 1<<i, extents, k, &untracked);
+    if (n < 0) {
+      free (extents);
+      continue;
+    }
+    if (n > k)
+      n = k;
+
+    printf ("%s\n    {\"name\": ", first ? "" : ",");
+    print_json_string (uiomux_name (1<<i) ? uiomux_name (1<<i) : "?");
+    printf (", \"address\": %lu, \"size\": %lu, \"untracked\": %lu,\n"
+            "      \"extents\": [", address, size, untracked);
+    for (k = 0; k < n; k++) {
+      printf ("%s\n", k ? "," : "");
+      print_json_extent (&extents[k]);
+    }
+    printf ("%s]}", n ? "\n      " : "");
+
+    free (extents);
+    first = 0;
+  }
+
+  printf ("\n  ]\n}\n");
+
+  uiomux_close (uiomux);
+}
+
+static void
+print_memstat (struct uiomux_memstat * stat)
+{
+  printf ("%lu KB live, %lu KB peak; %lu allocations, %lu frees, %lu failed\n",
+          stat->live_bytes / 1024, stat->peak_bytes / 1024, stat->allocs,
+          stat->frees, stat->failed);
+}
+
+/* Memory use of each UIO device, in total and by each process */
+void
+memstat (int argc, char *argv[])
+{
+  struct uiomux * uiomux;
+  struct uiomux_memstat total, * procs;
+  unsigned long size;
+  char cmdline[64];
+  int i, k, n, m, reset;
+
+  reset = argc > 2 && !strcmp (argv[2], "--reset-peak");
+
+  if ((uiomux = uiomux_open ()) == NULL)
+    return;
+
+  for (i = 0; i < UIOMUX_BLOCK_MAX; i++) {
+    if (uiomux_get_mem (uiomux, 1<<i, NULL, &size, NULL) == 0 ||
+        uiomux_get_memstat (uiomux, 1<<i, &total) < 0)
+      continue;
+
+    printf ("%s:\t%lu KB: ", uiomux_name (1<<i) ? uiomux_name (1<<i) : "?",
+            size / 1024);
+    print_memstat (&total);
+
+    /* Processes may come and go between the two calls */
+    n = uiomux_get_proc_memstat (uiomux, 1<<i, NULL, 0) + 1;
+    procs = malloc (n * sizeof (*procs));
+    if (procs != NULL) {
+      m = uiomux_get_proc_memstat (uiomux, 1<<i, procs, n);
+      for (k = 0; k < m && k < n; k++) {
+        printf ("\t%d %s: ", (int) procs[k].pid,
+                read_cmdline (procs[k].pid, cmdline, sizeof (cmdline)));
+        print_memstat (&procs[k]);
+      }
+      free (procs);
+    }
+
+    if (reset)
+      uiomux_reset_mem_peak (uiomux, 1<<i);
+  }
+
+  uiomux_close (uiomux);
+}
@@ -0,0 +1,267 @@
+/*
+ * UIOMux: a conflict manager for system resources, including UIO devices.
+ * Copyright (C) 2009 Renesas Technology Corp.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston MA  02110-1301 USA
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <time.h>
+
+#include <uiomux/uiomux.h>
+
+/* A register of the simulated register file */
+struct sim_reg {
+  uint64_t address;
+  uint32_t value;
+  int known;
+};
+
+static struct uiomux_trace_entry *
+load_trace (const char * path, struct uiomux_trace_header * header)
+{
+  struct uiomux_trace_entry * entries;
+  FILE * fp;
+  long size;
+
+  if ((fp = fopen (path, "r")) == NULL) {
+    fprintf (stderr, "uiomux: %s: %s\n", path, strerror (errno));
+    return NULL;
+  }
+
+  fseek (fp, 0, SEEK_END);
+  size = ftell (fp);
+  rewind (fp);
+
+  if (fread (header, sizeof (*header), 1, fp) != 1 ||
+      header->magic != UIOMUX_TRACE_MAGIC ||
+      header->version != UIOMUX_TRACE_VERSION) {
+    fprintf (stderr, "uiomux: %s: not a version %d trace\n", path,
+             UIOMUX_TRACE_VERSION);
+    fclose (fp);
+    return NULL;
+  }
+
+  /* The count comes from the file; it must fit in what follows */
+  if (size < 0 ||
+      header->count > (size - sizeof (*header)) / sizeof (*entries)) {
+    fprintf (stderr, "uiomux: %s: truncated trace\n", path);
+    fclose (fp);
+    return NULL;
+  }
+
+  entries = malloc (((size_t) header->count + 1) * sizeof (*entries));
+  if (entries == NULL ||
+      fread (entries, sizeof (*entries), header->count, fp) != header->count) {
+    fprintf (stderr, "uiomux: %s: unable to read trace\n", path);
+    free (entries);
+    fclose (fp);
+    return NULL;
+  }
+  fclose (fp);
+
+  return entries;
+}
+
+static int
+sim_reg_cmp (const void * a, const void * b)
+{
+  const struct sim_reg * ra = a, * rb = b;
+
+  if (ra->address == rb->address)
+    return 0;
+  return ra->address < rb->address ? -1 : 1;
+}
+
+/*
+ * Replay against a register file which holds the last value written or
+ * read. A read which differs from it shows where the hardware changed a
+ * register, eg. a status bit.
+ */
+static void
+replay_simulated (struct uiomux_trace_entry * entries, uint32_t count)
+{
+  struct sim_reg * regs, key, * reg;
+  uint32_t i, nregs = 0, differ = 0;
+
+  regs = calloc ((size_t) count + 1, sizeof (*regs));
+  if (regs == NULL) {
+    fprintf (stderr, "uiomux: out of memory\n");
+    exit (1);
+  }
+
+  for (i = 0; i < count; i++)
+    regs[i].address = entries[i].address;
+  qsort (regs, count, sizeof (*regs), sim_reg_cmp);
+  for (i = 0; i < count; i++) {
+    if (nregs == 0 || regs[nregs - 1].address != regs[i].address)
+      regs[nregs++].address = regs[i].address;
+  }
+
+  for (i = 0; i < count; i++) {
+    key.address = entries[i].address;
+    reg = bsearch (&key, regs, nregs, sizeof (*regs), sim_reg_cmp);
+
+    printf ("%12.6f  T%-3u %c  0x%08llx  %08x",
+            (double) (entries[i].time_ns - entries[0].time_ns) / 1e9,
+            entries[i].thread,
+            entries[i].op == UIOMUX_TRACE_WRITE ? 'W' : 'R',
+            (unsigned long long) entries[i].address, entries[i].value);
+
+    if (entries[i].op == UIOMUX_TRACE_READ && reg->known &&
+        reg->value != entries[i].value) {
+      printf ("  (simulated %08x)", reg->value);
+      differ++;
+    }
+    printf ("\n");
+
+    reg->value = entries[i].value;
+    reg->known = 1;
+  }
+
+  printf ("\n%u registers, %u reads differ from the simulated value\n",
+          nregs, differ);
+  for (i = 0; i < nregs; i++)
+    printf ("0x%08llx:\t%08x\n", (unsigned long long) regs[i].address,
+            regs[i].value);
+
+  free (regs);
+}
+
+/*
+ * Replay against the devices, holding their locks, at the recorded
+ * times unless fast is set. Reads are made and checked against the trace.
+ */
+static void
+replay_device (struct uiomux_trace_entry * entries, uint32_t count, int fast)
+{
+  struct uiomux * uiomux;
+  struct uiomux_map_desc mmio[UIOMUX_BLOCK_MAX];
+  const struct uiomux_map_desc ** desc;
+  uiomux_resource_t blocks = UIOMUX_NONE;
+  struct timespec start, t;
+  uint64_t ns;
+  uint32_t i, value, differ = 0;
+  int k;
+
+  if ((uiomux = uiomux_open ()) == NULL) {
+    fprintf (stderr, "uiomux: unable to open UIOMux\n");
+    exit (1);
+  }
+
+  for (k = 0; k < UIOMUX_BLOCK_MAX; k++) {
+    if (uiomux_get_mmio_desc (uiomux, 1<<k, &mmio[k]) < 0)
+      mmio[k].size = 0;
+  }
+
+  /* Find the register of every entry before touching any of them */
+  desc = calloc ((size_t) count + 1, sizeof (*desc));
+  if (desc == NULL) {
+    fprintf (stderr, "uiomux: out of memory\n");
+    exit (1);
+  }
+  for (i = 0; i < count; i++) {
+    for (k = 0; k < UIOMUX_BLOCK_MAX; k++) {
+      ns = entries[i].address - mmio[k].phys;
+      if (ns < mmio[k].size && mmio[k].size - ns >= 4)
+        break;
+    }
+    if (k == UIOMUX_BLOCK_MAX) {
+      fprintf (stderr, "uiomux: no device has a register at 0x%08llx\n",
+               (unsigned long long) entries[i].address);
+      exit (1);
+    }
+    desc[i] = &mmio[k];
+    blocks |= 1<<k;
+  }
+
+  uiomux_lock (uiomux, blocks);
+  clock_gettime (CLOCK_MONOTONIC, &start);
+
+  for (i = 0; i < count; i++) {
+    if (!fast) {
+      ns = start.tv_nsec + (entries[i].time_ns - entries[0].time_ns);
+      t.tv_sec = start.tv_sec + ns / 1000000000;
+      t.tv_nsec = ns % 1000000000;
+      clock_nanosleep (CLOCK_MONOTONIC, TIMER_ABSTIME, &t, NULL);
+    }
+
+    if (entries[i].op == UIOMUX_TRACE_WRITE) {
+      uiomux_reg_write (desc[i], entries[i].address - desc[i]->phys,
+                        entries[i].value);
+    } else {
+      value = uiomux_reg_read (desc[i], entries[i].address - desc[i]->phys);
+      if (value != entries[i].value) {
+        printf ("0x%08llx: read %08x, traced %08x\n",
+                (unsigned long long) entries[i].address, value,
+                entries[i].value);
+        differ++;
+      }
+    }
+  }
+
+  uiomux_unlock (uiomux, blocks);
+
+  printf ("Replayed %u accesses, %u reads differ from the trace\n",
+          count, differ);
+
+  free (desc);
+  uiomux_close (uiomux);
+}
+
+void
+replay (int argc, char *argv[])
+{
+  struct uiomux_trace_header header;
+  struct uiomux_trace_entry * entries;
+  const char * path = NULL;
+  int i, device = 0, fast = 0;
+
+  for (i = 2; i < argc; i++) {
+    if (!strcmp (argv[i], "--device"))
+      device = 1;
+    else if (!strcmp (argv[i], "--fast"))
+      fast = 1;
+    else
+      path = argv[i];
+  }
+
+  if (path == NULL) {
+    fprintf (stderr, "Usage: uiomux replay [--device [--fast]] <trace>\n");
+    exit (1);
+  }
+
+  if ((entries = load_trace (path, &header)) == NULL)
+    exit (1);
+
+  printf ("%s: %u accesses", path, header.count);
+  if (header.dropped)
+    printf (", %u older accesses were overwritten", header.dropped);
+  printf ("\n");
+
+  if (device)
+    replay_device (entries, header.count, fast);
+  else
+    replay_simulated (entries, header.count);
+
+  free (entries);
+}
@@ -0,0 +1,146 @@
+/*
+ * UIOMux: a conflict manager for system resources, including UIO devices.
+ * Copyright (C) 2009 Renesas Technology Corp.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston MA  02110-1301 USA
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+
+#include <uiomux/uiomux.h>
+
+#define DEFAULT_RATE_HZ 10000
+
+static void
+sample_usage (void)
+{
+  fprintf (stderr, "Usage: uiomux sample [-r <rate>] [-t <seconds>] "
+           "<name>:<offset>:<busy mask>[:<state mask>] ...\n");
+  exit (1);
+}
+
+/* Parse "<name>:<offset>:<busy mask>[:<state mask>]"; the name is cut off */
+static int
+parse_spec (char * spec, struct uiomux_sample_reg * reg)
+{
+  char * field, * end;
+  unsigned long v[3] = { 0, 0, 0 };
+  int n;
+
+  if ((field = strchr (spec, ':')) == NULL)
+    return -1;
+  *field++ = '\0';
+
+  for (n = 0; n < 3 && *field; n++) {
+    v[n] = strtoul (field, &end, 0);
+    if (end == field || (*end != ':' && *end != '\0'))
+      return -1;
+    field = *end ? end + 1 : end;
+  }
+  if (n < 2 || *field)
+    return -1;
+
+  reg->offset = v[0];
+  reg->busy_mask = v[1];
+  reg->state_mask = v[2];
+
+  return 0;
+}
+
+static void
+print_samplestat (const char * name, struct uiomux_samplestat * stat,
+                  int states)
+{
+  double busy_pct, rate_khz, run_us;
+  int k;
+
+  busy_pct = stat->samples ? 100.0 * stat->busy / stat->samples : 0;
+  rate_khz = stat->elapsed_us ? 1e3 * stat->samples / stat->elapsed_us : 0;
+  run_us = stat->busy_runs && stat->samples ?
+    (double) stat->elapsed_us * stat->busy / stat->samples / stat->busy_runs
+    : 0;
+
+  printf ("%s:\t%.1f%% busy, %lu busy periods of %.0f us avg; "
+          "%lu samples at %.1f kHz, %lu missed\n", name, busy_pct,
+          stat->busy_runs, run_us, stat->samples, rate_khz, stat->missed);
+
+  if (!states || stat->samples == 0)
+    return;
+
+  printf ("\tstates:");
+  for (k = 0; k < UIOMUX_SAMPLE_STATES; k++) {
+    if (stat->states[k])
+      printf (" %d%s=%.1f%%", k, k == UIOMUX_SAMPLE_STATES - 1 ? "+" : "",
+              100.0 * stat->states[k] / stat->samples);
+  }
+  printf ("\n");
+}
+
+void
+sample (int argc, char *argv[])
+{
+  struct uiomux * uiomux;
+  struct uiomux_sample_reg regs[16];
+  struct uiomux_samplestat stat;
+  const char * names[17];
+  unsigned long rate_hz = DEFAULT_RATE_HZ;
+  double seconds = 1.0;
+  int i, n = 0;
+
+  for (i = 2; i < argc; i++) {
+    if (!strcmp (argv[i], "-r") && i + 1 < argc) {
+      rate_hz = strtoul (argv[++i], NULL, 0);
+    } else if (!strcmp (argv[i], "-t") && i + 1 < argc) {
+      seconds = atof (argv[++i]);
+    } else if (n < 16 && parse_spec (argv[i], &regs[n]) == 0) {
+      names[n] = argv[i];
+      regs[n].resource = 1 << n;
+      n++;
+    } else {
+      sample_usage ();
+    }
+  }
+  names[n] = NULL;
+
+  if (n == 0 || rate_hz == 0 || seconds <= 0)
+    sample_usage ();
+
+  if ((uiomux = uiomux_open_named (names)) == NULL) {
+    fprintf (stderr, "uiomux: unable to open UIOMux\n");
+    exit (1);
+  }
+
+  if (uiomux_set_sampler (uiomux, regs, n, rate_hz) < 0) {
+    fprintf (stderr, "uiomux: unable to sample: %s\n", strerror (errno));
+    exit (1);
+  }
+
+  usleep (seconds * 1e6);
+
+  for (i = 0; i < n; i++) {
+    if (uiomux_get_samplestat (uiomux, regs[i].resource, &stat) == 0)
+      print_samplestat (names[i], &stat, regs[i].state_mask != 0);
+  }
+
+  uiomux_close (uiomux);
+}
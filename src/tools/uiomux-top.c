@@ -0,0 +1,259 @@
+/*
+ * UIOMux: a conflict manager for system resources, including UIO devices.
+ * Copyright (C) 2009 Renesas Technology Corp.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston MA  02110-1301 USA
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <poll.h>
+#include <signal.h>
+#include <termios.h>
+#include <time.h>
+#include <unistd.h>
+
+#include <uiomux/uiomux.h>
+
+/* Processes listed under each resource */
+#define TOP_CONSUMERS 3
+
+/* Counters of the previous refresh, for rates */
+struct top_prev {
+  unsigned long lock_count;
+  unsigned long irq_count;
+};
+
+static volatile sig_atomic_t top_stop = 0;
+
+static void
+top_signal (int sig)
+{
+  top_stop = 1;
+}
+
+static double
+top_now (void)
+{
+  struct timespec ts;
+
+  clock_gettime (CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+/* Used and largest free extent of a memory region, from its extents */
+static void
+top_mem (UIOMux * uiomux, uiomux_resource_t resource, unsigned long address,
+         unsigned long size, unsigned long * used, unsigned long * max_free)
+{
+  struct uiomux_extent * extents;
+  unsigned long cursor = address, end = address + size, free_total = 0;
+  int i, k, n;
+
+  *used = 0;
+  *max_free = size;
+
+  n = uiomux_get_extents (uiomux, resource, NULL, 0, NULL);
+  if (n <= 0 || (extents = malloc (n * sizeof (*extents))) == NULL)
+    return;
+  k = n;
+  n = uiomux_get_extents (uiomux, resource, extents, k, NULL);
+
+  /* Extents added since the count are not returned */
+  if (n > k)
+    n = k;
+
+  /* Extents are in order of address, but shared ones may overlap */
+  *max_free = 0;
+  for (i = 0; i < n; i++) {
+    if (extents[i].address > cursor) {
+      free_total += extents[i].address - cursor;
+      if (extents[i].address - cursor > *max_free)
+        *max_free = extents[i].address - cursor;
+    }
+    if (extents[i].address + extents[i].size > cursor)
+      cursor = extents[i].address + extents[i].size;
+  }
+  if (end > cursor) {
+    free_total += end - cursor;
+    if (end - cursor > *max_free)
+      *max_free = end - cursor;
+  }
+  *used = size - free_total;
+
+  free (extents);
+}
+
+static void
+top_consumers (UIOMux * uiomux, uiomux_resource_t resource)
+{
+  struct uiomux_memstat stats[TOP_CONSUMERS];
+  char path[64], cmdline[32];
+  FILE * fp;
+  int i, n;
+
+  n = uiomux_get_proc_memstat (uiomux, resource, stats, TOP_CONSUMERS);
+  for (i = 0; i < n && i < TOP_CONSUMERS; i++) {
+    if (stats[i].live_bytes == 0)
+      break;
+
+    snprintf (path, sizeof (path), "/proc/%d/cmdline", (int) stats[i].pid);
+    cmdline[0] = '\0';
+    if ((fp = fopen (path, "r")) != NULL) {
+      if (fgets (cmdline, sizeof (cmdline), fp) == NULL)
+        cmdline[0] = '\0';
+      fclose (fp);
+    }
+
+    printf ("%s %d %s %lu KB", i ? "," : "          top:", (int) stats[i].pid,
+            cmdline, stats[i].live_bytes / 1024);
+  }
+  if (i > 0)
+    printf ("\n");
+}
+
+static void
+top_refresh (UIOMux * uiomux, struct top_prev * prev, double delay,
+             double elapsed)
+{
+  struct uiomux_lockstat lock;
+  struct uiomux_irqstat irq;
+  unsigned long address, size, used, max_free;
+  char holder[24];
+  double lock_rate, irq_rate;
+  time_t now = time (NULL);
+  int i;
+
+  /* Home the cursor and clear the screen */
+  printf ("\033[H\033[J");
+  printf ("uiomux top - %.8s, every %.1f s, q to quit\n\n",
+          ctime (&now) + 11, delay);
+  printf ("%-8s %-13s %8s %5s %7s %15s %15s %7s %8s %8s %8s\n",
+          "DEVICE", "HOLDER", "HELD ms", "QUEUE", "LOCKS/s",
+          "HOLD avg/max us", "WAIT avg/max us", "IRQ/s", "USED KB",
+          "FREE KB", "LARGEST");
+
+  for (i = 0; i < UIOMUX_BLOCK_MAX; i++) {
+    if (uiomux_get_mem (uiomux, 1<<i, &address, &size, NULL) == 0 ||
+        uiomux_get_lockstat (uiomux, 1<<i, &lock) < 0)
+      continue;
+
+    if (lock.holder_pid)
+      snprintf (holder, sizeof (holder), "%d/%d", (int) lock.holder_pid,
+                (int) lock.holder_tid);
+    else
+      snprintf (holder, sizeof (holder), "-");
+
+    lock_rate = elapsed > 0 && prev[i].lock_count ?
+      (lock.lock_count - prev[i].lock_count) / elapsed : 0;
+    prev[i].lock_count = lock.lock_count;
+
+    irq_rate = 0;
+    if (uiomux_get_irqstat (uiomux, 1<<i, &irq) == 0) {
+      if (elapsed > 0 && prev[i].irq_count)
+        irq_rate = (irq.count - prev[i].irq_count) / elapsed;
+      prev[i].irq_count = irq.count;
+    }
+
+    top_mem (uiomux, 1<<i, address, size, &used, &max_free);
+
+    printf ("%-8s %-13s %8lu %5u %7.0f %7lu/%-7lu %7lu/%-7lu %7.0f %8lu "
+            "%8lu %8lu\n",
+            uiomux_name (1<<i) ? uiomux_name (1<<i) : "?", holder,
+            lock.holder_pid ? lock.held_us / 1000 : 0, lock.waiters,
+            lock_rate, lock.hold_avg_us, lock.hold_max_us, lock.wait_avg_us,
+            lock.wait_max_us, irq_rate, used / 1024, (size - used) / 1024,
+            max_free / 1024);
+
+    top_consumers (uiomux, 1<<i);
+  }
+
+  fflush (stdout);
+}
+
+void
+top (int argc, char *argv[])
+{
+  struct uiomux * uiomux;
+  struct top_prev prev[UIOMUX_BLOCK_MAX];
+  struct termios saved, raw;
+  struct pollfd pfd = { STDIN_FILENO, POLLIN, 0 };
+  double delay = 1.0, last, now;
+  int i, interactive, iterations = -1;
+  char c, *end;
+
+  for (i = 2; i < argc; i++) {
+    if (!strcmp (argv[i], "-d") && i + 1 < argc) {
+      delay = atof (argv[++i]);
+    } else if (!strcmp (argv[i], "-n") && i + 1 < argc) {
+      iterations = strtol (argv[++i], &end, 10);
+      if (iterations <= 0 || *end != '\0') {
+        fprintf (stderr, "uiomux top: -n needs a positive count\n");
+        exit (1);
+      }
+    } else {
+      fprintf (stderr, "Usage: uiomux top [-d <seconds>] [-n <iterations>]\n");
+      exit (1);
+    }
+  }
+  if (delay <= 0)
+    delay = 1.0;
+
+  if ((uiomux = uiomux_open ()) == NULL) {
+    fprintf (stderr, "uiomux: unable to open UIOMux\n");
+    exit (1);
+  }
+
+  /* Read single keys without echo; Ctrl-C still stops */
+  interactive = isatty (STDIN_FILENO) && tcgetattr (STDIN_FILENO, &saved) == 0;
+  if (interactive) {
+    raw = saved;
+    raw.c_lflag &= ~(ICANON | ECHO);
+    raw.c_cc[VMIN] = 1;
+    raw.c_cc[VTIME] = 0;
+    tcsetattr (STDIN_FILENO, TCSANOW, &raw);
+  }
+  signal (SIGINT, top_signal);
+  signal (SIGTERM, top_signal);
+
+  memset (prev, 0, sizeof (prev));
+  last = top_now ();
+  top_refresh (uiomux, prev, delay, 0);
+
+  while (!top_stop && iterations != 1) {
+    if (poll (&pfd, interactive ? 1 : 0, delay * 1000) > 0 &&
+        read (STDIN_FILENO, &c, 1) == 1 && (c == 'q' || c == 'Q'))
+      break;
+    if (top_stop)
+      break;
+
+    now = top_now ();
+    top_refresh (uiomux, prev, delay, now - last);
+    last = now;
+    if (iterations > 0)
+      iterations--;
+  }
+
+  if (interactive)
+    tcsetattr (STDIN_FILENO, TCSANOW, &saved);
+
+  uiomux_close (uiomux);
+}
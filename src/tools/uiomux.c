@@ -24,10 +24,17 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <unistd.h>
 
 #include <uiomux/uiomux.h>
 
 extern void alloc (int argc, char *argv[]);
+extern void dump (int argc, char *argv[]);
+extern void replay (int argc, char *argv[]);
+extern void sample (int argc, char *argv[]);
+extern void meminfo_json (void);
+extern void memstat (int argc, char *argv[]);
+extern void top (int argc, char *argv[]);
 
 static void
 version (void)
@@ -50,7 +57,21 @@ usage (void)
   printf ("\nReporting:\n");
   printf ("  query       List available UIO device names that can be managed by UIOMux.\n");
   printf ("  info        Show memory layout of each UIO device managed by UIOMux.\n");
-  printf ("  meminfo     Show memory allocations of each UIO device managed by UIOMux.\n");
+  printf ("  meminfo [--json]\n");
+  printf ("              Show memory allocations of each UIO device managed by UIOMux,\n");
+  printf ("              optionally as JSON.\n");
+  printf ("  memstat [--reset-peak]\n");
+  printf ("              Show live and peak memory use of each UIO device, in total and\n");
+  printf ("              by each process, and optionally restart the peaks.\n");
+  printf ("  holders     Show the current lock holder and lock statistics of each UIO device.\n");
+  printf ("  irqstat     Show interrupt rate, latency and coalescing of each UIO device.\n");
+  printf ("  top [-d <seconds>] [-n <iterations>]\n");
+  printf ("              Show lock holders and queues, lock and interrupt rates, memory\n");
+  printf ("              use and the largest users of each UIO device, refreshed every\n");
+  printf ("              second until 'q' is pressed.\n");
+  printf ("  sample [-r <rate>] [-t <seconds>] <name>:<offset>:<busy mask>[:<state mask>] ...\n");
+  printf ("              Sample a status register of each named UIO device and show how\n");
+  printf ("              busy it was, and optionally a histogram of a state field.\n");
 
   printf ("\nManagement:\n");
   printf ("  reset       Reset the UIOMux system. This initializes the UIOMux shared state,\n");
@@ -62,6 +83,12 @@ usage (void)
 
   printf ("\nUtilities:\n");
   printf ("  alloc <n>   Allocate a specified number of bytes.\n");
+  printf ("  dump <snapshot> [<later snapshot>]\n");
+  printf ("              Print the registers in an MMIO snapshot file, or the registers\n");
+  printf ("              which changed between two snapshots.\n");
+  printf ("  replay [--device [--fast]] <trace>\n");
+  printf ("              Replay a register access trace against a simulated register\n");
+  printf ("              file, or against the devices at the recorded times.\n");
 
   printf ("\nOptions:\n");
   printf ("  --version   Show uiomux version info\n");
@@ -77,7 +104,7 @@ query (void)
 
   blocks = uiomux_query ();
 
-  for (i=0; i < 16; i++) {
+  for (i=0; i < UIOMUX_BLOCK_MAX; i++) {
     if (blocks & (1<<i)) {
       puts (uiomux_name (1<<i));
     }
@@ -108,6 +135,63 @@ meminfo (void)
   uiomux_close (uiomux);
 }
 
+static void
+holders (void)
+{
+  struct uiomux * uiomux;
+
+  if ((uiomux = uiomux_open ()) == NULL)
+    return;
+
+  uiomux_holders (uiomux);
+  uiomux_close (uiomux);
+}
+
+static void
+irqstat (void)
+{
+  struct uiomux * uiomux;
+  struct uiomux_irqstat before[UIOMUX_BLOCK_MAX], after[UIOMUX_BLOCK_MAX];
+  uiomux_resource_t blocks = UIOMUX_NONE;
+  int i, k;
+
+  if ((uiomux = uiomux_open ()) == NULL)
+    return;
+
+  /* Sample the counts over one second for the rate */
+  for (i=0; i < UIOMUX_BLOCK_MAX; i++) {
+    if (uiomux_get_irqstat (uiomux, 1<<i, &before[i]) == 0)
+      blocks |= 1<<i;
+  }
+  if (blocks == UIOMUX_NONE) {
+    printf ("No interrupt statistics available\n");
+    uiomux_close (uiomux);
+    return;
+  }
+  sleep (1);
+
+  for (i=0; i < UIOMUX_BLOCK_MAX; i++) {
+    if (!(blocks & (1<<i)) || uiomux_get_irqstat (uiomux, 1<<i, &after[i]) < 0)
+      continue;
+
+    printf ("%s:\t%lu irq/s, %lu interrupts, %lu coalesced\n",
+            uiomux_check_name (uiomux, 1<<i) ? uiomux_name (1<<i) : "?",
+            after[i].count - before[i].count, after[i].count,
+            after[i].coalesced);
+    printf ("\t%lu waits, latency avg %lu us, max %lu us\n",
+            after[i].waits, after[i].latency_avg_us, after[i].latency_max_us);
+    for (k=0; k < UIOMUX_IRQ_HIST_BUCKETS; k++) {
+      if (after[i].hist[k] == 0)
+        continue;
+      printf ("\t%8lu us %s %10lu\n", 1UL << k,
+              k == UIOMUX_IRQ_HIST_BUCKETS - 1 ? "+ " : "- ",
+              after[i].hist[k]);
+    }
+  }
+
+  uiomux_close (uiomux);
+}
+
 static void
 reset (void)
 {
@@ -156,13 +240,30 @@ main (int argc, char *argv[])
   } else if (!strncmp (argv[1], "info", 5)) {
     info ();
   } else if (!strncmp (argv[1], "meminfo", 8)) {
-    meminfo ();
+    if (argc > 2 && !strcmp (argv[2], "--json"))
+      meminfo_json ();
+    else
+      meminfo ();
+  } else if (!strncmp (argv[1], "memstat", 8)) {
+    memstat (argc, argv);
+  } else if (!strncmp (argv[1], "holders", 8)) {
+    holders ();
+  } else if (!strncmp (argv[1], "irqstat", 8)) {
+    irqstat ();
+  } else if (!strncmp (argv[1], "top", 4)) {
+    top (argc, argv);
+  } else if (!strncmp (argv[1], "sample", 7)) {
+    sample (argc, argv);
   } else if (!strncmp (argv[1], "reset", 6)) {
     reset ();
   } else if (!strncmp (argv[1], "destroy", 8)) {
     destroy ();
   } else if (!strncmp (argv[1], "alloc", 6)) {
     alloc (argc, argv);
+  } else if (!strncmp (argv[1], "dump", 5)) {
+    dump (argc, argv);
+  } else if (!strncmp (argv[1], "replay", 7)) {
+    replay (argc, argv);
   } else {
     usage();
     exit (1);